@@ -0,0 +1,177 @@
+#cascade-to-C generator
+#
+#MU_GENERATE_CASCADE(<name> <table> <output> [STEP <sum step>])
+#  turns a cascade parameter table (the muObjectDetectionInit layout, as in the
+#  *CascadeModel_*.h headers: numbers, optionally inside the first { }) into
+#  <output>.c with
+#    int <name>_Run(const MU_32S *sum, const MU_64F *sqsum, MU_32S step, MU_32S x, MU_32S y, MU_32S std_th)
+#    MU_VOID <name>_Detect(const muIntegralImg_t *Itlmg, muRect_t ScanROI, muSeq_t *Objects)
+#  an unrolled evaluator of the model at its original window size, the same result
+#  as ctRunHaarClassifierCascade at scale 1. With STEP the sum step (image width+1)
+#  is a constant too and _Run returns -1 for other steps.
+#  The source is generated at build time by this file in script mode (cmake -P),
+#  so no host tool is needed when cross compiling.
+#
+#  MU_GENERATE_CASCADE(Mark ${CMAKE_CURRENT_SOURCE_DIR}/MarkCascadeModel_40x25.h MarkSrc)
+#  ADD_EXECUTABLE(app main.c ${MarkSrc})
+
+SET(MU_CASCADEGEN_SCRIPT ${CMAKE_CURRENT_LIST_FILE})
+
+FUNCTION(MU_GENERATE_CASCADE name table output)
+	SET(step 0)
+	IF(ARGC GREATER 4 AND "${ARGV3}" STREQUAL "STEP")
+		SET(step ${ARGV4})
+	ENDIF()
+	SET(source ${CMAKE_CURRENT_BINARY_DIR}/${name}Cascade.c)
+	ADD_CUSTOM_COMMAND(
+		OUTPUT ${source}
+		COMMAND ${CMAKE_COMMAND} -DMU_CASCADE_NAME=${name} -DMU_CASCADE_TABLE=${table}
+		        -DMU_CASCADE_OUTPUT=${source} -DMU_CASCADE_STEP=${step} -P ${MU_CASCADEGEN_SCRIPT}
+		DEPENDS ${table} ${MU_CASCADEGEN_SCRIPT}
+		COMMENT "Generating cascade evaluator ${name}")
+	SET(${output} ${source} PARENT_SCOPE)
+ENDFUNCTION()
+
+IF(NOT DEFINED MU_CASCADE_TABLE)
+	RETURN()
+ENDIF()
+
+#---- script mode: generate ----
+
+FILE(READ ${MU_CASCADE_TABLE} text)
+IF(text MATCHES "{")
+	STRING(REGEX REPLACE "^[^{]*{" "" text "${text}")
+	STRING(REGEX REPLACE "}.*$" "" text "${text}")
+ENDIF()
+STRING(REGEX MATCHALL "[-+]?[0-9]*\\.?[0-9]+([eE][-+]?[0-9]+)?" tokens "${text}")
+LIST(LENGTH tokens ntokens)
+SET(pos 0)
+
+#next token as text / as integer
+MACRO(NEXT_VALUE var)
+	IF(NOT pos LESS ntokens)
+		MESSAGE(FATAL_ERROR "${MU_CASCADE_TABLE}: table ends early")
+	ENDIF()
+	LIST(GET tokens ${pos} ${var})
+	MATH(EXPR pos "${pos} + 1")
+ENDMACRO()
+
+MACRO(NEXT_INT var)
+	NEXT_VALUE(${var})
+	STRING(REGEX REPLACE "\\.[0-9]*$" "" ${var} "${${var}}")
+ENDMACRO()
+
+IF(MU_CASCADE_STEP)
+	SET(S "${MU_CASCADE_STEP}")
+ELSE()
+	SET(S "step")
+ENDIF()
+
+#rect sum around p, corners folded to constants when the step is known
+MACRO(RECT_SUM var x y w h)
+	MATH(EXPR x1 "${x} + ${w}")
+	MATH(EXPR y1 "${y} + ${h}")
+	IF(MU_CASCADE_STEP)
+		MATH(EXPR o0 "${y}*${S} + ${x}")
+		MATH(EXPR o1 "${y}*${S} + ${x1}")
+		MATH(EXPR o2 "${y1}*${S} + ${x}")
+		MATH(EXPR o3 "${y1}*${S} + ${x1}")
+	ELSE()
+		SET(o0 "${y}*step+${x}")
+		SET(o1 "${y}*step+${x1}")
+		SET(o2 "${y1}*step+${x}")
+		SET(o3 "${y1}*step+${x1}")
+	ENDIF()
+	SET(${var} "(p[${o0}] - p[${o1}] - p[${o2}] + p[${o3}])")
+ENDMACRO()
+
+NEXT_INT(width)
+NEXT_INT(height)
+NEXT_INT(nstages)
+MATH(EXPR eqw "${width} - 2")
+MATH(EXPR eqh "${height} - 2")
+MATH(EXPR eqarea "${eqw}*${eqh}")
+RECT_SUM(eqsum 1 1 ${eqw} ${eqh})
+STRING(REPLACE "p[" "q[" eqsq "${eqsum}")
+
+STRING(TOUPPER ${MU_CASCADE_NAME} NAME)
+SET(code "/* ${MU_CASCADE_NAME}Cascade.c, generated by cascadegen.cmake from ${MU_CASCADE_TABLE} -- do not edit */\n\n")
+SET(code "${code}#include \"muGadget.h\"\n\n")
+SET(code "${code}#define ${NAME}_WIDTH ${width}\n#define ${NAME}_HEIGHT ${height}\n")
+SET(code "${code}#define ${NAME}_INV_AREA (1./${eqarea})\n\n")
+SET(code "${code}int ${MU_CASCADE_NAME}_Run(const MU_32S *sum, const MU_64F *sqsum, MU_32S step, MU_32S x, MU_32S y, MU_32S std_th)\n{\n")
+SET(code "${code}    const MU_32S *p = sum + y*step + x;\n    const MU_64F *q = sqsum + y*step + x;\n")
+SET(code "${code}    double mean, vnf, stage_sum, f;\n\n")
+IF(MU_CASCADE_STEP)
+	SET(code "${code}    if( step != ${S} )\n        return -1;\n\n")
+ENDIF()
+SET(code "${code}    mean = ${eqsum}*${NAME}_INV_AREA;\n")
+SET(code "${code}    vnf = ${eqsq}*${NAME}_INV_AREA - mean*mean;\n")
+SET(code "${code}    vnf = vnf >= 0. ? sqrt(vnf) : 1.;\n    if( vnf < std_th )\n        return 0;\n")
+
+SET(stage 0)
+WHILE(stage LESS nstages)
+	NEXT_INT(nclassifiers)
+	SET(code "${code}\n    //stage ${stage}\n    stage_sum = 0;\n")
+	SET(c 0)
+	WHILE(c LESS nclassifiers)
+		NEXT_INT(nnodes)
+		IF(NOT nnodes EQUAL 1)
+			MESSAGE(FATAL_ERROR "${MU_CASCADE_TABLE}: only stump classifiers are supported")
+		ENDIF()
+		NEXT_INT(nrects)
+		#weights as muSetImagesForHaarClassifierCascade at scale 1 (float products, rect 0 corrected
+		#so the feature is zero mean), so the result is the one of ctRunHaarClassifierCascade
+		SET(k 0)
+		SET(others "")
+		SET(terms "")
+		WHILE(k LESS nrects)
+			NEXT_INT(rx)
+			NEXT_INT(ry)
+			NEXT_INT(rw)
+			NEXT_INT(rh)
+			NEXT_VALUE(rweight)
+			RECT_SUM(rsum ${rx} ${ry} ${rw} ${rh})
+			IF(k EQUAL 0)
+				MATH(EXPR area0 "${rw}*${rh}")
+				SET(sum0 "${rsum}")
+			ELSE()
+				SET(rweight "(float)((float)${rweight}*${NAME}_INV_AREA)")
+				SET(others "${others} + ${rweight}*${rw}*${rh}")
+				SET(terms "${terms}\n    f += ${rsum}*${rweight};")
+			ENDIF()
+			MATH(EXPR k "${k} + 1")
+		ENDWHILE()
+		NEXT_INT(tilted)
+		IF(NOT tilted EQUAL 0)
+			MESSAGE(FATAL_ERROR "${MU_CASCADE_TABLE}: tilted features are not supported")
+		ENDIF()
+		NEXT_VALUE(threshold)
+		NEXT_VALUE(left)
+		NEXT_VALUE(right)
+		SET(code "${code}    f = ${sum0}*(float)(-(0.${others})/(double)${area0});${terms}\n")
+		SET(code "${code}    stage_sum += f >= (double)(float)${threshold}*vnf ? (double)(float)${right} : (double)(float)${left};\n")
+		MATH(EXPR c "${c} + 1")
+	ENDWHILE()
+	NEXT_VALUE(stagethreshold)
+	NEXT_INT(parent)
+	NEXT_INT(next)
+	SET(code "${code}    if( stage_sum < (double)(float)${stagethreshold} )\n        return -${stage};\n")
+	MATH(EXPR stage "${stage} + 1")
+ENDWHILE()
+SET(code "${code}\n    return 1;\n}\n\n")
+
+SET(code "${code}MU_VOID ${MU_CASCADE_NAME}_Detect(const muIntegralImg_t *Itlmg, muRect_t ScanROI, muSeq_t *Objects)\n{\n")
+SET(code "${code}    muRect_t rRect = { 0, 0, ${width}, ${height} };\n    int ix, iy, endX, endY, result, ixstep;\n\n")
+SET(code "${code}    ScanROI.x -= Itlmg->origin.x;\n    ScanROI.y -= Itlmg->origin.y;\n")
+SET(code "${code}    endX = ScanROI.x + ScanROI.width - ${width};\n    endY = ScanROI.y + ScanROI.height - ${height};\n")
+SET(code "${code}    endX = endX > Itlmg->imgSize.width - ${width} ? Itlmg->imgSize.width - ${width} : endX;\n")
+SET(code "${code}    endY = endY > Itlmg->imgSize.height - ${height} ? Itlmg->imgSize.height - ${height} : endY;\n")
+SET(code "${code}    ScanROI.x = ScanROI.x < 0 ? 0 : ScanROI.x;\n    ScanROI.y = ScanROI.y < 0 ? 0 : ScanROI.y;\n\n")
+SET(code "${code}    for( iy = ScanROI.y; iy < endY; iy += 2 )\n    {\n        ixstep = 2;\n")
+SET(code "${code}        for( ix = ScanROI.x; ix < endX; ix += ixstep )\n        {\n")
+SET(code "${code}            result = ${MU_CASCADE_NAME}_Run(Itlmg->sum, Itlmg->sqsum, Itlmg->sumSize.width, ix, iy, 10);\n")
+SET(code "${code}            if( result > 0 )\n            {\n                rRect.x = ix + Itlmg->origin.x;\n                rRect.y = iy + Itlmg->origin.y;\n")
+SET(code "${code}                muPushSeq(Objects, (MU_VOID *)&rRect);\n            }\n            ixstep = result != 0 ? 2 : 3;\n        }\n    }\n}\n")
+
+FILE(WRITE ${MU_CASCADE_OUTPUT} "${code}")
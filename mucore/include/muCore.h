@@ -61,6 +61,121 @@ MU_API(muError_t) muCannyEdge(const muImage_t *src, muImage_t *dst, muDoubleThre
 /* Edge-based no reference blur metric */
 MU_API(muError_t) muNoRefBlurMetric(muImage_t *src, MU_64F *bm);
 
+/********************************* Hough Transforms *************************************/
+
+typedef struct _muHoughLine
+{
+	MU_32F rho;          /* distance from the origin */
+	MU_32F theta;        /* angle of the normal (radian) */
+	MU_32S votes;
+}muHoughLine_t;
+
+typedef struct _muLineSegment
+{
+	muPoint_t start;
+	muPoint_t end;
+}muLineSegment_t;
+
+typedef struct _muCircle
+{
+	MU_32F x;
+	MU_32F y;
+	MU_32F radius;
+	MU_32S votes;
+}muCircle_t;
+
+/* Standard Hough line transform of an edge map */
+MU_API(muError_t) muHoughLines(const muImage_t *edge, MU_64F rho, MU_64F theta, MU_32S threshold,
+                               muHoughLine_t *lines, MU_32S maxlines, MU_32S *count);
+
+/* Progressive probabilistic Hough transform, returns line segments */
+MU_API(muError_t) muHoughLinesP(const muImage_t *edge, MU_64F rho, MU_64F theta, MU_32S threshold,
+                                MU_32S minlength, MU_32S maxgap, muLineSegment_t *segs, MU_32S maxsegs, MU_32S *count);
+
+/* Gradient Hough circle transform */
+MU_API(muError_t) muHoughCircles(const muImage_t *src, const muImage_t *edge, MU_32S minradius, MU_32S maxradius,
+                                 MU_32S mindist, MU_32S threshold, muCircle_t *circles, MU_32S maxcircles, MU_32S *count);
+
+/*********************** Feature Detection, Description and Matching ********************/
+
+typedef struct _muKeyPoint
+{
+	MU_32S x;
+	MU_32S y;
+	MU_32S score;        /* FAST score */
+	MU_32F angle;        /* orientation (radian) */
+}muKeyPoint_t;
+
+typedef struct _muDMatch
+{
+	MU_32S query;
+	MU_32S train;        /* -1 if not matched */
+	MU_32S distance;     /* Hamming distance */
+}muDMatch_t;
+
+/* Multi-index hashing table of 256-bit descriptors, train is referenced not copied */
+typedef struct _muBinaryIndex
+{
+	const MU_8U *train;
+	MU_32S ntrain;
+	MU_32S *start;       /* bucket start of every 16-bit substring table */
+	MU_32S *entry;       /* descriptor indices sorted by bucket */
+}muBinaryIndex_t;
+
+/* FAST-9 corner detection */
+MU_API(muError_t) muFASTCorner(const muImage_t *src, MU_32S threshold, MU_32S nonmax, MU_32S border,
+                               muKeyPoint_t *kps, MU_32S maxkps, MU_32S *count);
+
+/* Intensity centroid orientation of the keypoints */
+MU_API(muError_t) muKeyPointOrientation(const muImage_t *src, muKeyPoint_t *kps, MU_32S count);
+
+/* 256-bit rotated BRIEF (ORB) descriptors, 32 bytes per keypoint */
+MU_API(muError_t) muORBDescriptor(const muImage_t *src, muKeyPoint_t *kps, MU_32S *count, MU_8U *desc);
+
+/* Brute force Hamming matching */
+MU_API(muError_t) muMatchBinary(const MU_8U *query, MU_32S nquery, const MU_8U *train, MU_32S ntrain,
+                                MU_32S maxdistance, muDMatch_t *matches);
+
+/* Multi-index hashing for large descriptor sets */
+MU_API(muBinaryIndex_t*) muCreateBinaryIndex(const MU_8U *train, MU_32S ntrain);
+MU_API(muError_t) muMatchBinaryIndex(const muBinaryIndex_t *index, const MU_8U *query, MU_32S nquery,
+                                     MU_32S radius, MU_32S maxdistance, muDMatch_t *matches);
+MU_API(muError_t) muReleaseBinaryIndex(muBinaryIndex_t **index);
+
+/******************************** Fourier Transforms ************************************/
+
+typedef struct _muComplex
+{
+	MU_32F re;
+	MU_32F im;
+}muComplex_t;
+
+/* Plan of the real-input 2-D FFT (twiddles and buffers), reused for every transform of the size */
+typedef struct _muFFTPlan muFFTPlan_t;
+
+/* The smallest size >= n with the prime factors 2, 3 and 5 only */
+MU_API(MU_32S) muGetOptimalFFTSize(MU_32S n);
+
+MU_API(muFFTPlan_t*) muCreateFFTPlan(MU_32S width, MU_32S height);
+MU_API(muError_t) muReleaseFFTPlan(muFFTPlan_t **plan);
+
+/* Real-input 2-D FFT, spectrum is height x (width/2+1) */
+MU_API(muError_t) muFFTForward(muFFTPlan_t *plan, const MU_32F *src, MU_32S srcstep, muComplex_t *spectrum);
+
+/* Normalized inverse of muFFTForward */
+MU_API(muError_t) muFFTInverse(muFFTPlan_t *plan, const muComplex_t *spectrum, MU_32F *dst, MU_32S dststep);
+
+/* Template cross-correlation (normalized = 1: zero mean NCC) of all the valid positions */
+MU_API(muError_t) muFFTCrossCorrelation(muFFTPlan_t *plan, const muImage_t *src, const muImage_t *templ,
+                                        MU_32S normalized, MU_32F *result);
+
+/* Global translation of src2 relative to src1 with sub pixel accuracy */
+MU_API(muError_t) muPhaseCorrelation(muFFTPlan_t *plan, const muImage_t *src1, const muImage_t *src2, MU_32S window,
+                                     muPoint2D32f_t *shift, MU_64F *response);
+
+/* Large kernel filtering through the FFT, dst is 32F */
+MU_API(muError_t) muFFTFilter(muFFTPlan_t *plan, const muImage_t *src, muImage_t *dst, const MU_32F *kernel, MU_32S kw, MU_32S kh);
+
 /****************** Sampling, Interpolation and Geometrical Transforms ******************/
 
 #define  MU_INTER_NN        0
@@ -85,6 +200,12 @@ MU_API(muError_t) muDownScaleMemcpy422( const muImage_t* src, muImage_t* dst, MU
 /* DownScale */
 MU_API(muError_t) muDownScaleMemcpy420( const muImage_t* src, muImage_t* dst, MU_32S v_scale, MU_32S h_scale);
 
+/* Bilinear affine warp, m maps the dst coordinates to the src coordinates */
+MU_API(muError_t) muWarpAffine( const muImage_t* src, muImage_t* dst, const MU_64F *m);
+
+/* Inverse of a 2x3 affine matrix */
+MU_API(muError_t) muInvertAffine( const MU_64F *m, MU_64F *inv);
+
 /* Neareast Image Rotation */
 MU_API(muImage_t*) muImageRotate(const muImage_t *src, MU_64F angle);
 
@@ -120,6 +241,14 @@ MU_API(muError_t) muISOThresholding(const muImage_t *src, muImage_t *dst);
 
 MU_API(muError_t) muMeanThresholding(const muImage_t *src, muImage_t *dst, MU_8U offset);
 
+#define MU_ADAPTIVE_BRADLEY 0 // threshold = mean*(1-k)
+#define MU_ADAPTIVE_SAUVOLA 1 // threshold = mean*(1+k*(std/128-1))
+
+/* Local thresholding with winsize*winsize windows at O(1) per pixel by integral image.
+   ii can reuse an integral image already calculated for detection, or be NULL */
+MU_API(muError_t) muAdaptiveThresholding(const muImage_t *src, muImage_t *dst, const muIntegralImg_t *ii,
+										  MU_32S winsize, MU_32S method, MU_64F k);
+
 /* This routine transform the RGB plane to the Y plane. */
 MU_API(muError_t) muRGB2GrayLevel(const muImage_t * src, muImage_t * dst);
 
@@ -165,9 +294,79 @@ MU_API(muPoint_t) muFindGravityCenter(muImage_t *binary_img);
 /* */
 MU_API(muError_t) muHoleFillingByLabelImage(muImage_t *label_img, muImage_t *binary_img, muBoundingBox_t *box);
 
+/* Contour of muFindContours, the points are stored in muContours_t.points[first .. first+count-1] */
+typedef struct _muContour
+{
+	MU_32S first;        /* index of the first point */
+	MU_32S count;        /* number of points */
+	MU_32S parent;       /* index of the enclosing contour, -1 for the top level */
+	MU_32S hole;         /* 0 - outer border, 1 - hole border */
+	MU_32S label;        /* component label (muFindContoursByLabel), else 0 */
+	muRect_t rect;       /* bounding rectangle */
+}muContour_t;
+
+typedef struct _muContours
+{
+	muPoint_t *points;   /* points of all contours in one buffer */
+	MU_32S total;
+	MU_32S pointcapacity;
+	muContour_t *contour;
+	MU_32S count;
+	MU_32S capacity;
+}muContours_t;
+
+/* Contour storage, cleared storage keeps its buffers for the next frame */
+MU_API(muContours_t*) muCreateContours(MU_32S pointcapacity, MU_32S contourcapacity);
+MU_API(MU_VOID) muClearContours(muContours_t *contours);
+MU_API(muError_t) muReleaseContours(muContours_t **contours);
+
+/* Suzuki-Abe border following of the non-zero pixels inside rect (zero size = whole image) */
+MU_API(muError_t) muFindContours(const muImage_t *src, muRect_t rect, muContours_t *contours);
+
+/* Border following of each labeled component inside its own bounding box only */
+MU_API(muError_t) muFindContoursByLabel(const muImage_t *labelimg, muSeq_t *boxes, muContours_t *contours);
+
+/* Douglas-Peucker polygon simplification */
+MU_API(muError_t) muApproxPolyDP(const muPoint_t *src, MU_32S count, MU_64F epsilon, MU_32S closed, muPoint_t *dst, MU_32S *dstcount);
+
+/* Convex hull (monotone chain) */
+MU_API(muError_t) muConvexHull(const muPoint_t *src, MU_32S count, muPoint_t *hull, MU_32S *hullcount);
+
 /* */
 MU_API(muError_t) muIntegralImage(const muImage_t *src, muImage_t *ii);
 
+/* Tiled integral image: 32-bit local integrals per tile plus 64-bit tile corner and strip
+   offsets, no overflow at any frame size. Tiles overlap by margin pixels */
+typedef struct _muTiledIntegral
+{
+  muSize_t imgSize;
+  MU_32S tileshift;    // tile = 1 << tileshift
+  MU_32S tile;
+  MU_32S margin;       // a tile covers tile+margin pixels
+  MU_32S cols, rows;   // tile grid
+  MU_32S step;         // row step of a local integral, tile+margin+1
+  MU_32S *sum;         // local integrals, step*step per tile
+  MU_32U *sqsum;       // local squared integrals
+  MU_64S *cornersum;   // sum above and left of each tile
+  MU_64U *cornersq;
+  MU_64S *rowsum;      // rows*(width+1), sum above the tile row from the tile start
+  MU_64U *rowsq;
+  MU_64S *colsum;      // cols*(height+1), sum left of the tile column from the tile start
+  MU_64U *colsq;
+}muTiledIntegral_t;
+
+MU_API(muTiledIntegral_t*) muCreateTiledIntegral(muSize_t size, MU_32S tileshift, MU_32S margin);
+
+MU_API(muError_t) muReleaseTiledIntegral(muTiledIntegral_t **ti);
+
+MU_API(muError_t) muTiledIntegral(const muImage_t *src, muTiledIntegral_t *ti);
+
+MU_API(MU_64S) muTiledIntegralPoint(const muTiledIntegral_t *ti, MU_32S x, MU_32S y);
+
+MU_API(MU_64U) muTiledIntegralPointSq(const muTiledIntegral_t *ti, MU_32S x, MU_32S y);
+
+MU_API(muError_t) muTiledIntegralSum(const muTiledIntegral_t *ti, muRect_t rect, MU_64S *sum, MU_64U *sqsum);
+
 /********* Morphological processing ***************/
 
 /* erodes input image (applies minimum filter) one or more times.
@@ -199,6 +398,13 @@ MU_API (muError_t) muGrayDilate33(const muImage_t *src, muImage_t *dst, MU_8U *s
 MU_API (muError_t) muGrayErode33(const muImage_t *src, muImage_t *dst, MU_8U *se);
 
 
+#define MU_DIST_EUCLIDEAN   0 // exact euclidean distance, linear time
+#define MU_DIST_CHAMFER33   1 // 3x3 chamfer approximation
+
+/* Distance from every non-zero pixel to the nearest zero pixel, dst is MU_IMG_DEPTH_32F */
+MU_API (muError_t) muDistanceTransform(const muImage_t *src, muImage_t *dst, MU_32S type);
+
+
 /********* Logic processing ***************/
 
 /* And operation between two images */
@@ -220,6 +426,86 @@ MU_API (muError_t) muHistogramBlk(muImage_t* src, MU_16U* histBlkResult, MU_8U w
 
 MU_API (MU_16U*) muCreateHistogramBlk(MU_32S blkNumH, MU_32S blkNumV);
 
+/******** Lookup table processing ********/
+/* dst = lut[src] for 8-bit 1/3 channel images, lutchannels = 1 (shared table) or 3 (per channel) */
+MU_API (muError_t) muApplyLUT(const muImage_t *src, muImage_t *dst, const MU_8U *lut, MU_32S lutchannels);
+
+/* LUT builders, each fills a 256-entry table */
+MU_API (muError_t) muBuildStretchLUT(MU_8U minvalue, MU_8U maxvalue, MU_8U stretchvalue, MU_8U *lut);
+
+MU_API (muError_t) muBuildGammaLUT(MU_64F gamma, MU_8U *lut);
+
+MU_API (muError_t) muBuildEqualizationLUT(const MU_32U *hist, MU_8U *lut);
+
+MU_API (muError_t) muBuildThresholdLUT(muDoubleThreshold_t th, MU_8U *lut);
+
+/******** Frame context ********/
+#define MU_FRAME_PYRAMID_LEVELS 6
+
+/* derived data of one frame, computed on the first request and shared by all consumers
+   (muObjectDetection_Frame, muDetectCamTampering_Frame, muBackgroundModelingFrame) */
+typedef struct _muFrameContext
+{
+  muSize_t size;
+  MU_32U frameid;                               // incremented by every muFrameContextSetFrame
+  MU_32U valid;                                 // derivatives computed for the current frame
+  const muImage_t *frame;                       // current frame, not owned
+  muImage_t *gray;
+  muImage_t *pyramid[MU_FRAME_PYRAMID_LEVELS];  // level 0 is the gray image
+  muImage_t *gradient;
+  muIntegralImg_t integral;                     // sqsum is NULL until computed for the current frame
+  MU_64F *sqbuf;                                // squared integral buffer, kept across frames
+  MU_32U hist[256];
+}muFrameContext_t;
+
+MU_API (muFrameContext_t*) muCreateFrameContext(muSize_t size);
+
+MU_API (muError_t) muReleaseFrameContext(muFrameContext_t **ctx);
+
+MU_API (muError_t) muFrameContextSetFrame(muFrameContext_t *ctx, const muImage_t *frame);
+
+MU_API (const muImage_t*) muFrameGray(muFrameContext_t *ctx);
+
+MU_API (const muIntegralImg_t*) muFrameIntegral(muFrameContext_t *ctx, MU_32S withsq);
+
+MU_API (const muImage_t*) muFramePyramid(muFrameContext_t *ctx, MU_32S level);
+
+MU_API (const muImage_t*) muFrameGradient(muFrameContext_t *ctx);
+
+MU_API (const MU_32U*) muFrameHistogram(muFrameContext_t *ctx);
+
+/******** Tile change map ********/
+/* changed tiles between consecutive frames, with a per tile result cache */
+typedef struct _muTileChange
+{
+  muSize_t size;       // frame size
+  MU_32S tile;         // tile size
+  MU_32S cols, rows;   // tile grid
+  MU_32S threshold;    // mean absolute difference of a changed tile
+  MU_32U frameid;      // frames seen
+  MU_8U *changed;      // cols*rows, 1 = changed in the last frame
+  MU_32S nchanged;     // changed tiles in the last frame
+  muRect_t bound;      // bounding rect of the changed tiles
+  muImage_t *ref;      // reference frame
+  MU_32S cachesize;    // bytes of a cached tile result
+  MU_8U *cache;        // cols*rows*cachesize
+  MU_8U *cachevalid;   // cols*rows
+}muTileChange_t;
+
+MU_API (muTileChange_t*) muCreateTileChange(muSize_t size, MU_32S tile, MU_32S threshold, MU_32S cachesize);
+
+MU_API (muError_t) muReleaseTileChange(muTileChange_t **tc);
+
+MU_API (muError_t) muUpdateTileChange(muTileChange_t *tc, const muImage_t *frame);
+
+MU_API (MU_32S) muTileChanged(const muTileChange_t *tc, muRect_t rect);
+
+MU_API (MU_VOID*) muTileCacheGet(muTileChange_t *tc, MU_32S col, MU_32S row);
+
+MU_API (muError_t) muTileCacheSet(muTileChange_t *tc, MU_32S col, MU_32S row, const MU_VOID *result);
+
+MU_API (muError_t) muTileCacheInvalidate(muTileChange_t *tc, muRect_t rect);
+
 /******** Motion detection ********/
 MU_API (muError_t) muLKOpticalFlow(muImage_t *imageI, muImage_t *imageJ, MU_32S *vectorX, MU_32S *vectorY, MU_32S *lostTable);
 
@@ -227,6 +513,53 @@ MU_API (muError_t) muTransVector2Angle(muImage_t *curFrame, MU_32S *vectorX, MU_
 
 MU_API (muError_t) muGetVectorImage(MU_32S *angleMap, muImage_t *src, muImage_t *dst);
 
+/* global motion between consecutive frames, m maps the previous frame to the current one */
+enum
+{
+  MU_MOTION_TRANSLATION = 0,
+  MU_MOTION_SIMILARITY,
+  MU_MOTION_AFFINE,
+};
+
+typedef struct _muGlobalMotion
+{
+  MU_32S model;       // MU_MOTION_TRANSLATION / SIMILARITY / AFFINE
+  MU_32S scale;       // downscale factor 1, 2 or 4
+  muSize_t size;      // full resolution frame size
+  MU_64F m[6];        // last estimate, 2x3 in full resolution
+  MU_32S blocks;      // matched blocks of the last estimate
+  MU_32S inliers;     // RANSAC inliers of the last estimate
+  MU_32S initialized;
+  muImage_t *prev;    // downscaled previous frame
+  muImage_t *cur;     // downscaled current frame
+  muFFTPlan_t *plan;
+}muGlobalMotion_t;
+
+MU_API (muGlobalMotion_t*) muCreateGlobalMotion(muSize_t size, MU_32S model, MU_32S scale);
+
+MU_API (muError_t) muEstimateGlobalMotion(muGlobalMotion_t *gm, const muImage_t *frame, MU_64F *m);
+
+MU_API (muError_t) muReleaseGlobalMotion(muGlobalMotion_t **gm);
+
+/* hue model, back-projection and mean-shift / CamShift tracking */
+typedef struct _muHueModel
+{
+  MU_32S bins;         // hue bins over 0~359
+  MU_32S smin;         // minimal saturation (0~100) of a counted pixel
+  MU_32S vmin;         // minimal value (0~100) of a counted pixel
+  MU_32F hist[360];    // hue histogram, max bin = 255
+  MU_8U hue[360];      // hue -> probability
+  MU_8U rgb[32768];    // 5:5:5 quantized BGR -> probability
+}muHueModel_t;
+
+MU_API (muError_t) muHueHistogram(const muImage_t *src, muRect_t rect, MU_32S bins, MU_32S smin, MU_32S vmin, muHueModel_t *model);
+
+MU_API (muError_t) muHueBackProject(const muImage_t *src, const muHueModel_t *model, muRect_t rect, muImage_t *prob);
+
+MU_API (muError_t) muMeanShift(const muImage_t *prob, muRect_t search, muRect_t *window, MU_32S maxiter, MU_64F eps, MU_32S *iterations);
+
+MU_API (muError_t) muCamShift(const muImage_t *prob, muRect_t search, muRect_t *window, MU_32S maxiter, MU_64F eps, muBox2D_t *box);
+
 
 /******** Image Matching ********/
 typedef struct _muMSEInfo
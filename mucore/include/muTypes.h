@@ -461,6 +461,7 @@ typedef struct _muIntegralImg
     double *tilted;
     muSize_t sumSize;
     muSize_t imgSize;
+    muPoint_t origin; //top-left of the integrated region, (0,0) for a whole image
 } muIntegralImg_t;
 
 
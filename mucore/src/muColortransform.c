@@ -56,7 +56,8 @@
 muError_t muContraststretching(muImage_t *src, muImage_t *dst, MU_8U maxvalue)
 {
 	MU_8U maxtemp = 0, mintemp = 255;
-	MU_8U *in, *out;
+	MU_8U *in;
+	MU_8U lut[256];
 	MU_32S i;
 	MU_32S width,height;
 	muError_t ret;
@@ -67,13 +68,12 @@ muError_t muContraststretching(muImage_t *src, muImage_t *dst, MU_8U maxvalue)
 		return ret;
 	}
 
-	if(src->channels != 1 || src->channels != 1)
+	if(src->channels != 1 || dst->channels != 1)
 	{
 		return MU_ERR_NOT_SUPPORT;
 	}
 
 	in = src->imagedata;
-	out = dst->imagedata;
 
 	width  = dst->width;
 	height = dst->height;
@@ -85,17 +85,9 @@ muError_t muContraststretching(muImage_t *src, muImage_t *dst, MU_8U maxvalue)
 		mintemp = in[i] < mintemp ? in[i] : mintemp;
 	}while(i--);
 
+	muBuildStretchLUT(mintemp, maxtemp, maxvalue, lut);
 
-	i = width*height;
-	do
-	{
-		*out = (MU_8U)(((MU_32F)(*in-mintemp)/(MU_32F)(maxtemp-mintemp))*maxvalue);
-		in++;
-		out++;
-	}while(--i);
-
-
-	return MU_ERR_SUCCESS; 
+	return muApplyLUT(src, dst, lut, 1);
 }
 
 
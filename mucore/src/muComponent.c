@@ -297,12 +297,12 @@ muSeq_t * muFindBoundingBox(const muImage_t * image, MU_8U numlabel,  muDoubleTh
 				{
 					if(x < minx)
 						minx = x;
-					else if( x > maxx)
+					if( x > maxx)
 						maxx = x;
 
 					if(y < miny)
 						miny = y;
-					else if( y > maxy)
+					if( y > maxy)
 						maxy = y;
 
 					area++;  
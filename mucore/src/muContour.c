@@ -0,0 +1,643 @@
+/*
+% MIT License
+%
+% Copyright (c) 2016 OneCV
+%
+% Permission is hereby granted, free of charge, to any person obtaining a copy
+% of this software and associated documentation files (the "Software"), to deal
+% in the Software without restriction, including without limitation the rights
+% to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+% copies of the Software, and to permit persons to whom the Software is
+% furnished to do so, subject to the following conditions:
+%
+% The above copyright notice and this permission notice shall be included in all
+% copies or substantial portions of the Software.
+%
+% THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+% IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+% FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+% AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+% LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+% OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+% SOFTWARE.
+*/
+
+/* ------------------------------------------------------------------------- /
+ *
+ * Module: muContour.c
+ * Author: Joe Lin
+ *
+ * Description:
+ *    Contour retrieval (Suzuki-Abe border following), polygon approximation
+ *    (Douglas-Peucker) and convex hull.
+ *
+ -------------------------------------------------------------------------- */
+
+#include "muCore.h"
+
+/* 8-neighbourhood, counterclockwise on screen starting from east */
+static const MU_32S dirX[8] = { 1,  1,  0, -1, -1, -1,  0,  1 };
+static const MU_32S dirY[8] = { 0, -1, -1, -1,  0,  1,  1,  1 };
+
+/*===========================================================================================*/
+/*   muCreateContours / muClearContours / muReleaseContours                                  */
+/*                                                                                           */
+/*   DESCRIPTION:                                                                            */
+/*   The contour storage keeps all points of all contours in one contiguous buffer, each     */
+/*   muContour_t addresses its points by first/count. Buffers grow on demand, clear keeps    */
+/*   the allocation so the storage can be reused frame by frame.                             */
+/*===========================================================================================*/
+muContours_t* muCreateContours(MU_32S pointcapacity, MU_32S contourcapacity)
+{
+	muContours_t *contours;
+
+	contours = (muContours_t *)calloc(1, sizeof(muContours_t));
+	if(contours == NULL)
+	{
+		return NULL;
+	}
+
+	contours->pointcapacity = pointcapacity > 64 ? pointcapacity : 64;
+	contours->capacity = contourcapacity > 8 ? contourcapacity : 8;
+	contours->points = (muPoint_t *)malloc(contours->pointcapacity*sizeof(muPoint_t));
+	contours->contour = (muContour_t *)malloc(contours->capacity*sizeof(muContour_t));
+
+	if(contours->points == NULL || contours->contour == NULL)
+	{
+		muReleaseContours(&contours);
+		return NULL;
+	}
+
+	return contours;
+}
+
+MU_VOID muClearContours(muContours_t *contours)
+{
+	if(contours)
+	{
+		contours->total = 0;
+		contours->count = 0;
+	}
+}
+
+muError_t muReleaseContours(muContours_t **contours)
+{
+	if(contours == NULL || *contours == NULL)
+	{
+		return MU_ERR_NULL_POINTER;
+	}
+
+	free((*contours)->points);
+	free((*contours)->contour);
+	free(*contours);
+	*contours = NULL;
+
+	return MU_ERR_SUCCESS;
+}
+
+static muError_t pushContourPoint(muContours_t *contours, MU_32S x, MU_32S y)
+{
+	if(contours->total == contours->pointcapacity)
+	{
+		muPoint_t *buf = (muPoint_t *)realloc(contours->points, 2*contours->pointcapacity*sizeof(muPoint_t));
+		if(buf == NULL)
+		{
+			return MU_ERR_OUT_OF_MEMORY;
+		}
+		contours->points = buf;
+		contours->pointcapacity *= 2;
+	}
+
+	contours->points[contours->total].x = x;
+	contours->points[contours->total].y = y;
+	contours->total++;
+
+	return MU_ERR_SUCCESS;
+}
+
+static muContour_t* pushContour(muContours_t *contours)
+{
+	if(contours->count == contours->capacity)
+	{
+		muContour_t *buf = (muContour_t *)realloc(contours->contour, 2*contours->capacity*sizeof(muContour_t));
+		if(buf == NULL)
+		{
+			return NULL;
+		}
+		contours->contour = buf;
+		contours->capacity *= 2;
+	}
+
+	return &contours->contour[contours->count++];
+}
+
+/* border following of Suzuki-Abe, step 3.1-3.5. f is the padded working image */
+static muError_t followBorder(MU_32S *f, MU_32S step, MU_32S x, MU_32S y, MU_32S startdir,
+							  MU_32S nbd, muPoint_t offset, muContours_t *contours, muContour_t *c)
+{
+	MU_32S d, k, x1, y1, x3, y3, x4, y4, dir;
+	MU_32S minx, miny, maxx, maxy;
+	MU_32S *p;
+
+	/* 3.1 clockwise from (i2,j2) for a non-zero pixel */
+	for(k=0, d=startdir; k<8; k++, d=(d+7)&7)
+	{
+		if(f[(y+dirY[d])*step + x+dirX[d]] != 0)
+			break;
+	}
+
+	minx = maxx = x;
+	miny = maxy = y;
+
+	if(k == 8)
+	{
+		/* isolated pixel */
+		f[y*step+x] = -nbd;
+		c->first = contours->total;
+		c->count = 1;
+		c->rect = muRect(x+offset.x, y+offset.y, 1, 1);
+		return pushContourPoint(contours, x+offset.x, y+offset.y);
+	}
+
+	/* 3.2 */
+	x1 = x+dirX[d];
+	y1 = y+dirY[d];
+	x3 = x;
+	y3 = y;
+	dir = d;
+
+	c->first = contours->total;
+
+	for(;;)
+	{
+		MU_32S eastzero = 0;
+
+		/* 3.3 counterclockwise from the next element of (i2,j2) */
+		for(k=0, d=(dir+1)&7; k<8; k++, d=(d+1)&7)
+		{
+			x4 = x3+dirX[d];
+			y4 = y3+dirY[d];
+			if(f[y4*step+x4] != 0)
+				break;
+			if(d == 0)
+				eastzero = 1;
+		}
+
+		/* 3.4 */
+		p = &f[y3*step+x3];
+		if(eastzero)
+			*p = -nbd;
+		else if(*p == 1)
+			*p = nbd;
+
+		if(pushContourPoint(contours, x3+offset.x, y3+offset.y))
+			return MU_ERR_OUT_OF_MEMORY;
+
+		minx = x3 < minx ? x3 : minx;
+		maxx = x3 > maxx ? x3 : maxx;
+		miny = y3 < miny ? y3 : miny;
+		maxy = y3 > maxy ? y3 : maxy;
+
+		/* 3.5 */
+		if(x4 == x && y4 == y && x3 == x1 && y3 == y1)
+			break;
+
+		/* the direction from (i4,j4) back to (i3,j3) */
+		dir = (d+4)&7;
+		x3 = x4;
+		y3 = y4;
+	}
+
+	c->count = contours->total - c->first;
+	c->rect = muRect(minx+offset.x, miny+offset.y, maxx-minx+1, maxy-miny+1);
+
+	return MU_ERR_SUCCESS;
+}
+
+static muError_t traceContours(const muImage_t *src, muRect_t roi, MU_32S value, MU_32S label, muContours_t *contours)
+{
+	MU_32S x, y, step, nbd, lnbd, base;
+	MU_32S *f;
+	MU_32S *btype, *bparent;
+	MU_32S maxnbd;
+	muPoint_t offset;
+	muError_t ret = MU_ERR_SUCCESS;
+
+	step = roi.width+2;
+	f = (MU_32S *)calloc(step*(roi.height+2), sizeof(MU_32S));
+	maxnbd = 256;
+	btype = (MU_32S *)malloc(maxnbd*sizeof(MU_32S));
+	bparent = (MU_32S *)malloc(maxnbd*sizeof(MU_32S));
+	if(f == NULL || btype == NULL || bparent == NULL)
+	{
+		free(f);
+		free(btype);
+		free(bparent);
+		return MU_ERR_OUT_OF_MEMORY;
+	}
+
+	/* binarize into the padded buffer, 1 = object */
+	for(y=0; y<roi.height; y++)
+	{
+		const MU_8U *in = src->imagedata + (roi.y+y)*src->width + roi.x;
+		MU_32S *out = f + (y+1)*step + 1;
+		if(value)
+		{
+			for(x=0; x<roi.width; x++)
+				out[x] = in[x] == value;
+		}
+		else
+		{
+			for(x=0; x<roi.width; x++)
+				out[x] = in[x] != 0;
+		}
+	}
+
+	/* padded coordinate (1,1) = roi (0,0) */
+	offset.x = roi.x-1;
+	offset.y = roi.y-1;
+
+	/* nbd = 1 is the frame, it is a hole border without parent */
+	base = contours->count;
+	nbd = 1;
+	btype[1] = 1;
+	bparent[1] = -1;
+
+	for(y=1; y<=roi.height && ret == MU_ERR_SUCCESS; y++)
+	{
+		lnbd = 1;
+		for(x=1; x<=roi.width; x++)
+		{
+			MU_32S *p = &f[y*step+x];
+			MU_32S hole, startdir, parent;
+			muContour_t *c;
+
+			if(*p == 1 && p[-1] == 0)
+			{
+				hole = 0;
+				startdir = 4;
+			}
+			else if(*p >= 1 && p[1] == 0)
+			{
+				hole = 1;
+				startdir = 0;
+				if(*p > 1)
+					lnbd = *p;
+			}
+			else
+			{
+				if(*p != 0 && *p != 1)
+					lnbd = *p < 0 ? -*p : *p;
+				continue;
+			}
+
+			nbd++;
+			if(nbd == maxnbd)
+			{
+				MU_32S *t1 = (MU_32S *)realloc(btype, 2*maxnbd*sizeof(MU_32S));
+				MU_32S *t2 = t1 ? (MU_32S *)realloc(bparent, 2*maxnbd*sizeof(MU_32S)) : NULL;
+				if(t1)
+					btype = t1;
+				if(t2 == NULL)
+				{
+					ret = MU_ERR_OUT_OF_MEMORY;
+					break;
+				}
+				bparent = t2;
+				maxnbd *= 2;
+			}
+
+			/* parent from the type of the last met border (Table 1 of Suzuki-Abe) */
+			if(hole == btype[lnbd])
+				parent = bparent[lnbd];
+			else
+				parent = lnbd;
+			btype[nbd] = hole;
+			bparent[nbd] = parent;
+
+			c = pushContour(contours);
+			if(c == NULL)
+			{
+				ret = MU_ERR_OUT_OF_MEMORY;
+				break;
+			}
+			c->hole = hole;
+			c->label = label;
+			c->parent = parent > 1 ? base + parent - 2 : -1;
+
+			ret = followBorder(f, step, x, y, startdir, nbd, offset, contours, c);
+			if(ret)
+				break;
+
+			if(*p != 1)
+				lnbd = *p < 0 ? -*p : *p;
+		}
+	}
+
+	free(f);
+	free(btype);
+	free(bparent);
+
+	return ret;
+}
+
+/*===========================================================================================*/
+/*   muFindContours                                                                          */
+/*                                                                                           */
+/*   DESCRIPTION:                                                                            */
+/*   Retrieves the outer and hole borders of the non-zero components of a binary image by    */
+/*   the Suzuki-Abe border following. The contours are appended to the storage with their    */
+/*   hierarchy: parent is the index of the enclosing border (-1 for the top level).          */
+/*                                                                                           */
+/*   NOTE                                                                                    */
+/*   Only the pixels inside rect are visited (pass muRect(0,0,0,0) for the whole image),     */
+/*   the coordinates of the points are in the image coordinate.                              */
+/*                                                                                           */
+/*   USAGE                                                                                   */
+/*   muImage_t *src --> binary image (8-bit, 1 channel)                                      */
+/*   muRect_t rect --> scan region                                                           */
+/*   muContours_t *contours --> contour storage (muCreateContours)                           */
+/*===========================================================================================*/
+muError_t muFindContours(const muImage_t *src, muRect_t rect, muContours_t *contours)
+{
+	muError_t ret;
+
+	ret = muCheckDepth(2, src, MU_IMG_DEPTH_8U);
+	if(ret)
+	{
+		return ret;
+	}
+
+	if(src->channels != 1)
+	{
+		return MU_ERR_NOT_SUPPORT;
+	}
+
+	if(contours == NULL)
+	{
+		return MU_ERR_NULL_POINTER;
+	}
+
+	if(rect.width <= 0 || rect.height <= 0)
+		rect = muRect(0, 0, src->width, src->height);
+
+	if(rect.x < 0 || rect.y < 0 || rect.x+rect.width > src->width || rect.y+rect.height > src->height)
+	{
+		return MU_ERR_INVALID_PARAMETER;
+	}
+
+	return traceContours(src, rect, 0, 0, contours);
+}
+
+/*===========================================================================================*/
+/*   muFindContoursByLabel                                                                   */
+/*                                                                                           */
+/*   DESCRIPTION:                                                                            */
+/*   Retrieves the contours of labeled components inside their own bounding boxes only, so   */
+/*   only the blob regions are visited instead of the whole frame.                           */
+/*                                                                                           */
+/*   USAGE                                                                                   */
+/*   muImage_t *labelimg --> label image of mu4ConnectedComponent8u                          */
+/*   muSeq_t *boxes --> muBoundingBox_t sequence of muFindBoundingBox                        */
+/*   muContours_t *contours --> contour storage, muContour_t.label is the component label    */
+/*===========================================================================================*/
+muError_t muFindContoursByLabel(const muImage_t *labelimg, muSeq_t *boxes, muContours_t *contours)
+{
+	muSeqBlock_t *cur;
+	muError_t ret;
+
+	ret = muCheckDepth(2, labelimg, MU_IMG_DEPTH_8U);
+	if(ret)
+	{
+		return ret;
+	}
+
+	if(labelimg->channels != 1)
+	{
+		return MU_ERR_NOT_SUPPORT;
+	}
+
+	if(boxes == NULL || contours == NULL)
+	{
+		return MU_ERR_NULL_POINTER;
+	}
+
+	for(cur = boxes->first; cur != NULL; cur = cur->next)
+	{
+		muBoundingBox_t *box = (muBoundingBox_t *)cur->data;
+		muRect_t roi;
+
+		roi.x = box->minx < 0 ? 0 : box->minx;
+		roi.y = box->miny < 0 ? 0 : box->miny;
+		roi.width = (box->maxx >= labelimg->width ? labelimg->width-1 : box->maxx) - roi.x + 1;
+		roi.height = (box->maxy >= labelimg->height ? labelimg->height-1 : box->maxy) - roi.y + 1;
+
+		if(roi.width <= 0 || roi.height <= 0 || box->label <= 0)
+			continue;
+
+		ret = traceContours(labelimg, roi, box->label, box->label, contours);
+		if(ret)
+			return ret;
+	}
+
+	return MU_ERR_SUCCESS;
+}
+
+/* distance^2 from p to the segment a-b, scaled by |ab|^2 (avoids sqrt/div per point) */
+static MU_64F segmentDistance(muPoint_t p, muPoint_t a, muPoint_t b, MU_64F *norm)
+{
+	MU_64F dx = b.x - a.x, dy = b.y - a.y;
+	MU_64F cross;
+
+	*norm = dx*dx + dy*dy;
+	if(*norm == 0)
+	{
+		*norm = 1;
+		return (MU_64F)(p.x-a.x)*(p.x-a.x) + (MU_64F)(p.y-a.y)*(p.y-a.y);
+	}
+
+	cross = dx*(p.y - a.y) - dy*(p.x - a.x);
+	return cross*cross;
+}
+
+/*===========================================================================================*/
+/*   muApproxPolyDP                                                                          */
+/*                                                                                           */
+/*   DESCRIPTION:                                                                            */
+/*   Douglas-Peucker polygon simplification. Points deviating less than epsilon from the     */
+/*   approximated polyline are removed.                                                      */
+/*                                                                                           */
+/*   USAGE                                                                                   */
+/*   muPoint_t *src, MU_32S count --> input polyline (e.g. contour points)                   */
+/*   MU_64F epsilon --> maximal distance in pixel                                            */
+/*   MU_32S closed --> 1 if the polyline is closed (contour)                                 */
+/*   muPoint_t *dst --> output vertices, at least count elements                             */
+/*   MU_32S *dstcount --> number of output vertices                                          */
+/*===========================================================================================*/
+muError_t muApproxPolyDP(const muPoint_t *src, MU_32S count, MU_64F epsilon, MU_32S closed,
+						 muPoint_t *dst, MU_32S *dstcount)
+{
+	MU_8U *keep;
+	MU_32S *stack;
+	MU_32S sp = 0, i, n, far = 0;
+	MU_64F eps2 = epsilon*epsilon;
+
+	if(src == NULL || dst == NULL || dstcount == NULL)
+	{
+		return MU_ERR_NULL_POINTER;
+	}
+
+	if(count <= 2)
+	{
+		for(i=0; i<count; i++)
+			dst[i] = src[i];
+		*dstcount = count;
+		return MU_ERR_SUCCESS;
+	}
+
+	keep = (MU_8U *)calloc(count, sizeof(MU_8U));
+	stack = (MU_32S *)malloc(2*(count+1)*sizeof(MU_32S));
+	if(keep == NULL || stack == NULL)
+	{
+		free(keep);
+		free(stack);
+		return MU_ERR_OUT_OF_MEMORY;
+	}
+
+	keep[0] = 1;
+	if(closed)
+	{
+		/* split the ring at the farthest point from the first one */
+		MU_64F best = -1;
+		for(i=1; i<count; i++)
+		{
+			MU_64F d = (MU_64F)(src[i].x-src[0].x)*(src[i].x-src[0].x) + (MU_64F)(src[i].y-src[0].y)*(src[i].y-src[0].y);
+			if(d > best)
+			{
+				best = d;
+				far = i;
+			}
+		}
+		keep[far] = 1;
+		stack[sp++] = 0;   stack[sp++] = far;
+		stack[sp++] = far; stack[sp++] = count;
+	}
+	else
+	{
+		keep[count-1] = 1;
+		stack[sp++] = 0;   stack[sp++] = count-1;
+	}
+
+	while(sp > 0)
+	{
+		MU_32S b = stack[--sp];
+		MU_32S a = stack[--sp];
+		MU_32S idx = -1;
+		MU_64F dmax = 0, norm = 1;
+		muPoint_t pa = src[a], pb = src[b % count];
+
+		for(i=a+1; i<b; i++)
+		{
+			MU_64F d = segmentDistance(src[i], pa, pb, &norm);
+			if(d > dmax)
+			{
+				dmax = d;
+				idx = i;
+			}
+		}
+
+		if(idx >= 0 && dmax > eps2*norm)
+		{
+			keep[idx] = 1;
+			stack[sp++] = a;   stack[sp++] = idx;
+			stack[sp++] = idx; stack[sp++] = b;
+		}
+	}
+
+	for(i=0, n=0; i<count; i++)
+	{
+		if(keep[i])
+			dst[n++] = src[i];
+	}
+	*dstcount = n;
+
+	free(keep);
+	free(stack);
+
+	return MU_ERR_SUCCESS;
+}
+
+static int comparePoint(const void *a, const void *b)
+{
+	const muPoint_t *p = (const muPoint_t *)a, *q = (const muPoint_t *)b;
+
+	if(p->x != q->x)
+		return p->x < q->x ? -1 : 1;
+	if(p->y != q->y)
+		return p->y < q->y ? -1 : 1;
+	return 0;
+}
+
+/*===========================================================================================*/
+/*   muConvexHull                                                                            */
+/*                                                                                           */
+/*   DESCRIPTION:                                                                            */
+/*   Convex hull by the monotone chain algorithm, O(n log n). The hull vertices are listed   */
+/*   clockwise on screen (y axis downward) starting from the leftmost point, collinear       */
+/*   points are removed.                                                                     */
+/*                                                                                           */
+/*   USAGE                                                                                   */
+/*   muPoint_t *src, MU_32S count --> input points                                           */
+/*   muPoint_t *hull --> output vertices, at least count elements                            */
+/*   MU_32S *hullcount --> number of output vertices                                         */
+/*===========================================================================================*/
+muError_t muConvexHull(const muPoint_t *src, MU_32S count, muPoint_t *hull, MU_32S *hullcount)
+{
+	muPoint_t *pts, *h;
+	MU_32S i, k = 0, t;
+
+	if(src == NULL || hull == NULL || hullcount == NULL)
+	{
+		return MU_ERR_NULL_POINTER;
+	}
+
+	pts = (muPoint_t *)malloc(count*sizeof(muPoint_t));
+	h = (muPoint_t *)malloc(2*(count+1)*sizeof(muPoint_t));
+	if(pts == NULL || h == NULL)
+	{
+		free(pts);
+		free(h);
+		return MU_ERR_OUT_OF_MEMORY;
+	}
+
+	memcpy(pts, src, count*sizeof(muPoint_t));
+	qsort(pts, count, sizeof(muPoint_t), comparePoint);
+
+	/* lower chain */
+	for(i=0; i<count; i++)
+	{
+		while(k >= 2 && muCrossProduct(muPoint(h[k-1].x-h[k-2].x, h[k-1].y-h[k-2].y),
+			muPoint(pts[i].x-h[k-2].x, pts[i].y-h[k-2].y)) <= 0)
+			k--;
+		h[k++] = pts[i];
+	}
+
+	/* upper chain */
+	for(i=count-2, t=k+1; i>=0; i--)
+	{
+		while(k >= t && muCrossProduct(muPoint(h[k-1].x-h[k-2].x, h[k-1].y-h[k-2].y),
+			muPoint(pts[i].x-h[k-2].x, pts[i].y-h[k-2].y)) <= 0)
+			k--;
+		h[k++] = pts[i];
+	}
+
+	/* the last point equals the first one */
+	k = k > 1 ? k-1 : k;
+	memcpy(hull, h, k*sizeof(muPoint_t));
+	*hullcount = k;
+
+	free(pts);
+	free(h);
+
+	return MU_ERR_SUCCESS;
+}
@@ -0,0 +1,300 @@
+/*
+% MIT License
+%
+% Copyright (c) 2016 OneCV
+%
+% Permission is hereby granted, free of charge, to any person obtaining a copy
+% of this software and associated documentation files (the "Software"), to deal
+% in the Software without restriction, including without limitation the rights
+% to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+% copies of the Software, and to permit persons to whom the Software is
+% furnished to do so, subject to the following conditions:
+%
+% The above copyright notice and this permission notice shall be included in all
+% copies or substantial portions of the Software.
+%
+% THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+% IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+% FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+% AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+% LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+% OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+% SOFTWARE.
+*/
+
+/* ------------------------------------------------------------------------- /
+ *
+ * Module: muDistancetransform.c
+ * Author: Joe Lin
+ *
+ * Description:
+ *    Distance transform of binary masks: exact euclidean (linear time) and
+ *    3x3 chamfer approximation.
+ *
+ -------------------------------------------------------------------------- */
+
+#include "muCore.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/* chamfer 3-4 weights, distance = d/3 */
+#define MU_CHAMFER_A 3
+#define MU_CHAMFER_B 4
+
+/* 1D squared euclidean distance transform of f[0..n-1] (Felzenszwalb & Huttenlocher).
+   v: parabola locations, z: envelope boundaries (n+1) */
+static MU_VOID edt1D(const MU_32F *f, MU_32F *d, MU_32S n, MU_32S *v, MU_32F *z)
+{
+	MU_32S q, k = 0;
+	MU_32F s;
+
+	v[0] = 0;
+	z[0] = -1e20f;
+	z[1] = 1e20f;
+
+	for(q=1; q<n; q++)
+	{
+		s = ((f[q] + (MU_32F)q*q) - (f[v[k]] + (MU_32F)v[k]*v[k])) / (2.0f*(q - v[k]));
+		while(s <= z[k])
+		{
+			k--;
+			s = ((f[q] + (MU_32F)q*q) - (f[v[k]] + (MU_32F)v[k]*v[k])) / (2.0f*(q - v[k]));
+		}
+		k++;
+		v[k] = q;
+		z[k] = s;
+		z[k+1] = 1e20f;
+	}
+
+	k = 0;
+	for(q=0; q<n; q++)
+	{
+		while(z[k+1] < q)
+			k++;
+		d[q] = (MU_32F)(q - v[k])*(q - v[k]) + f[v[k]];
+	}
+}
+
+static muError_t euclideanDistance(const muImage_t *src, muImage_t *dst)
+{
+	MU_32S width = src->width, height = src->height;
+	MU_32S inf = width + height;
+	MU_32S *g;
+	MU_8U *rowbuf;
+	MU_32S x, nthreads = 1;
+	size_t rowsize;
+
+#ifdef _OPENMP
+	nthreads = omp_get_max_threads();
+#endif
+
+	/* column pass: vertical distance to the nearest zero pixel */
+	g = (MU_32S *)malloc(width*height*sizeof(MU_32S));
+	/* f, z and v of the row pass for every thread */
+	rowsize = (3*(size_t)width+1)*sizeof(MU_32S);
+	rowbuf = (MU_8U *)malloc(nthreads*rowsize);
+	if(g == NULL || rowbuf == NULL)
+	{
+		free(g);
+		free(rowbuf);
+		return MU_ERR_OUT_OF_MEMORY;
+	}
+
+	/* every thread scans a strip of columns top-down and bottom-up, row by row */
+#ifdef _OPENMP
+	#pragma omp parallel for schedule(static)
+#endif
+	for(x=0; x<width; x+=64)
+	{
+		MU_32S i, y;
+		MU_32S xe = x+64 > width ? width : x+64;
+		const MU_8U *in = src->imagedata;
+
+		for(i=x; i<xe; i++)
+			g[i] = in[i] ? inf : 0;
+		for(y=1; y<height; y++)
+		{
+			MU_32S *cur = g + y*width, *pre = cur - width;
+			const MU_8U *row = in + y*width;
+			for(i=x; i<xe; i++)
+				cur[i] = row[i] ? pre[i] + 1 : 0;
+		}
+		for(y=height-2; y>=0; y--)
+		{
+			MU_32S *cur = g + y*width, *nxt = cur + width;
+			for(i=x; i<xe; i++)
+				cur[i] = nxt[i] + 1 < cur[i] ? nxt[i] + 1 : cur[i];
+		}
+	}
+
+	/* row pass: lower envelope of parabolas, rows are independent */
+#ifdef _OPENMP
+	#pragma omp parallel
+#endif
+	{
+		MU_32F *f, *z;
+		MU_32S *v;
+		MU_32S y;
+		MU_8U *buf = rowbuf;
+
+#ifdef _OPENMP
+		buf += omp_get_thread_num()*rowsize;
+#endif
+		f = (MU_32F *)buf;
+		z = f + width;
+		v = (MU_32S *)(z + width + 1);
+
+#ifdef _OPENMP
+		#pragma omp for schedule(static)
+#endif
+		for(y=0; y<height; y++)
+		{
+			MU_32S i;
+			MU_32S *grow = g + y*width;
+			MU_32F *out = (MU_32F *)dst->imagedata + y*width;
+
+			for(i=0; i<width; i++)
+				f[i] = (MU_32F)grow[i]*grow[i];
+
+			edt1D(f, out, width, v, z);
+
+			for(i=0; i<width; i++)
+				out[i] = (MU_32F)sqrt(out[i]);
+		}
+	}
+
+	free(g);
+	free(rowbuf);
+
+	return MU_ERR_SUCCESS;
+}
+
+static muError_t chamferDistance(const muImage_t *src, muImage_t *dst)
+{
+	MU_32S width = src->width, height = src->height;
+	MU_32S inf = (width + height)*MU_CHAMFER_B;
+	MU_32S x, y;
+	MU_32S *d, *cur, *adj;
+	const MU_8U *in = src->imagedata;
+	MU_32F *out = (MU_32F *)dst->imagedata;
+
+	/* one guard column on each side keeps the inner loops free of border checks */
+	d = (MU_32S *)malloc((width+2)*height*sizeof(MU_32S));
+	if(d == NULL)
+	{
+		return MU_ERR_OUT_OF_MEMORY;
+	}
+
+	/* forward pass. The dependencies on the previous row are vertical (vectorizable),
+	   only the left neighbour needs a sequential scan */
+	for(y=0; y<height; y++)
+	{
+		cur = d + y*(width+2) + 1;
+		adj = cur - (width+2);
+		cur[-1] = cur[width] = inf;
+
+		if(y == 0)
+		{
+			for(x=0; x<width; x++)
+				cur[x] = in[x] ? inf : 0;
+		}
+		else
+		{
+			for(x=0; x<width; x++)
+			{
+				MU_32S a = adj[x] + MU_CHAMFER_A;
+				MU_32S b = adj[x-1] < adj[x+1] ? adj[x-1] : adj[x+1];
+				b += MU_CHAMFER_B;
+				a = a < b ? a : b;
+				cur[x] = in[y*width+x] ? a : 0;
+			}
+		}
+
+		for(x=1; x<width; x++)
+		{
+			if(cur[x-1] + MU_CHAMFER_A < cur[x])
+				cur[x] = cur[x-1] + MU_CHAMFER_A;
+		}
+	}
+
+	/* backward pass */
+	for(y=height-1; y>=0; y--)
+	{
+		cur = d + y*(width+2) + 1;
+		adj = cur + (width+2);
+
+		if(y < height-1)
+		{
+			for(x=0; x<width; x++)
+			{
+				MU_32S a = adj[x] + MU_CHAMFER_A;
+				MU_32S b = adj[x-1] < adj[x+1] ? adj[x-1] : adj[x+1];
+				b += MU_CHAMFER_B;
+				a = a < b ? a : b;
+				cur[x] = a < cur[x] ? a : cur[x];
+			}
+		}
+
+		for(x=width-2; x>=0; x--)
+		{
+			if(cur[x+1] + MU_CHAMFER_A < cur[x])
+				cur[x] = cur[x+1] + MU_CHAMFER_A;
+		}
+
+		for(x=0; x<width; x++)
+			out[y*width+x] = cur[x]*(1.0f/MU_CHAMFER_A);
+	}
+
+	free(d);
+
+	return MU_ERR_SUCCESS;
+}
+
+/*===========================================================================================*/
+/*   muDistanceTransform                                                                     */
+/*                                                                                           */
+/*   DESCRIPTION:                                                                            */
+/*   For every non-zero pixel of a binary mask, this routine finds the distance to the       */
+/*   nearest zero pixel. One call replaces k passes of muErode33 for distance k.             */
+/*                                                                                           */
+/*   NOTE                                                                                    */
+/*   MU_DIST_EUCLIDEAN: exact euclidean distance in linear time (Felzenszwalb-Huttenlocher   */
+/*                      lower envelope). The column and row passes are parallel.             */
+/*   MU_DIST_CHAMFER33: 3x3 chamfer (3-4) approximation, within ~8% of euclidean.            */
+/*   If the mask has no zero pixel, the distances are larger than width+height.              */
+/*                                                                                           */
+/*   USAGE                                                                                   */
+/*   muImage_t *src --> binary image (8-bit, 1 channel)                                      */
+/*   muImage_t *dst --> distance image (MU_IMG_DEPTH_32F, 1 channel)                         */
+/*   MU_32S type --> MU_DIST_EUCLIDEAN or MU_DIST_CHAMFER33                                  */
+/*===========================================================================================*/
+muError_t muDistanceTransform(const muImage_t *src, muImage_t *dst, MU_32S type)
+{
+	if(src == NULL || dst == NULL)
+	{
+		return MU_ERR_NULL_POINTER;
+	}
+
+	if(src->depth != MU_IMG_DEPTH_8U || dst->depth != MU_IMG_DEPTH_32F ||
+		src->channels != 1 || dst->channels != 1)
+	{
+		return MU_ERR_NOT_SUPPORT;
+	}
+
+	if(src->width != dst->width || src->height != dst->height)
+	{
+		return MU_ERR_INVALID_PARAMETER;
+	}
+
+	switch(type)
+	{
+		case MU_DIST_EUCLIDEAN:
+			return euclideanDistance(src, dst);
+		case MU_DIST_CHAMFER33:
+			return chamferDistance(src, dst);
+		default:
+			return MU_ERR_INVALID_PARAMETER;
+	}
+}
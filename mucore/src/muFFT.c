@@ -0,0 +1,1243 @@
+/*
+% MIT License
+%
+% Copyright (c) 2016 OneCV
+%
+% Permission is hereby granted, free of charge, to any person obtaining a copy
+% of this software and associated documentation files (the "Software"), to deal
+% in the Software without restriction, including without limitation the rights
+% to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+% copies of the Software, and to permit persons to whom the Software is
+% furnished to do so, subject to the following conditions:
+%
+% The above copyright notice and this permission notice shall be included in all
+% copies or substantial portions of the Software.
+%
+% THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+% IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+% FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+% AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+% LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+% OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+% SOFTWARE.
+*/
+
+/* ------------------------------------------------------------------------- /
+ *
+ * Module: muFFT.c
+ * Author: Joe Lin
+ *
+ * Description:
+ *    Mixed radix FFT (2, 3, 4, 5 and generic odd factors), real-input 2-D
+ *    transform, and the frequency domain cross-correlation, phase
+ *    correlation and large kernel convolution built on it.
+ *
+ -------------------------------------------------------------------------- */
+
+#include "muCore.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define MU_FFT_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define MU_FFT_SSE2 1
+#endif
+
+#define FFT_MAX_STAGES 32
+#define FFT_COLUMN_BLOCK 8      /* columns transformed together, one cache line of complex floats */
+
+/* complex FFT of a fixed size, factors are (radix, remaining length) pairs of every stage */
+typedef struct _fftKernel
+{
+	MU_32S n;
+	MU_32S nstage;
+	MU_32S factors[2*FFT_MAX_STAGES];
+	muComplex_t *stagetw[FFT_MAX_STAGES];   /* stage twiddles tw[(q-1)*m + k] = exp(-2pi i qk/(pm)) */
+	muComplex_t *twiddle;                   /* exp(-2pi i j/n), used by the generic radix */
+	muComplex_t *buffer;
+	MU_32S maxradix;
+}fftKernel_t;
+
+struct _muFFTPlan
+{
+	MU_32S width;
+	MU_32S height;
+	MU_32S cols;              /* width/2+1 complex values per spectrum row */
+	fftKernel_t *row;         /* width/2 for even width (real packing), else width */
+	fftKernel_t *col;
+	muComplex_t *super;       /* exp(-2pi i k/width), k = 0..width/2, real packing */
+	muComplex_t *work;        /* height x cols spectrum used by the inverse */
+	MU_32S nthreads;
+	muComplex_t *scratch;     /* per thread, 2 x max(width, FFT_COLUMN_BLOCK*height) */
+	MU_32S scratchsize;
+};
+
+#define CMUL(r, a, b) do { MU_32F _re = (a).re*(b).re - (a).im*(b).im; \
+	(r).im = (a).re*(b).im + (a).im*(b).re; (r).re = _re; } while(0)
+
+static MU_VOID releaseKernel(fftKernel_t *k)
+{
+	if(k)
+	{
+		free(k->buffer);
+		free(k);
+	}
+}
+
+static fftKernel_t* createKernel(MU_32S n)
+{
+	fftKernel_t *k;
+	MU_32S p = 4, m = n, s, total, i, q;
+	muComplex_t *tw;
+
+	k = (fftKernel_t *)calloc(1, sizeof(fftKernel_t));
+	if(k == NULL)
+	{
+		return NULL;
+	}
+
+	k->n = n;
+
+	/* powers of 4 first, then 2, 3, 5 and the remaining odd factors */
+	do
+	{
+		while(m % p)
+		{
+			switch(p)
+			{
+				case 4: p = 2; break;
+				case 2: p = 3; break;
+				default: p += 2; break;
+			}
+			if(p*p > m)
+				p = m;
+		}
+		m /= p;
+		k->factors[2*k->nstage] = p;
+		k->factors[2*k->nstage+1] = m;
+		k->maxradix = p > k->maxradix ? p : k->maxradix;
+		k->nstage++;
+	}while(m > 1 && k->nstage < FFT_MAX_STAGES);
+
+	total = n;
+	for(s=0; s<k->nstage; s++)
+		total += (k->factors[2*s]-1)*k->factors[2*s+1];
+
+	k->buffer = (muComplex_t *)malloc((total + k->maxradix)*sizeof(muComplex_t));
+	if(k->buffer == NULL)
+	{
+		free(k);
+		return NULL;
+	}
+
+	k->twiddle = k->buffer;
+	for(i=0; i<n; i++)
+	{
+		MU_64F a = -2*MU_PI*i/(MU_64F)n;
+		k->twiddle[i].re = (MU_32F)cos(a);
+		k->twiddle[i].im = (MU_32F)sin(a);
+	}
+
+	tw = k->buffer + n;
+	for(s=0; s<k->nstage; s++)
+	{
+		p = k->factors[2*s];
+		m = k->factors[2*s+1];
+		k->stagetw[s] = tw;
+		for(q=1; q<p; q++)
+		{
+			for(i=0; i<m; i++, tw++)
+			{
+				MU_64F a = -2*MU_PI*q*i/(MU_64F)(p*m);
+				tw->re = (MU_32F)cos(a);
+				tw->im = (MU_32F)sin(a);
+			}
+		}
+	}
+
+	return k;
+}
+
+#if defined(MU_FFT_SSE2)
+/* two complex products, lanes (re0, im0, re1, im1) */
+static __m128 cmul2(__m128 a, __m128 w)
+{
+	__m128 wr = _mm_shuffle_ps(w, w, _MM_SHUFFLE(2, 2, 0, 0));
+	__m128 wi = _mm_shuffle_ps(w, w, _MM_SHUFFLE(3, 3, 1, 1));
+	__m128 as = _mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1));
+
+	return _mm_add_ps(_mm_mul_ps(a, wr), _mm_mul_ps(_mm_mul_ps(as, wi), _mm_set_ps(1.f, -1.f, 1.f, -1.f)));
+}
+
+static MU_32S bfly2Vector(muComplex_t *F, const muComplex_t *tw, MU_32S m)
+{
+	MU_32S k;
+	MU_32F *f0 = (MU_32F *)F, *f1 = (MU_32F *)(F + m);
+	const MU_32F *w = (const MU_32F *)tw;
+
+	for(k=0; k+2<=m; k+=2)
+	{
+		__m128 a = _mm_loadu_ps(f0 + 2*k);
+		__m128 t = cmul2(_mm_loadu_ps(f1 + 2*k), _mm_loadu_ps(w + 2*k));
+		_mm_storeu_ps(f0 + 2*k, _mm_add_ps(a, t));
+		_mm_storeu_ps(f1 + 2*k, _mm_sub_ps(a, t));
+	}
+
+	return k;
+}
+
+static MU_32S bfly4Vector(muComplex_t *F, const muComplex_t *tw, MU_32S m)
+{
+	MU_32S k;
+	MU_32F *f0 = (MU_32F *)F, *f1 = (MU_32F *)(F + m), *f2 = (MU_32F *)(F + 2*m), *f3 = (MU_32F *)(F + 3*m);
+	const MU_32F *w1 = (const MU_32F *)tw, *w2 = (const MU_32F *)(tw + m), *w3 = (const MU_32F *)(tw + 2*m);
+	const __m128 sign = _mm_set_ps(-1.f, 1.f, -1.f, 1.f);
+
+	for(k=0; k+2<=m; k+=2)
+	{
+		__m128 a0 = _mm_loadu_ps(f0 + 2*k);
+		__m128 s0 = cmul2(_mm_loadu_ps(f1 + 2*k), _mm_loadu_ps(w1 + 2*k));
+		__m128 s1 = cmul2(_mm_loadu_ps(f2 + 2*k), _mm_loadu_ps(w2 + 2*k));
+		__m128 s2 = cmul2(_mm_loadu_ps(f3 + 2*k), _mm_loadu_ps(w3 + 2*k));
+		__m128 s5 = _mm_sub_ps(a0, s1);
+		__m128 s3 = _mm_add_ps(s0, s2);
+		__m128 s4 = _mm_sub_ps(s0, s2);
+		/* -i*s4 = (s4.im, -s4.re) */
+		__m128 r4 = _mm_mul_ps(_mm_shuffle_ps(s4, s4, _MM_SHUFFLE(2, 3, 0, 1)), sign);
+
+		a0 = _mm_add_ps(a0, s1);
+		_mm_storeu_ps(f2 + 2*k, _mm_sub_ps(a0, s3));
+		_mm_storeu_ps(f0 + 2*k, _mm_add_ps(a0, s3));
+		_mm_storeu_ps(f1 + 2*k, _mm_add_ps(s5, r4));
+		_mm_storeu_ps(f3 + 2*k, _mm_sub_ps(s5, r4));
+	}
+
+	return k;
+}
+#elif defined(MU_FFT_NEON)
+/* four complex values deinterleaved by vld2q: val[0] = re, val[1] = im */
+static float32x4x2_t cmul4(float32x4x2_t a, float32x4x2_t w)
+{
+	float32x4x2_t r;
+
+	r.val[0] = vmlsq_f32(vmulq_f32(a.val[0], w.val[0]), a.val[1], w.val[1]);
+	r.val[1] = vmlaq_f32(vmulq_f32(a.val[0], w.val[1]), a.val[1], w.val[0]);
+
+	return r;
+}
+
+static MU_32S bfly2Vector(muComplex_t *F, const muComplex_t *tw, MU_32S m)
+{
+	MU_32S k;
+	MU_32F *f0 = (MU_32F *)F, *f1 = (MU_32F *)(F + m);
+	const MU_32F *w = (const MU_32F *)tw;
+
+	for(k=0; k+4<=m; k+=4)
+	{
+		float32x4x2_t a = vld2q_f32(f0 + 2*k), t = cmul4(vld2q_f32(f1 + 2*k), vld2q_f32(w + 2*k)), r;
+		r.val[0] = vaddq_f32(a.val[0], t.val[0]);
+		r.val[1] = vaddq_f32(a.val[1], t.val[1]);
+		vst2q_f32(f0 + 2*k, r);
+		r.val[0] = vsubq_f32(a.val[0], t.val[0]);
+		r.val[1] = vsubq_f32(a.val[1], t.val[1]);
+		vst2q_f32(f1 + 2*k, r);
+	}
+
+	return k;
+}
+
+static MU_32S bfly4Vector(muComplex_t *F, const muComplex_t *tw, MU_32S m)
+{
+	MU_32S k;
+	MU_32F *f0 = (MU_32F *)F, *f1 = (MU_32F *)(F + m), *f2 = (MU_32F *)(F + 2*m), *f3 = (MU_32F *)(F + 3*m);
+	const MU_32F *w1 = (const MU_32F *)tw, *w2 = (const MU_32F *)(tw + m), *w3 = (const MU_32F *)(tw + 2*m);
+
+	for(k=0; k+4<=m; k+=4)
+	{
+		float32x4x2_t a0 = vld2q_f32(f0 + 2*k), r;
+		float32x4x2_t s0 = cmul4(vld2q_f32(f1 + 2*k), vld2q_f32(w1 + 2*k));
+		float32x4x2_t s1 = cmul4(vld2q_f32(f2 + 2*k), vld2q_f32(w2 + 2*k));
+		float32x4x2_t s2 = cmul4(vld2q_f32(f3 + 2*k), vld2q_f32(w3 + 2*k));
+		float32x4_t s5r = vsubq_f32(a0.val[0], s1.val[0]), s5i = vsubq_f32(a0.val[1], s1.val[1]);
+		float32x4_t s3r = vaddq_f32(s0.val[0], s2.val[0]), s3i = vaddq_f32(s0.val[1], s2.val[1]);
+		float32x4_t s4r = vsubq_f32(s0.val[0], s2.val[0]), s4i = vsubq_f32(s0.val[1], s2.val[1]);
+		float32x4_t a0r = vaddq_f32(a0.val[0], s1.val[0]), a0i = vaddq_f32(a0.val[1], s1.val[1]);
+
+		r.val[0] = vsubq_f32(a0r, s3r);
+		r.val[1] = vsubq_f32(a0i, s3i);
+		vst2q_f32(f2 + 2*k, r);
+		r.val[0] = vaddq_f32(a0r, s3r);
+		r.val[1] = vaddq_f32(a0i, s3i);
+		vst2q_f32(f0 + 2*k, r);
+		r.val[0] = vaddq_f32(s5r, s4i);
+		r.val[1] = vsubq_f32(s5i, s4r);
+		vst2q_f32(f1 + 2*k, r);
+		r.val[0] = vsubq_f32(s5r, s4i);
+		r.val[1] = vaddq_f32(s5i, s4r);
+		vst2q_f32(f3 + 2*k, r);
+	}
+
+	return k;
+}
+#endif
+
+static MU_VOID bfly2(muComplex_t *F, const muComplex_t *tw, MU_32S m)
+{
+	MU_32S k = 0;
+
+#if defined(MU_FFT_SSE2) || defined(MU_FFT_NEON)
+	k = bfly2Vector(F, tw, m);
+#endif
+	for(; k<m; k++)
+	{
+		muComplex_t t;
+		CMUL(t, F[k+m], tw[k]);
+		F[k+m].re = F[k].re - t.re;
+		F[k+m].im = F[k].im - t.im;
+		F[k].re += t.re;
+		F[k].im += t.im;
+	}
+}
+
+static MU_VOID bfly4(muComplex_t *F, const muComplex_t *tw, MU_32S m)
+{
+	MU_32S k = 0;
+
+#if defined(MU_FFT_SSE2) || defined(MU_FFT_NEON)
+	k = bfly4Vector(F, tw, m);
+#endif
+	for(; k<m; k++)
+	{
+		muComplex_t s0, s1, s2, s3, s4, s5;
+
+		CMUL(s0, F[k+m], tw[k]);
+		CMUL(s1, F[k+2*m], tw[m+k]);
+		CMUL(s2, F[k+3*m], tw[2*m+k]);
+
+		s5.re = F[k].re - s1.re;
+		s5.im = F[k].im - s1.im;
+		F[k].re += s1.re;
+		F[k].im += s1.im;
+		s3.re = s0.re + s2.re;
+		s3.im = s0.im + s2.im;
+		s4.re = s0.re - s2.re;
+		s4.im = s0.im - s2.im;
+
+		F[k+2*m].re = F[k].re - s3.re;
+		F[k+2*m].im = F[k].im - s3.im;
+		F[k].re += s3.re;
+		F[k].im += s3.im;
+		F[k+m].re = s5.re + s4.im;
+		F[k+m].im = s5.im - s4.re;
+		F[k+3*m].re = s5.re - s4.im;
+		F[k+3*m].im = s5.im + s4.re;
+	}
+}
+
+static MU_VOID bfly3(muComplex_t *F, const muComplex_t *tw, MU_32S m)
+{
+	MU_32S k;
+	const MU_32F epi = -0.86602540378443864676f;   /* sin(-2pi/3) */
+
+	for(k=0; k<m; k++)
+	{
+		muComplex_t s0, s1, s2, s3;
+
+		CMUL(s1, F[k+m], tw[k]);
+		CMUL(s2, F[k+2*m], tw[m+k]);
+		s3.re = s1.re + s2.re;
+		s3.im = s1.im + s2.im;
+		s0.re = (s1.re - s2.re)*epi;
+		s0.im = (s1.im - s2.im)*epi;
+
+		F[k+m].re = F[k].re - 0.5f*s3.re;
+		F[k+m].im = F[k].im - 0.5f*s3.im;
+		F[k].re += s3.re;
+		F[k].im += s3.im;
+
+		F[k+2*m].re = F[k+m].re + s0.im;
+		F[k+2*m].im = F[k+m].im - s0.re;
+		F[k+m].re -= s0.im;
+		F[k+m].im += s0.re;
+	}
+}
+
+static MU_VOID bfly5(muComplex_t *F, const muComplex_t *tw, MU_32S m)
+{
+	MU_32S k;
+	const MU_32F yar = 0.30901699437494742410f, yai = -0.95105651629515357212f;   /* exp(-2pi i/5) */
+	const MU_32F ybr = -0.80901699437494742410f, ybi = -0.58778525229247312917f;  /* exp(-4pi i/5) */
+
+	for(k=0; k<m; k++)
+	{
+		muComplex_t s0, s1, s2, s3, s4, s5, s6, s7, s8, s9, s10, s11, s12;
+
+		s0 = F[k];
+		CMUL(s1, F[k+m], tw[k]);
+		CMUL(s2, F[k+2*m], tw[m+k]);
+		CMUL(s3, F[k+3*m], tw[2*m+k]);
+		CMUL(s4, F[k+4*m], tw[3*m+k]);
+
+		s7.re = s1.re + s4.re;  s7.im = s1.im + s4.im;
+		s10.re = s1.re - s4.re; s10.im = s1.im - s4.im;
+		s8.re = s2.re + s3.re;  s8.im = s2.im + s3.im;
+		s9.re = s2.re - s3.re;  s9.im = s2.im - s3.im;
+
+		F[k].re = s0.re + s7.re + s8.re;
+		F[k].im = s0.im + s7.im + s8.im;
+
+		s5.re = s0.re + s7.re*yar + s8.re*ybr;
+		s5.im = s0.im + s7.im*yar + s8.im*ybr;
+		s6.re = s10.im*yai + s9.im*ybi;
+		s6.im = -s10.re*yai - s9.re*ybi;
+		F[k+m].re = s5.re - s6.re;
+		F[k+m].im = s5.im - s6.im;
+		F[k+4*m].re = s5.re + s6.re;
+		F[k+4*m].im = s5.im + s6.im;
+
+		s11.re = s0.re + s7.re*ybr + s8.re*yar;
+		s11.im = s0.im + s7.im*ybr + s8.im*yar;
+		s12.re = -s10.im*ybi + s9.im*yai;
+		s12.im = s10.re*ybi - s9.re*yai;
+		F[k+2*m].re = s11.re + s12.re;
+		F[k+2*m].im = s11.im + s12.im;
+		F[k+3*m].re = s11.re - s12.re;
+		F[k+3*m].im = s11.im - s12.im;
+	}
+}
+
+static MU_VOID bflyGeneric(muComplex_t *F, const fftKernel_t *kern, MU_32S fstride, MU_32S p, MU_32S m, muComplex_t *scratch)
+{
+	MU_32S u, q, q1, k, idx, n = kern->n;
+
+	for(u=0; u<m; u++)
+	{
+		for(q=0; q<p; q++)
+			scratch[q] = F[u + q*m];
+
+		for(q1=0; q1<p; q1++)
+		{
+			muComplex_t acc = scratch[0];
+			k = u + q1*m;
+			idx = 0;
+			for(q=1; q<p; q++)
+			{
+				muComplex_t t;
+				idx += fstride*k;
+				idx %= n;
+				CMUL(t, scratch[q], kern->twiddle[idx]);
+				acc.re += t.re;
+				acc.im += t.im;
+			}
+			F[k] = acc;
+		}
+	}
+}
+
+/* decimation in time, out of place, in is read with stride */
+static MU_VOID fftWork(const fftKernel_t *kern, muComplex_t *out, const muComplex_t *in, MU_32S fstride,
+					   MU_32S instride, MU_32S stage, muComplex_t *scratch)
+{
+	MU_32S p = kern->factors[2*stage], m = kern->factors[2*stage+1], q;
+	muComplex_t *o = out;
+
+	if(m == 1)
+	{
+		for(q=0; q<p; q++, in+=fstride*instride)
+			out[q] = *in;
+	}
+	else
+	{
+		for(q=0; q<p; q++, o+=m, in+=fstride*instride)
+			fftWork(kern, o, in, fstride*p, instride, stage+1, scratch);
+	}
+
+	switch(p)
+	{
+		case 2: bfly2(out, kern->stagetw[stage], m); break;
+		case 3: bfly3(out, kern->stagetw[stage], m); break;
+		case 4: bfly4(out, kern->stagetw[stage], m); break;
+		case 5: bfly5(out, kern->stagetw[stage], m); break;
+		default: bflyGeneric(out, kern, fstride, p, m, scratch); break;
+	}
+}
+
+static MU_VOID fftForward(const fftKernel_t *kern, muComplex_t *out, const muComplex_t *in, MU_32S instride, muComplex_t *scratch)
+{
+	if(kern->n == 1)
+		out[0] = in[0];
+	else
+		fftWork(kern, out, in, 1, instride, 0, scratch);
+}
+
+/*===========================================================================================*/
+/*   muGetOptimalFFTSize                                                                     */
+/*                                                                                           */
+/*   DESCRIPTION:                                                                            */
+/*   The smallest size >= n whose prime factors are 2, 3 and 5 only (fast radices).          */
+/*===========================================================================================*/
+MU_32S muGetOptimalFFTSize(MU_32S n)
+{
+	MU_32S m;
+
+	if(n <= 1)
+		return 1;
+
+	for(;; n++)
+	{
+		m = n;
+		while(m % 2 == 0) m /= 2;
+		while(m % 3 == 0) m /= 3;
+		while(m % 5 == 0) m /= 5;
+		if(m == 1)
+			return n;
+	}
+}
+
+/*===========================================================================================*/
+/*   muCreateFFTPlan / muReleaseFFTPlan                                                      */
+/*                                                                                           */
+/*   DESCRIPTION:                                                                            */
+/*   Plan of the real-input 2-D FFT of width x height. Twiddles of every stage, the real     */
+/*   packing twiddles and the scratch buffers are allocated once, so a plan is reused frame  */
+/*   by frame. Any size is supported, sizes of muGetOptimalFFTSize are the fastest.          */
+/*===========================================================================================*/
+muFFTPlan_t* muCreateFFTPlan(MU_32S width, MU_32S height)
+{
+	muFFTPlan_t *plan;
+	MU_32S i, half;
+
+	if(width <= 0 || height <= 0)
+	{
+		return NULL;
+	}
+
+	plan = (muFFTPlan_t *)calloc(1, sizeof(muFFTPlan_t));
+	if(plan == NULL)
+	{
+		return NULL;
+	}
+
+	plan->width = width;
+	plan->height = height;
+	plan->cols = width/2 + 1;
+	half = (width & 1) ? width : width/2;
+
+	plan->nthreads = 1;
+#ifdef _OPENMP
+	plan->nthreads = omp_get_max_threads();
+#endif
+
+	plan->row = createKernel(half);
+	plan->col = createKernel(height);
+	if(plan->row == NULL || plan->col == NULL)
+	{
+		muReleaseFFTPlan(&plan);
+		return NULL;
+	}
+
+	/* two transform buffers and the generic radix scratch */
+	plan->scratchsize = 2*(width > FFT_COLUMN_BLOCK*height ? width : FFT_COLUMN_BLOCK*height) +
+		(plan->row->maxradix > plan->col->maxradix ? plan->row->maxradix : plan->col->maxradix);
+	plan->super = (muComplex_t *)malloc((width/2 + 1)*sizeof(muComplex_t));
+	plan->work = (muComplex_t *)malloc(height*plan->cols*sizeof(muComplex_t));
+	plan->scratch = (muComplex_t *)malloc(plan->nthreads*plan->scratchsize*sizeof(muComplex_t));
+	if(plan->super == NULL || plan->work == NULL || plan->scratch == NULL)
+	{
+		muReleaseFFTPlan(&plan);
+		return NULL;
+	}
+
+	for(i=0; i<=width/2; i++)
+	{
+		MU_64F a = -2*MU_PI*i/(MU_64F)width;
+		plan->super[i].re = (MU_32F)cos(a);
+		plan->super[i].im = (MU_32F)sin(a);
+	}
+
+	return plan;
+}
+
+muError_t muReleaseFFTPlan(muFFTPlan_t **plan)
+{
+	if(plan == NULL || *plan == NULL)
+	{
+		return MU_ERR_NULL_POINTER;
+	}
+
+	releaseKernel((*plan)->row);
+	releaseKernel((*plan)->col);
+	free((*plan)->super);
+	free((*plan)->work);
+	free((*plan)->scratch);
+	free(*plan);
+	*plan = NULL;
+
+	return MU_ERR_SUCCESS;
+}
+
+/* real row -> width/2+1 spectrum values */
+static MU_VOID rowForward(const muFFTPlan_t *plan, const MU_32F *in, muComplex_t *out, muComplex_t *tmp)
+{
+	MU_32S w = plan->width, k;
+
+	if(w & 1)
+	{
+		muComplex_t *z = tmp + w;
+		for(k=0; k<w; k++)
+		{
+			z[k].re = in[k];
+			z[k].im = 0;
+		}
+		fftForward(plan->row, tmp, z, 1, z + w);
+		memcpy(out, tmp, plan->cols*sizeof(muComplex_t));
+	}
+	else
+	{
+		/* z[k] = x[2k] + i x[2k+1], X[k] = (Z[k]+conj(Z[N-k]))/2 - i/2 W^k (Z[k]-conj(Z[N-k])) */
+		MU_32S N = w/2;
+		const muComplex_t *z = (const muComplex_t *)in;
+
+		fftForward(plan->row, tmp, z, 1, tmp + N);
+		for(k=0; k<=N; k++)
+		{
+			muComplex_t a = tmp[k == N ? 0 : k], b = tmp[k == 0 ? 0 : N-k], e, o, t;
+			e.re = 0.5f*(a.re + b.re);
+			e.im = 0.5f*(a.im - b.im);
+			o.re = 0.5f*(a.im + b.im);
+			o.im = -0.5f*(a.re - b.re);
+			CMUL(t, o, plan->super[k]);
+			out[k].re = e.re + t.re;
+			out[k].im = e.im + t.im;
+		}
+	}
+}
+
+/* width/2+1 spectrum values -> real row, normalized by 1/width */
+static MU_VOID rowInverse(const muFFTPlan_t *plan, const muComplex_t *in, MU_32F *out, muComplex_t *tmp)
+{
+	MU_32S w = plan->width, k;
+
+	if(w & 1)
+	{
+		muComplex_t *z = tmp + w;
+		MU_32F s = 1.f/w;
+
+		/* Hermitian row, conjugated for the inverse */
+		for(k=0; k<plan->cols; k++)
+		{
+			z[k].re = in[k].re;
+			z[k].im = -in[k].im;
+		}
+		for(; k<w; k++)
+		{
+			z[k].re = in[w-k].re;
+			z[k].im = in[w-k].im;
+		}
+		fftForward(plan->row, tmp, z, 1, z + w);
+		for(k=0; k<w; k++)
+			out[k] = tmp[k].re*s;
+	}
+	else
+	{
+		/* Fe = (X[k]+conj(X[N-k]))/2, Fo = (X[k]-conj(X[N-k]))/2 W^-k, Z = Fe + i Fo */
+		MU_32S N = w/2;
+		muComplex_t *z = tmp + N;
+		MU_32F s = 1.f/N;
+
+		for(k=0; k<N; k++)
+		{
+			muComplex_t a = in[k], b = in[N-k], e, d, o, wk;
+			e.re = 0.5f*(a.re + b.re);
+			e.im = 0.5f*(a.im - b.im);
+			d.re = 0.5f*(a.re - b.re);
+			d.im = 0.5f*(a.im + b.im);
+			wk.re = plan->super[k].re;
+			wk.im = -plan->super[k].im;
+			CMUL(o, d, wk);
+			/* conjugate for the inverse through the forward transform */
+			z[k].re = e.re - o.im;
+			z[k].im = -(e.im + o.re);
+		}
+		fftForward(plan->row, tmp, z, 1, z + N);
+		for(k=0; k<N; k++)
+		{
+			out[2*k] = tmp[k].re*s;
+			out[2*k+1] = -tmp[k].im*s;
+		}
+	}
+}
+
+/* column transforms of a height x cols spectrum, FFT_COLUMN_BLOCK columns are gathered per pass */
+static MU_VOID columnPass(muFFTPlan_t *plan, muComplex_t *spec, MU_32S inverse)
+{
+	MU_32S h = plan->height, cols = plan->cols, nblock, blk;
+	MU_32F s = inverse ? 1.f/h : 1.f;
+	MU_32F c = inverse ? -1.f : 1.f;
+
+	nblock = (cols + FFT_COLUMN_BLOCK - 1)/FFT_COLUMN_BLOCK;
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+	for(blk=0; blk<nblock; blk++)
+	{
+		MU_32S tid = 0, x0 = blk*FFT_COLUMN_BLOCK, nb, b, y;
+		muComplex_t *in, *out;
+
+#ifdef _OPENMP
+		tid = omp_get_thread_num();
+#endif
+		in = plan->scratch + tid*plan->scratchsize;
+		out = in + FFT_COLUMN_BLOCK*h;
+		nb = cols - x0 < FFT_COLUMN_BLOCK ? cols - x0 : FFT_COLUMN_BLOCK;
+
+		/* gather, conjugated for the inverse */
+		for(y=0; y<h; y++)
+		{
+			const muComplex_t *r = spec + y*cols + x0;
+			for(b=0; b<nb; b++)
+			{
+				in[b*h + y].re = r[b].re;
+				in[b*h + y].im = c*r[b].im;
+			}
+		}
+
+		for(b=0; b<nb; b++)
+			fftForward(plan->col, out + b*h, in + b*h, 1, out + FFT_COLUMN_BLOCK*h);
+
+		for(y=0; y<h; y++)
+		{
+			muComplex_t *r = spec + y*cols + x0;
+			for(b=0; b<nb; b++)
+			{
+				r[b].re = out[b*h + y].re*s;
+				r[b].im = c*out[b*h + y].im*s;
+			}
+		}
+	}
+}
+
+/*===========================================================================================*/
+/*   muFFTForward                                                                            */
+/*                                                                                           */
+/*   DESCRIPTION:                                                                            */
+/*   Real-input 2-D FFT. spectrum holds height x (width/2+1) complex values, the other half  */
+/*   is the conjugate symmetric one. Not normalized.                                         */
+/*                                                                                           */
+/*   USAGE                                                                                   */
+/*   muFFTPlan_t *plan --> plan of the size                                                  */
+/*   MU_32F *src, MU_32S srcstep --> real input, srcstep in elements                         */
+/*   muComplex_t *spectrum --> output                                                        */
+/*===========================================================================================*/
+muError_t muFFTForward(muFFTPlan_t *plan, const MU_32F *src, MU_32S srcstep, muComplex_t *spectrum)
+{
+	MU_32S y;
+
+	if(plan == NULL || src == NULL || spectrum == NULL)
+	{
+		return MU_ERR_NULL_POINTER;
+	}
+
+	if(srcstep < plan->width)
+	{
+		return MU_ERR_INVALID_PARAMETER;
+	}
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+	for(y=0; y<plan->height; y++)
+	{
+		MU_32S tid = 0;
+#ifdef _OPENMP
+		tid = omp_get_thread_num();
+#endif
+		rowForward(plan, src + y*srcstep, spectrum + y*plan->cols, plan->scratch + tid*plan->scratchsize);
+	}
+
+	columnPass(plan, spectrum, 0);
+
+	return MU_ERR_SUCCESS;
+}
+
+/*===========================================================================================*/
+/*   muFFTInverse                                                                            */
+/*                                                                                           */
+/*   DESCRIPTION:                                                                            */
+/*   Inverse of muFFTForward, normalized (dst = src of the forward transform).               */
+/*   spectrum is not modified.                                                               */
+/*===========================================================================================*/
+muError_t muFFTInverse(muFFTPlan_t *plan, const muComplex_t *spectrum, MU_32F *dst, MU_32S dststep)
+{
+	MU_32S y;
+
+	if(plan == NULL || spectrum == NULL || dst == NULL)
+	{
+		return MU_ERR_NULL_POINTER;
+	}
+
+	if(dststep < plan->width)
+	{
+		return MU_ERR_INVALID_PARAMETER;
+	}
+
+	if(spectrum != plan->work)
+		memcpy(plan->work, spectrum, plan->height*plan->cols*sizeof(muComplex_t));
+	columnPass(plan, plan->work, 1);
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+	for(y=0; y<plan->height; y++)
+	{
+		MU_32S tid = 0;
+#ifdef _OPENMP
+		tid = omp_get_thread_num();
+#endif
+		rowInverse(plan, plan->work + y*plan->cols, dst + y*dststep, plan->scratch + tid*plan->scratchsize);
+	}
+
+	return MU_ERR_SUCCESS;
+}
+
+/* 8-bit image (optionally minus mean, times window) into a zero padded float buffer */
+static MU_VOID loadImage(const muImage_t *src, MU_32F *buf, MU_32S width, MU_32S height, MU_32F mean, const MU_32F *window)
+{
+	MU_32S x, y;
+
+	memset(buf, 0, width*height*sizeof(MU_32F));
+	for(y=0; y<src->height; y++)
+	{
+		const MU_8U *in = src->imagedata + y*src->width;
+		MU_32F *out = buf + y*width;
+		if(window)
+		{
+			const MU_32F *w = window + y*src->width;
+			for(x=0; x<src->width; x++)
+				out[x] = (in[x] - mean)*w[x];
+		}
+		else
+		{
+			for(x=0; x<src->width; x++)
+				out[x] = in[x] - mean;
+		}
+	}
+}
+
+static muFFTPlan_t* usePlan(muFFTPlan_t *plan, MU_32S width, MU_32S height, muError_t *ret)
+{
+	if(plan)
+	{
+		*ret = (plan->width == width && plan->height == height) ? MU_ERR_SUCCESS : MU_ERR_INVALID_PARAMETER;
+		return plan;
+	}
+
+	plan = muCreateFFTPlan(width, height);
+	*ret = plan ? MU_ERR_SUCCESS : MU_ERR_OUT_OF_MEMORY;
+
+	return plan;
+}
+
+/*===========================================================================================*/
+/*   muFFTCrossCorrelation                                                                   */
+/*                                                                                           */
+/*   DESCRIPTION:                                                                            */
+/*   Template matching in the frequency domain, O(N log N) instead of O(N*M):                */
+/*   result(x,y) = sum templ(u,v)*src(x+u,y+v) for the (W-w+1) x (H-h+1) valid positions.    */
+/*   normalized = 1 gives the zero mean normalized cross-correlation (-1..1, like muNCC),    */
+/*   the local sums of src come from integral images.                                        */
+/*                                                                                           */
+/*   NOTE                                                                                    */
+/*   plan must be of the src size, or NULL to create a temporary one.                        */
+/*                                                                                           */
+/*   USAGE                                                                                   */
+/*   muImage_t *src --> search image (8-bit, 1 channel)                                      */
+/*   muImage_t *templ --> template, not larger than src                                      */
+/*   MU_32S normalized --> 0: plain correlation, 1: normalized                               */
+/*   MU_32F *result --> (W-w+1) x (H-h+1) output                                             */
+/*===========================================================================================*/
+muError_t muFFTCrossCorrelation(muFFTPlan_t *plan, const muImage_t *src, const muImage_t *templ,
+								MU_32S normalized, MU_32F *result)
+{
+	MU_32S W, H, w, h, rw, rh, x, y, i, n;
+	MU_32F *a, *b;
+	muComplex_t *A, *B;
+	MU_64F tmean = 0, tnorm = 0, *sum = NULL, *sqsum = NULL;
+	muFFTPlan_t *p;
+	muError_t ret;
+
+	ret = muCheckDepth(4, src, MU_IMG_DEPTH_8U, templ, MU_IMG_DEPTH_8U);
+	if(ret)
+	{
+		return ret;
+	}
+
+	if(result == NULL)
+	{
+		return MU_ERR_NULL_POINTER;
+	}
+
+	if(src->channels != 1 || templ->channels != 1)
+	{
+		return MU_ERR_NOT_SUPPORT;
+	}
+
+	W = src->width;
+	H = src->height;
+	w = templ->width;
+	h = templ->height;
+	if(w > W || h > H)
+	{
+		return MU_ERR_INVALID_PARAMETER;
+	}
+
+	p = usePlan(plan, W, H, &ret);
+	if(ret)
+	{
+		if(p != plan)
+			muReleaseFFTPlan(&p);
+		return ret;
+	}
+
+	rw = W - w + 1;
+	rh = H - h + 1;
+	n = w*h;
+
+	a = (MU_32F *)malloc(2*W*H*sizeof(MU_32F));
+	A = (muComplex_t *)malloc(2*H*p->cols*sizeof(muComplex_t));
+	if(normalized)
+	{
+		sum = (MU_64F *)calloc((W+1)*(H+1), sizeof(MU_64F));
+		sqsum = (MU_64F *)calloc((W+1)*(H+1), sizeof(MU_64F));
+	}
+	if(a == NULL || A == NULL || (normalized && (sum == NULL || sqsum == NULL)))
+	{
+		free(a);
+		free(A);
+		free(sum);
+		free(sqsum);
+		if(p != plan)
+			muReleaseFFTPlan(&p);
+		return MU_ERR_OUT_OF_MEMORY;
+	}
+	b = a + W*H;
+	B = A + H*p->cols;
+
+	if(normalized)
+	{
+		for(i=0; i<n; i++)
+			tmean += templ->imagedata[i];
+		tmean /= n;
+		for(i=0; i<n; i++)
+			tnorm += (templ->imagedata[i] - tmean)*(templ->imagedata[i] - tmean);
+	}
+
+	loadImage(src, a, W, H, 0, NULL);
+	loadImage(templ, b, W, H, (MU_32F)tmean, NULL);
+	muFFTForward(p, a, W, A);
+	muFFTForward(p, b, W, B);
+
+	/* A * conj(B) */
+	for(i=0; i<H*p->cols; i++)
+	{
+		MU_32F re = A[i].re*B[i].re + A[i].im*B[i].im;
+		MU_32F im = A[i].im*B[i].re - A[i].re*B[i].im;
+		A[i].re = re;
+		A[i].im = im;
+	}
+	muFFTInverse(p, A, a, W);
+
+	if(normalized)
+	{
+		for(y=0; y<H; y++)
+		{
+			MU_64F rs = 0, rq = 0;
+			for(x=0; x<W; x++)
+			{
+				MU_64F v = src->imagedata[y*W+x];
+				rs += v;
+				rq += v*v;
+				sum[(y+1)*(W+1)+x+1] = sum[y*(W+1)+x+1] + rs;
+				sqsum[(y+1)*(W+1)+x+1] = sqsum[y*(W+1)+x+1] + rq;
+			}
+		}
+	}
+
+	for(y=0; y<rh; y++)
+	{
+		const MU_32F *r = a + y*W;
+		MU_32F *out = result + y*rw;
+		if(!normalized)
+		{
+			memcpy(out, r, rw*sizeof(MU_32F));
+			continue;
+		}
+		for(x=0; x<rw; x++)
+		{
+			MU_32S i0 = y*(W+1)+x, i1 = (y+h)*(W+1)+x;
+			MU_64F s = sum[i1+w] - sum[i1] - sum[i0+w] + sum[i0];
+			MU_64F q = sqsum[i1+w] - sqsum[i1] - sqsum[i0+w] + sqsum[i0];
+			MU_64F d = (q - s*s/n)*tnorm;
+			/* the template is zero mean, so r is already the centered correlation */
+			out[x] = d > 1e-6 ? (MU_32F)(r[x]/sqrt(d)) : 0.f;
+		}
+	}
+
+	free(a);
+	free(A);
+	free(sum);
+	free(sqsum);
+	if(p != plan)
+		muReleaseFFTPlan(&p);
+
+	return MU_ERR_SUCCESS;
+}
+
+/*===========================================================================================*/
+/*   muPhaseCorrelation                                                                      */
+/*                                                                                           */
+/*   DESCRIPTION:                                                                            */
+/*   Global translation between two images of the same size, src2(x) ~ src1(x - shift).     */
+/*   The normalized cross power spectrum is transformed back, the peak is refined to sub     */
+/*   pixel by the 3x3 centroid. response is the peak value (0..1, 1 = pure translation).     */
+/*                                                                                           */
+/*   NOTE                                                                                    */
+/*   window = 1 applies a Hann window against the border discontinuity. plan must be of the  */
+/*   image size, or NULL to create a temporary one.                                          */
+/*===========================================================================================*/
+muError_t muPhaseCorrelation(muFFTPlan_t *plan, const muImage_t *src1, const muImage_t *src2, MU_32S window,
+							 muPoint2D32f_t *shift, MU_64F *response)
+{
+	MU_32S W, H, x, y, i, px = 0, py = 0;
+	MU_32F *a, *b, *win = NULL, best;
+	MU_64F sx = 0, sy = 0, sw = 0;
+	muComplex_t *A, *B;
+	muFFTPlan_t *p;
+	muError_t ret;
+
+	ret = muCheckDepth(4, src1, MU_IMG_DEPTH_8U, src2, MU_IMG_DEPTH_8U);
+	if(ret)
+	{
+		return ret;
+	}
+
+	if(shift == NULL)
+	{
+		return MU_ERR_NULL_POINTER;
+	}
+
+	if(src1->channels != 1 || src2->channels != 1 || src1->width != src2->width || src1->height != src2->height)
+	{
+		return MU_ERR_NOT_SUPPORT;
+	}
+
+	W = src1->width;
+	H = src1->height;
+	p = usePlan(plan, W, H, &ret);
+	if(ret)
+	{
+		if(p != plan)
+			muReleaseFFTPlan(&p);
+		return ret;
+	}
+
+	a = (MU_32F *)malloc((window ? 3 : 2)*W*H*sizeof(MU_32F));
+	A = (muComplex_t *)malloc(2*H*p->cols*sizeof(muComplex_t));
+	if(a == NULL || A == NULL)
+	{
+		free(a);
+		free(A);
+		if(p != plan)
+			muReleaseFFTPlan(&p);
+		return MU_ERR_OUT_OF_MEMORY;
+	}
+	b = a + W*H;
+	B = A + H*p->cols;
+
+	if(window)
+	{
+		win = b + W*H;
+		for(y=0; y<H; y++)
+		{
+			MU_32F wy = (MU_32F)(0.5 - 0.5*cos(2*MU_PI*y/(H > 1 ? H-1 : 1)));
+			for(x=0; x<W; x++)
+				win[y*W+x] = wy*(MU_32F)(0.5 - 0.5*cos(2*MU_PI*x/(W > 1 ? W-1 : 1)));
+		}
+	}
+
+	loadImage(src1, a, W, H, 0, win);
+	loadImage(src2, b, W, H, 0, win);
+	muFFTForward(p, a, W, A);
+	muFFTForward(p, b, W, B);
+
+	/* B * conj(A) / |B * conj(A)| */
+	for(i=0; i<H*p->cols; i++)
+	{
+		MU_32F re = B[i].re*A[i].re + B[i].im*A[i].im;
+		MU_32F im = B[i].im*A[i].re - B[i].re*A[i].im;
+		MU_32F mag = (MU_32F)sqrt(re*re + im*im);
+		mag = mag > 1e-12f ? 1.f/mag : 0.f;
+		A[i].re = re*mag;
+		A[i].im = im*mag;
+	}
+	muFFTInverse(p, A, a, W);
+
+	best = a[0];
+	for(y=0; y<H; y++)
+	{
+		for(x=0; x<W; x++)
+		{
+			if(a[y*W+x] > best)
+			{
+				best = a[y*W+x];
+				px = x;
+				py = y;
+			}
+		}
+	}
+
+	for(y=-1; y<=1; y++)
+	{
+		for(x=-1; x<=1; x++)
+		{
+			MU_32F v = a[((py+y+H)%H)*W + (px+x+W)%W];
+			if(v > 0)
+			{
+				sx += x*v;
+				sy += y*v;
+				sw += v;
+			}
+		}
+	}
+
+	/* peaks past the half size are negative shifts */
+	shift->x = (MU_32F)((px > W/2 ? px - W : px) + (sw > 0 ? sx/sw : 0));
+	shift->y = (MU_32F)((py > H/2 ? py - H : py) + (sw > 0 ? sy/sw : 0));
+	if(response)
+		*response = best;
+
+	free(a);
+	free(A);
+	if(p != plan)
+		muReleaseFFTPlan(&p);
+
+	return MU_ERR_SUCCESS;
+}
+
+/*===========================================================================================*/
+/*   muFFTFilter                                                                             */
+/*                                                                                           */
+/*   DESCRIPTION:                                                                            */
+/*   Large kernel filtering in the frequency domain, same output size as src, zero outside:  */
+/*   dst(x,y) = sum kernel(u,v)*src(x+u-kw/2, y+v-kh/2) (correlation, as muFilter55).        */
+/*                                                                                           */
+/*   NOTE                                                                                    */
+/*   plan must be at least (W+kw-1) x (H+kh-1), see muGetOptimalFFTSize, or NULL to create a */
+/*   temporary one.                                                                          */
+/*                                                                                           */
+/*   USAGE                                                                                   */
+/*   muImage_t *src --> input image (8-bit, 1 channel)                                       */
+/*   muImage_t *dst --> output image (MU_IMG_DEPTH_32F, 1 channel)                           */
+/*   MU_32F *kernel, MU_32S kw, MU_32S kh --> kernel                                         */
+/*===========================================================================================*/
+muError_t muFFTFilter(muFFTPlan_t *plan, const muImage_t *src, muImage_t *dst, const MU_32F *kernel, MU_32S kw, MU_32S kh)
+{
+	MU_32S W, H, PW, PH, x, y, i;
+	MU_32F *a, *b, *out;
+	muComplex_t *A, *B;
+	muFFTPlan_t *p;
+	muError_t ret;
+
+	ret = muCheckDepth(4, src, MU_IMG_DEPTH_8U, dst, MU_IMG_DEPTH_32F);
+	if(ret)
+	{
+		return ret;
+	}
+
+	if(kernel == NULL)
+	{
+		return MU_ERR_NULL_POINTER;
+	}
+
+	if(src->channels != 1 || dst->channels != 1 || src->width != dst->width || src->height != dst->height)
+	{
+		return MU_ERR_NOT_SUPPORT;
+	}
+
+	if(kw <= 0 || kh <= 0)
+	{
+		return MU_ERR_INVALID_PARAMETER;
+	}
+
+	W = src->width;
+	H = src->height;
+	if(plan)
+	{
+		if(plan->width < W+kw-1 || plan->height < H+kh-1)
+		{
+			return MU_ERR_INVALID_PARAMETER;
+		}
+		p = plan;
+	}
+	else
+	{
+		p = muCreateFFTPlan(muGetOptimalFFTSize(W+kw-1), muGetOptimalFFTSize(H+kh-1));
+		if(p == NULL)
+		{
+			return MU_ERR_OUT_OF_MEMORY;
+		}
+	}
+	PW = p->width;
+	PH = p->height;
+
+	a = (MU_32F *)malloc(2*PW*PH*sizeof(MU_32F));
+	A = (muComplex_t *)malloc(2*PH*p->cols*sizeof(muComplex_t));
+	if(a == NULL || A == NULL)
+	{
+		free(a);
+		free(A);
+		if(p != plan)
+			muReleaseFFTPlan(&p);
+		return MU_ERR_OUT_OF_MEMORY;
+	}
+	b = a + PW*PH;
+	B = A + PH*p->cols;
+
+	loadImage(src, a, PW, PH, 0, NULL);
+	memset(b, 0, PW*PH*sizeof(MU_32F));
+	for(y=0; y<kh; y++)
+		memcpy(b + y*PW, kernel + y*kw, kw*sizeof(MU_32F));
+
+	muFFTForward(p, a, PW, A);
+	muFFTForward(p, b, PW, B);
+	for(i=0; i<PH*p->cols; i++)
+	{
+		MU_32F re = A[i].re*B[i].re + A[i].im*B[i].im;
+		MU_32F im = A[i].im*B[i].re - A[i].re*B[i].im;
+		A[i].re = re;
+		A[i].im = im;
+	}
+	muFFTInverse(p, A, a, PW);
+
+	/* the anchor moves the circular result by (-kw/2, -kh/2) */
+	out = (MU_32F *)dst->imagedata;
+	for(y=0; y<H; y++)
+	{
+		const MU_32F *r = a + ((y - kh/2 + PH) % PH)*PW;
+		for(x=0; x<W; x++)
+			out[y*W+x] = r[(x - kw/2 + PW) % PW];
+	}
+
+	free(a);
+	free(A);
+	if(p != plan)
+		muReleaseFFTPlan(&p);
+
+	return MU_ERR_SUCCESS;
+}
@@ -0,0 +1,822 @@
+/*
+% MIT License
+%
+% Copyright (c) 2016 OneCV
+%
+% Permission is hereby granted, free of charge, to any person obtaining a copy
+% of this software and associated documentation files (the "Software"), to deal
+% in the Software without restriction, including without limitation the rights
+% to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+% copies of the Software, and to permit persons to whom the Software is
+% furnished to do so, subject to the following conditions:
+%
+% The above copyright notice and this permission notice shall be included in all
+% copies or substantial portions of the Software.
+%
+% THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+% IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+% FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+% AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+% LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+% OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+% SOFTWARE.
+*/
+
+/* ------------------------------------------------------------------------- /
+ *
+ * Module: muFeature.c
+ * Author: Joe Lin
+ *
+ * Description:
+ *    FAST-9 corners, intensity centroid orientation, rotated BRIEF (ORB)
+ *    256-bit descriptors and Hamming matching (brute force, multi-index
+ *    hashing).
+ *
+ -------------------------------------------------------------------------- */
+
+#include "muCore.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define MU_FAST_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define MU_FAST_SSE2 1
+#endif
+
+#define ORB_PATCH_RADIUS 15       /* orientation patch */
+#define ORB_PATTERN_RADIUS 13     /* test pairs, rotated pattern stays inside the patch */
+#define ORB_ANGLE_BINS 30         /* the pattern is rotated in steps of 12 degrees */
+#define MIH_TABLES 16             /* 256 bits = 16 substrings of 16 bits */
+
+/* Bresenham circle of radius 3 */
+static const MU_32S circleX[16] = { 0,  1,  2,  3,  3,  3,  2,  1,  0, -1, -2, -3, -3, -3, -2, -1 };
+static const MU_32S circleY[16] = {-3, -3, -2, -1,  0,  1,  2,  3,  3,  3,  2,  1,  0, -1, -2, -3 };
+
+/* FAST score: the largest t for which the pixel is still a corner (9 contiguous pixels all
+   brighter than v+t or all darker than v-t) */
+static MU_32S fastScore(const MU_8U *p, const MU_32S *offset)
+{
+	MU_32S d[25], k, j, best = 0, v = *p;
+
+	for(k=0; k<16; k++)
+		d[k] = p[offset[k]] - v;
+	for(k=16; k<25; k++)
+		d[k] = d[k-16];
+
+	for(k=0; k<16; k++)
+	{
+		MU_32S mn = d[k], mx = d[k];
+		for(j=k+1; j<k+9; j++)
+		{
+			mn = d[j] < mn ? d[j] : mn;
+			mx = d[j] > mx ? d[j] : mx;
+		}
+		best = mn > best ? mn : best;
+		best = -mx > best ? -mx : best;
+	}
+
+	return best;
+}
+
+/* contiguous arc of 9 set bits in a 16-bit ring mask */
+static MU_32S fastArc9(MU_32U m)
+{
+	MU_32U r = m | (m << 16);
+
+	r &= r >> 1;
+	r &= r >> 2;
+	r &= r >> 4;
+	r &= (m | (m << 16)) >> 8;
+
+	return (r & 0xffff) != 0;
+}
+
+static MU_32S fastTest(const MU_8U *p, const MU_32S *offset, MU_32S threshold)
+{
+	MU_32S k, v = *p;
+	MU_32U bright = 0, dark = 0;
+
+	for(k=0; k<16; k++)
+	{
+		MU_32S c = p[offset[k]];
+		bright |= (MU_32U)(c > v + threshold) << k;
+		dark |= (MU_32U)(c < v - threshold) << k;
+	}
+
+	return fastArc9(bright) || fastArc9(dark);
+}
+
+#if defined(MU_FAST_NEON) || defined(MU_FAST_SSE2)
+
+#if defined(MU_FAST_NEON)
+typedef uint8x16_t fastVec_t;
+#define FV_LOAD(p)      vld1q_u8(p)
+#define FV_STORE(p, a)  vst1q_u8(p, a)
+#define FV_AND(a, b)    vandq_u8(a, b)
+#define FV_OR(a, b)     vorrq_u8(a, b)
+#define FV_GT(a, b)     vcgtq_u8(a, b)
+#define FV_ADDS(a, b)   vqaddq_u8(a, b)
+#define FV_SUBS(a, b)   vqsubq_u8(a, b)
+#define FV_SET1(v)      vdupq_n_u8(v)
+#define FV_FLIP(a)      (a)
+#if defined(__aarch64__)
+#define FV_ANY(a)       (vmaxvq_u8(a) != 0)
+#else
+#define FV_ANY(a)       ((vget_lane_u64(vreinterpret_u64_u8(vorr_u8(vget_low_u8(a), vget_high_u8(a))), 0)) != 0)
+#endif
+#else
+/* SSE2 has only signed byte compares, the values are compared with the sign bit flipped */
+typedef __m128i fastVec_t;
+#define FV_LOAD(p)      _mm_loadu_si128((const __m128i *)(p))
+#define FV_STORE(p, a)  _mm_storeu_si128((__m128i *)(p), a)
+#define FV_AND(a, b)    _mm_and_si128(a, b)
+#define FV_OR(a, b)     _mm_or_si128(a, b)
+#define FV_GT(a, b)     _mm_cmpgt_epi8(a, b)
+#define FV_ADDS(a, b)   _mm_adds_epu8(a, b)
+#define FV_SUBS(a, b)   _mm_subs_epu8(a, b)
+#define FV_SET1(v)      _mm_set1_epi8((char)(v))
+#define FV_FLIP(a)      _mm_xor_si128(a, _mm_set1_epi8((char)0x80))
+#define FV_ANY(a)       (_mm_movemask_epi8(a) != 0)
+#endif
+
+/* arc test of 16 pixels at once, m[k] are the per-lane masks of the circle pixels */
+static fastVec_t fastArcVector(const fastVec_t *m)
+{
+	fastVec_t a2[16], a4[16], r;
+	MU_32S k;
+
+	for(k=0; k<16; k++)
+		a2[k] = FV_AND(m[k], m[(k+1)&15]);
+	for(k=0; k<16; k++)
+		a4[k] = FV_AND(a2[k], a2[(k+2)&15]);
+
+	r = FV_AND(FV_AND(a4[0], a4[4]), m[8]);
+	for(k=1; k<16; k++)
+		r = FV_OR(r, FV_AND(FV_AND(a4[k], a4[(k+4)&15]), m[(k+8)&15]));
+
+	return r;
+}
+
+/* returns the first x not processed */
+static MU_32S fastRowVector(const MU_8U *row, MU_32S x0, MU_32S x1, const MU_32S *offset,
+							MU_32S threshold, MU_8U *score)
+{
+	MU_32S x, k;
+	fastVec_t t = FV_SET1(threshold);
+
+	for(x=x0; x+16<=x1; x+=16)
+	{
+		const MU_8U *p = row + x;
+		fastVec_t v = FV_LOAD(p);
+		fastVec_t hi = FV_FLIP(FV_ADDS(v, t));
+		fastVec_t lo = FV_FLIP(FV_SUBS(v, t));
+		fastVec_t b[16], d[16], corner;
+		MU_8U lanes[16];
+
+		/* 9 contiguous pixels always contain two neighbouring compass points */
+		for(k=0; k<16; k+=4)
+		{
+			fastVec_t c = FV_FLIP(FV_LOAD(p+offset[k]));
+			b[k] = FV_GT(c, hi);
+			d[k] = FV_GT(lo, c);
+		}
+
+		corner = FV_OR(FV_OR(FV_AND(b[0], b[4]), FV_AND(b[4], b[8])), FV_OR(FV_AND(b[8], b[12]), FV_AND(b[12], b[0])));
+		corner = FV_OR(corner, FV_OR(FV_OR(FV_AND(d[0], d[4]), FV_AND(d[4], d[8])), FV_OR(FV_AND(d[8], d[12]), FV_AND(d[12], d[0]))));
+		if(!FV_ANY(corner))
+			continue;
+
+		for(k=0; k<16; k++)
+		{
+			if(k & 3)
+			{
+				fastVec_t c = FV_FLIP(FV_LOAD(p+offset[k]));
+				b[k] = FV_GT(c, hi);
+				d[k] = FV_GT(lo, c);
+			}
+		}
+
+		corner = FV_OR(fastArcVector(b), fastArcVector(d));
+		if(!FV_ANY(corner))
+			continue;
+
+		FV_STORE(lanes, corner);
+		for(k=0; k<16; k++)
+		{
+			if(lanes[k])
+			{
+				MU_32S s = fastScore(p+k, offset);
+				score[x+k] = (MU_8U)(s > 255 ? 255 : s);
+			}
+		}
+	}
+
+	return x;
+}
+#endif
+
+static int compareKeyPoint(const void *a, const void *b)
+{
+	const muKeyPoint_t *p = (const muKeyPoint_t *)a, *q = (const muKeyPoint_t *)b;
+
+	if(p->score != q->score)
+		return p->score > q->score ? -1 : 1;
+	if(p->y != q->y)
+		return p->y - q->y;
+	return p->x - q->x;
+}
+
+/*===========================================================================================*/
+/*   muFASTCorner                                                                            */
+/*                                                                                           */
+/*   DESCRIPTION:                                                                            */
+/*   FAST-9 corner detection: a pixel is a corner if 9 contiguous pixels of the radius 3     */
+/*   circle are all brighter than v+threshold or all darker than v-threshold.                */
+/*                                                                                           */
+/*   NOTE                                                                                    */
+/*   16 pixels are tested at once by SSE2/NEON byte compares and a vector arc test, the      */
+/*   score (largest threshold the corner survives) is only computed for the corners. With    */
+/*   nonmax the corners are 3x3 local maxima of the score. If there are more than maxkps     */
+/*   corners the strongest ones are kept. border >= 3 pixels are skipped at every side.      */
+/*                                                                                           */
+/*   USAGE                                                                                   */
+/*   muImage_t *src --> input image (8-bit, 1 channel)                                       */
+/*   MU_32S threshold --> intensity threshold                                                */
+/*   MU_32S nonmax --> 1: non-maximum suppression                                            */
+/*   MU_32S border --> image border to skip (16 for muORBDescriptor)                         */
+/*   muKeyPoint_t *kps, MU_32S maxkps --> output buffer                                      */
+/*   MU_32S *count --> number of keypoints                                                   */
+/*===========================================================================================*/
+muError_t muFASTCorner(const muImage_t *src, MU_32S threshold, MU_32S nonmax, MU_32S border,
+					   muKeyPoint_t *kps, MU_32S maxkps, MU_32S *count)
+{
+	MU_32S width, height, x, y, k, n, cap;
+	MU_32S offset[16];
+	MU_8U *score;
+	muKeyPoint_t *list;
+	muError_t ret;
+
+	ret = muCheckDepth(2, src, MU_IMG_DEPTH_8U);
+	if(ret)
+	{
+		return ret;
+	}
+
+	if(kps == NULL || count == NULL)
+	{
+		return MU_ERR_NULL_POINTER;
+	}
+
+	if(src->channels != 1)
+	{
+		return MU_ERR_NOT_SUPPORT;
+	}
+
+	if(threshold < 0 || threshold > 255 || maxkps <= 0)
+	{
+		return MU_ERR_INVALID_PARAMETER;
+	}
+
+	*count = 0;
+	width = src->width;
+	height = src->height;
+	border = border < 3 ? 3 : border;
+	if(width <= 2*border || height <= 2*border)
+	{
+		return MU_ERR_SUCCESS;
+	}
+
+	for(k=0; k<16; k++)
+		offset[k] = circleY[k]*width + circleX[k];
+
+	score = (MU_8U *)calloc(width*height, sizeof(MU_8U));
+	cap = 1024;
+	list = (muKeyPoint_t *)malloc(cap*sizeof(muKeyPoint_t));
+	if(score == NULL || list == NULL)
+	{
+		free(score);
+		free(list);
+		return MU_ERR_OUT_OF_MEMORY;
+	}
+
+	for(y=border; y<height-border; y++)
+	{
+		const MU_8U *row = src->imagedata + y*width;
+		MU_8U *s = score + y*width;
+
+		x = border;
+#if defined(MU_FAST_NEON) || defined(MU_FAST_SSE2)
+		x = fastRowVector(row, x, width-border, offset, threshold, s);
+#endif
+		for(; x<width-border; x++)
+		{
+			if(fastTest(row+x, offset, threshold))
+			{
+				MU_32S v = fastScore(row+x, offset);
+				s[x] = (MU_8U)(v > 255 ? 255 : v);
+			}
+		}
+	}
+
+	n = 0;
+	for(y=border; y<height-border; y++)
+	{
+		const MU_8U *s = score + y*width;
+		for(x=border; x<width-border; x++)
+		{
+			MU_32S v = s[x];
+			if(v == 0)
+				continue;
+
+			if(nonmax && !(v > s[x-width-1] && v > s[x-width] && v > s[x-width+1] && v > s[x-1] &&
+				v >= s[x+1] && v >= s[x+width-1] && v >= s[x+width] && v >= s[x+width+1]))
+				continue;
+
+			if(n == cap)
+			{
+				muKeyPoint_t *buf = (muKeyPoint_t *)realloc(list, 2*cap*sizeof(muKeyPoint_t));
+				if(buf == NULL)
+				{
+					free(score);
+					free(list);
+					return MU_ERR_OUT_OF_MEMORY;
+				}
+				list = buf;
+				cap *= 2;
+			}
+
+			list[n].x = x;
+			list[n].y = y;
+			list[n].score = v;
+			list[n].angle = 0;
+			n++;
+		}
+	}
+
+	if(n > maxkps)
+	{
+		qsort(list, n, sizeof(muKeyPoint_t), compareKeyPoint);
+		n = maxkps;
+	}
+
+	memcpy(kps, list, n*sizeof(muKeyPoint_t));
+	*count = n;
+
+	free(score);
+	free(list);
+
+	return MU_ERR_SUCCESS;
+}
+
+/*===========================================================================================*/
+/*   muKeyPointOrientation                                                                   */
+/*                                                                                           */
+/*   DESCRIPTION:                                                                            */
+/*   Orientation by the intensity centroid of the radius 15 disc around the keypoint,        */
+/*   angle = atan2(m01, m10) in radian. Keypoints must be 15 pixels from the image border.   */
+/*===========================================================================================*/
+muError_t muKeyPointOrientation(const muImage_t *src, muKeyPoint_t *kps, MU_32S count)
+{
+	MU_32S umax[ORB_PATCH_RADIUS+1];
+	MU_32S i, u, v, width;
+	muError_t ret;
+
+	ret = muCheckDepth(2, src, MU_IMG_DEPTH_8U);
+	if(ret)
+	{
+		return ret;
+	}
+
+	if(kps == NULL)
+	{
+		return MU_ERR_NULL_POINTER;
+	}
+
+	/* half width of every row of the disc */
+	for(v=0; v<=ORB_PATCH_RADIUS; v++)
+		umax[v] = (MU_32S)sqrt((MU_64F)(ORB_PATCH_RADIUS*ORB_PATCH_RADIUS - v*v) + 0.5);
+
+	width = src->width;
+	for(i=0; i<count; i++)
+	{
+		const MU_8U *center = src->imagedata + kps[i].y*width + kps[i].x;
+		MU_32S m01 = 0, m10 = 0;
+
+		if(kps[i].x < ORB_PATCH_RADIUS || kps[i].y < ORB_PATCH_RADIUS ||
+			kps[i].x >= width-ORB_PATCH_RADIUS || kps[i].y >= src->height-ORB_PATCH_RADIUS)
+		{
+			return MU_ERR_INVALID_PARAMETER;
+		}
+
+		for(u=-ORB_PATCH_RADIUS; u<=ORB_PATCH_RADIUS; u++)
+			m10 += u*center[u];
+
+		/* the rows +v and -v share the loop */
+		for(v=1; v<=ORB_PATCH_RADIUS; v++)
+		{
+			MU_32S vsum = 0;
+			for(u=-umax[v]; u<=umax[v]; u++)
+			{
+				MU_32S up = center[u - v*width], down = center[u + v*width];
+				vsum += down - up;
+				m10 += u*(down + up);
+			}
+			m01 += v*vsum;
+		}
+
+		kps[i].angle = (MU_32F)atan2((MU_64F)m01, (MU_64F)m10);
+	}
+
+	return MU_ERR_SUCCESS;
+}
+
+/* separable [1 4 6 4 1]/16 smoothing, the border rows/columns are replicated */
+static MU_VOID smoothGauss5(const MU_8U *in, MU_8U *out, MU_32S width, MU_32S height, MU_16U *tmp)
+{
+	MU_32S x, y;
+
+	for(y=0; y<height; y++)
+	{
+		const MU_8U *r0 = in + (y < 2 ? 0 : y-2)*width;
+		const MU_8U *r1 = in + (y < 1 ? 0 : y-1)*width;
+		const MU_8U *r2 = in + y*width;
+		const MU_8U *r3 = in + (y+1 >= height ? height-1 : y+1)*width;
+		const MU_8U *r4 = in + (y+2 >= height ? height-1 : y+2)*width;
+		MU_8U *o = out + y*width;
+
+		for(x=0; x<width; x++)
+			tmp[x+2] = (MU_16U)(r0[x] + 4*(r1[x] + r3[x]) + 6*r2[x] + r4[x]);
+
+		tmp[0] = tmp[1] = tmp[2];
+		tmp[width+2] = tmp[width+3] = tmp[width+1];
+
+		for(x=0; x<width; x++)
+			o[x] = (MU_8U)((tmp[x] + 4*(tmp[x+1] + tmp[x+3]) + 6*tmp[x+2] + tmp[x+4] + 128) >> 8);
+	}
+}
+
+/* BRIEF test pairs, isotropic gaussian (sigma = patch/5) around the keypoint, fixed seed */
+static MU_VOID createPattern(MU_8S *pattern)
+{
+	MU_32U seed = 0x12345678;
+	MU_32S i;
+
+	for(i=0; i<512; )
+	{
+		MU_64F u1, u2, g;
+		MU_32S x, y;
+
+		seed = seed*1664525 + 1013904223;
+		u1 = ((seed >> 8) + 1)/16777217.0;
+		seed = seed*1664525 + 1013904223;
+		u2 = (seed >> 8)/16777216.0;
+
+		g = sqrt(-2.0*log(u1))*(2*ORB_PATTERN_RADIUS + 1)/5.0;
+		x = muRound(g*cos(2*MU_PI*u2));
+		y = muRound(g*sin(2*MU_PI*u2));
+
+		if(x*x + y*y > ORB_PATTERN_RADIUS*ORB_PATTERN_RADIUS)
+			continue;
+
+		pattern[2*i] = (MU_8S)x;
+		pattern[2*i+1] = (MU_8S)y;
+		i++;
+	}
+}
+
+/*===========================================================================================*/
+/*   muORBDescriptor                                                                         */
+/*                                                                                           */
+/*   DESCRIPTION:                                                                            */
+/*   256-bit rotated BRIEF descriptors (ORB). Every bit compares two pixels of the smoothed  */
+/*   image, the test pattern is rotated by the keypoint angle (muKeyPointOrientation).       */
+/*                                                                                           */
+/*   NOTE                                                                                    */
+/*   The pattern is rotated in 30 steps of 12 degrees, the offset tables of all steps are    */
+/*   built once per call. Keypoints closer than 16 pixels to the border are removed, count   */
+/*   is updated and desc[i*32 .. i*32+31] belongs to the kept kps[i].                        */
+/*                                                                                           */
+/*   USAGE                                                                                   */
+/*   muImage_t *src --> input image (8-bit, 1 channel)                                       */
+/*   muKeyPoint_t *kps, MU_32S *count --> keypoints                                          */
+/*   MU_8U *desc --> descriptors, 32 bytes per keypoint                                      */
+/*===========================================================================================*/
+muError_t muORBDescriptor(const muImage_t *src, muKeyPoint_t *kps, MU_32S *count, MU_8U *desc)
+{
+	MU_8S pattern[1024];
+	MU_32S *offsets;
+	MU_8U *smooth;
+	MU_16U *tmp;
+	MU_32S width, height, border, i, j, k, n;
+	muError_t ret;
+
+	ret = muCheckDepth(2, src, MU_IMG_DEPTH_8U);
+	if(ret)
+	{
+		return ret;
+	}
+
+	if(kps == NULL || count == NULL || desc == NULL)
+	{
+		return MU_ERR_NULL_POINTER;
+	}
+
+	if(src->channels != 1)
+	{
+		return MU_ERR_NOT_SUPPORT;
+	}
+
+	width = src->width;
+	height = src->height;
+	border = ORB_PATCH_RADIUS + 1;
+
+	smooth = (MU_8U *)malloc(width*height*sizeof(MU_8U));
+	tmp = (MU_16U *)malloc((width+4)*sizeof(MU_16U));
+	offsets = (MU_32S *)malloc(ORB_ANGLE_BINS*512*sizeof(MU_32S));
+	if(smooth == NULL || tmp == NULL || offsets == NULL)
+	{
+		free(smooth);
+		free(tmp);
+		free(offsets);
+		return MU_ERR_OUT_OF_MEMORY;
+	}
+
+	smoothGauss5(src->imagedata, smooth, width, height, tmp);
+
+	createPattern(pattern);
+	for(k=0; k<ORB_ANGLE_BINS; k++)
+	{
+		MU_64F a = k*2*MU_PI/ORB_ANGLE_BINS, c = cos(a), s = sin(a);
+		for(j=0; j<512; j++)
+		{
+			MU_32S x = muRound(c*pattern[2*j] - s*pattern[2*j+1]);
+			MU_32S y = muRound(s*pattern[2*j] + c*pattern[2*j+1]);
+			offsets[k*512 + j] = y*width + x;
+		}
+	}
+
+	for(i=0, n=0; i<*count; i++)
+	{
+		const MU_8U *center;
+		const MU_32S *off;
+		MU_8U *d = desc + n*32;
+		MU_32F a;
+
+		if(kps[i].x < border || kps[i].y < border || kps[i].x >= width-border || kps[i].y >= height-border)
+			continue;
+
+		a = kps[i].angle;
+		k = muRound(a*ORB_ANGLE_BINS/(2*MU_PI));
+		k = ((k % ORB_ANGLE_BINS) + ORB_ANGLE_BINS) % ORB_ANGLE_BINS;
+
+		center = smooth + kps[i].y*width + kps[i].x;
+		off = offsets + k*512;
+		for(j=0; j<32; j++, off+=16)
+		{
+			d[j] = (MU_8U)((center[off[0]] < center[off[1]]) |
+				((center[off[2]] < center[off[3]]) << 1) |
+				((center[off[4]] < center[off[5]]) << 2) |
+				((center[off[6]] < center[off[7]]) << 3) |
+				((center[off[8]] < center[off[9]]) << 4) |
+				((center[off[10]] < center[off[11]]) << 5) |
+				((center[off[12]] < center[off[13]]) << 6) |
+				((center[off[14]] < center[off[15]]) << 7));
+		}
+
+		kps[n++] = kps[i];
+	}
+	*count = n;
+
+	free(smooth);
+	free(tmp);
+	free(offsets);
+
+	return MU_ERR_SUCCESS;
+}
+
+/* Hamming distance of two 256-bit descriptors */
+static MU_32S hamming256(const MU_8U *a, const MU_8U *b)
+{
+#if defined(__GNUC__)
+	/* popcnt on x86 with -mpopcnt, cnt on aarch64 */
+	MU_64U a0, a1, a2, a3, b0, b1, b2, b3;
+
+	memcpy(&a0, a, 8); memcpy(&a1, a+8, 8); memcpy(&a2, a+16, 8); memcpy(&a3, a+24, 8);
+	memcpy(&b0, b, 8); memcpy(&b1, b+8, 8); memcpy(&b2, b+16, 8); memcpy(&b3, b+24, 8);
+
+	return __builtin_popcountll(a0 ^ b0) + __builtin_popcountll(a1 ^ b1) +
+		__builtin_popcountll(a2 ^ b2) + __builtin_popcountll(a3 ^ b3);
+#else
+	MU_32S i, d = 0;
+
+	for(i=0; i<32; i+=4)
+	{
+		MU_32U x = (MU_32U)(a[i] ^ b[i]) | ((MU_32U)(a[i+1] ^ b[i+1]) << 8) |
+			((MU_32U)(a[i+2] ^ b[i+2]) << 16) | ((MU_32U)(a[i+3] ^ b[i+3]) << 24);
+		x = x - ((x >> 1) & 0x55555555);
+		x = (x & 0x33333333) + ((x >> 2) & 0x33333333);
+		d += (((x + (x >> 4)) & 0x0f0f0f0f)*0x01010101) >> 24;
+	}
+
+	return d;
+#endif
+}
+
+/*===========================================================================================*/
+/*   muMatchBinary                                                                           */
+/*                                                                                           */
+/*   DESCRIPTION:                                                                            */
+/*   Brute force nearest neighbour of every query descriptor by Hamming distance.            */
+/*   matches[i].train = -1 if no train descriptor is closer than maxdistance.                */
+/*                                                                                           */
+/*   USAGE                                                                                   */
+/*   MU_8U *query, MU_32S nquery --> query descriptors (32 bytes each)                       */
+/*   MU_8U *train, MU_32S ntrain --> train descriptors                                       */
+/*   MU_32S maxdistance --> maximal accepted distance                                        */
+/*   muDMatch_t *matches --> nquery matches                                                  */
+/*===========================================================================================*/
+muError_t muMatchBinary(const MU_8U *query, MU_32S nquery, const MU_8U *train, MU_32S ntrain,
+						MU_32S maxdistance, muDMatch_t *matches)
+{
+	MU_32S i;
+
+	if(query == NULL || train == NULL || matches == NULL)
+	{
+		return MU_ERR_NULL_POINTER;
+	}
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+	for(i=0; i<nquery; i++)
+	{
+		MU_32S j, best = maxdistance + 1, bestj = -1;
+		const MU_8U *q = query + i*32;
+
+		for(j=0; j<ntrain; j++)
+		{
+			MU_32S d = hamming256(q, train + j*32);
+			if(d < best)
+			{
+				best = d;
+				bestj = j;
+			}
+		}
+
+		matches[i].query = i;
+		matches[i].train = bestj;
+		matches[i].distance = bestj >= 0 ? best : -1;
+	}
+
+	return MU_ERR_SUCCESS;
+}
+
+/*===========================================================================================*/
+/*   muCreateBinaryIndex / muMatchBinaryIndex / muReleaseBinaryIndex                         */
+/*                                                                                           */
+/*   DESCRIPTION:                                                                            */
+/*   Multi-index hashing of the train descriptors: the 256 bits are split into 16 substrings */
+/*   of 16 bits and every substring has its own table (buckets of descriptor indices).       */
+/*   A query only verifies the descriptors which share a substring within radius (0 or 1)    */
+/*   of its own, so every descriptor closer than 16*(radius+1) is found (pigeonhole).        */
+/*===========================================================================================*/
+muBinaryIndex_t* muCreateBinaryIndex(const MU_8U *train, MU_32S ntrain)
+{
+	muBinaryIndex_t *index;
+	MU_32S t, i;
+
+	if(train == NULL || ntrain <= 0)
+	{
+		return NULL;
+	}
+
+	index = (muBinaryIndex_t *)calloc(1, sizeof(muBinaryIndex_t));
+	if(index == NULL)
+	{
+		return NULL;
+	}
+
+	index->train = train;
+	index->ntrain = ntrain;
+	index->start = (MU_32S *)calloc(MIH_TABLES*65537, sizeof(MU_32S));
+	index->entry = (MU_32S *)malloc(MIH_TABLES*ntrain*sizeof(MU_32S));
+	if(index->start == NULL || index->entry == NULL)
+	{
+		muReleaseBinaryIndex(&index);
+		return NULL;
+	}
+
+	/* counting sort of every table */
+	for(t=0; t<MIH_TABLES; t++)
+	{
+		MU_32S *start = index->start + t*65537;
+		MU_32S *entry = index->entry + t*ntrain;
+
+		for(i=0; i<ntrain; i++)
+		{
+			const MU_8U *d = train + i*32 + 2*t;
+			start[(d[0] | (d[1] << 8)) + 1]++;
+		}
+		for(i=0; i<65536; i++)
+			start[i+1] += start[i];
+		for(i=0; i<ntrain; i++)
+		{
+			const MU_8U *d = train + i*32 + 2*t;
+			entry[start[d[0] | (d[1] << 8)]++] = i;
+		}
+		for(i=65536; i>0; i--)
+			start[i] = start[i-1];
+		start[0] = 0;
+	}
+
+	return index;
+}
+
+muError_t muMatchBinaryIndex(const muBinaryIndex_t *index, const MU_8U *query, MU_32S nquery,
+							 MU_32S radius, MU_32S maxdistance, muDMatch_t *matches)
+{
+	MU_32S i;
+	muError_t ret = MU_ERR_SUCCESS;
+
+	if(index == NULL || query == NULL || matches == NULL)
+	{
+		return MU_ERR_NULL_POINTER;
+	}
+
+	if(radius < 0 || radius > 1)
+	{
+		return MU_ERR_INVALID_PARAMETER;
+	}
+
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+	{
+		/* the last query which verified a descriptor, avoids verifying it twice */
+		MU_32S *stamp = (MU_32S *)malloc(index->ntrain*sizeof(MU_32S));
+
+		if(stamp == NULL)
+			ret = MU_ERR_OUT_OF_MEMORY;
+		else
+			memset(stamp, 0xff, index->ntrain*sizeof(MU_32S));
+
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 16)
+#endif
+		for(i=0; i<nquery; i++)
+		{
+			MU_32S t, b, best = maxdistance + 1, bestj = -1;
+			const MU_8U *q = query + i*32;
+
+			for(t=0; t<MIH_TABLES && stamp; t++)
+			{
+				const MU_32S *start = index->start + t*65537;
+				const MU_32S *entry = index->entry + t*index->ntrain;
+				MU_32S key = q[2*t] | (q[2*t+1] << 8);
+
+				/* b = -1: the key itself, else the key with bit b flipped */
+				for(b=-1; b<(radius ? 16 : 0); b++)
+				{
+					MU_32S k = b < 0 ? key : key ^ (1 << b), e;
+					for(e=start[k]; e<start[k+1]; e++)
+					{
+						MU_32S j = entry[e], d;
+						if(stamp[j] == i)
+							continue;
+						stamp[j] = i;
+						d = hamming256(q, index->train + j*32);
+						if(d < best || (d == best && j < bestj))
+						{
+							best = d;
+							bestj = j;
+						}
+					}
+				}
+			}
+
+			matches[i].query = i;
+			matches[i].train = bestj;
+			matches[i].distance = bestj >= 0 ? best : -1;
+		}
+
+		free(stamp);
+	}
+
+	return ret;
+}
+
+muError_t muReleaseBinaryIndex(muBinaryIndex_t **index)
+{
+	if(index == NULL || *index == NULL)
+	{
+		return MU_ERR_NULL_POINTER;
+	}
+
+	free((*index)->start);
+	free((*index)->entry);
+	free(*index);
+	*index = NULL;
+
+	return MU_ERR_SUCCESS;
+}
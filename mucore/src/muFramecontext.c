@@ -0,0 +1,387 @@
+/*
+% MIT License
+%
+% Copyright (c) 2016 OneCV
+%
+% Permission is hereby granted, free of charge, to any person obtaining a copy
+% of this software and associated documentation files (the "Software"), to deal
+% in the Software without restriction, including without limitation the rights
+% to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+% copies of the Software, and to permit persons to whom the Software is
+% furnished to do so, subject to the following conditions:
+%
+% The above copyright notice and this permission notice shall be included in all
+% copies or substantial portions of the Software.
+%
+% THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+% IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+% FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+% AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+% LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+% OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+% SOFTWARE.
+*/
+
+/* ------------------------------------------------------------------------- /
+ *
+ * Module: muFramecontext.c
+ * Author: Joe Lin
+ *
+ * Description:
+ *    Per frame cache of derived data (gray, integral, pyramid, gradient,
+ *    histogram). Every derivative is computed on its first request only and
+ *    the buffers are kept for the next frames.
+ *
+ -------------------------------------------------------------------------- */
+
+#include "muCore.h"
+
+#define FC_GRAY       0x01
+#define FC_INTEGRAL   0x02
+#define FC_SQINTEGRAL 0x04
+#define FC_GRADIENT   0x08
+#define FC_HISTOGRAM  0x10
+#define FC_PYRAMID(l) (0x100 << (l))
+
+
+/* 2x2 box average, odd last row/column dropped */
+static MU_VOID halveImage(const muImage_t *src, muImage_t *dst)
+{
+	MU_32S x, y;
+
+	for(y=0; y<dst->height; y++)
+	{
+		const MU_8U *r0 = src->imagedata + 2*y*src->width;
+		const MU_8U *r1 = r0 + src->width;
+		MU_8U *out = dst->imagedata + y*dst->width;
+		for(x=0; x<dst->width; x++)
+		{
+			out[x] = (MU_8U)((r0[2*x] + r0[2*x+1] + r1[2*x] + r1[2*x+1] + 2) >> 2);
+		}
+	}
+}
+
+/*===========================================================================================*/
+/*   muCreateFrameContext / muReleaseFrameContext                                            */
+/*                                                                                           */
+/*   DESCRIPTION:                                                                            */
+/*   Frame context of frames of the given size. Nothing is allocated before the first        */
+/*   request, then the buffers are reused by every frame.                                    */
+/*===========================================================================================*/
+muFrameContext_t* muCreateFrameContext(muSize_t size)
+{
+	muFrameContext_t *ctx;
+
+	if(size.width <= 0 || size.height <= 0)
+	{
+		return NULL;
+	}
+
+	ctx = (muFrameContext_t *)calloc(1, sizeof(muFrameContext_t));
+	if(ctx == NULL)
+	{
+		return NULL;
+	}
+
+	ctx->size = size;
+	ctx->integral.imgSize = size;
+	ctx->integral.sumSize.width = size.width + 1;
+	ctx->integral.sumSize.height = size.height + 1;
+
+	return ctx;
+}
+
+muError_t muReleaseFrameContext(muFrameContext_t **ctx)
+{
+	MU_32S i;
+
+	if(ctx == NULL || *ctx == NULL)
+	{
+		return MU_ERR_NULL_POINTER;
+	}
+
+	if((*ctx)->gray)
+		muReleaseImage(&(*ctx)->gray);
+	if((*ctx)->gradient)
+		muReleaseImage(&(*ctx)->gradient);
+	/* level 0 is the gray image */
+	for(i=1; i<MU_FRAME_PYRAMID_LEVELS; i++)
+	{
+		if((*ctx)->pyramid[i])
+			muReleaseImage(&(*ctx)->pyramid[i]);
+	}
+	free((*ctx)->integral.sum);
+	free((*ctx)->sqbuf);
+	free(*ctx);
+	*ctx = NULL;
+
+	return MU_ERR_SUCCESS;
+}
+
+/*===========================================================================================*/
+/*   muFrameContextSetFrame                                                                  */
+/*                                                                                           */
+/*   DESCRIPTION:                                                                            */
+/*   Starts a new frame: all cached derivatives become invalid, the buffers are kept.        */
+/*                                                                                           */
+/*   NOTE                                                                                    */
+/*   frame is 8-bit gray or BGR of the context size and is not copied, it must stay valid    */
+/*   and unchanged until the next muFrameContextSetFrame.                                    */
+/*===========================================================================================*/
+muError_t muFrameContextSetFrame(muFrameContext_t *ctx, const muImage_t *frame)
+{
+	muError_t ret;
+
+	ret = muCheckDepth(2, frame, MU_IMG_DEPTH_8U);
+	if(ret)
+	{
+		return ret;
+	}
+
+	if(ctx == NULL)
+	{
+		return MU_ERR_NULL_POINTER;
+	}
+
+	if((frame->channels != 1 && frame->channels != 3) ||
+		frame->width != ctx->size.width || frame->height != ctx->size.height)
+	{
+		return MU_ERR_NOT_SUPPORT;
+	}
+
+	ctx->frame = frame;
+	ctx->valid = 0;
+	ctx->integral.sqsum = NULL;
+	ctx->frameid++;
+
+	return MU_ERR_SUCCESS;
+}
+
+/*===========================================================================================*/
+/*   muFrameGray                                                                             */
+/*                                                                                           */
+/*   DESCRIPTION:                                                                            */
+/*   Gray level of the frame, the frame itself when it is already gray.                      */
+/*===========================================================================================*/
+const muImage_t* muFrameGray(muFrameContext_t *ctx)
+{
+	if(ctx == NULL || ctx->frame == NULL)
+	{
+		return NULL;
+	}
+
+	if(ctx->frame->channels == 1)
+	{
+		return ctx->frame;
+	}
+
+	if(!(ctx->valid & FC_GRAY))
+	{
+		if(ctx->gray == NULL)
+		{
+			ctx->gray = muCreateImage(ctx->size, MU_IMG_DEPTH_8U, 1);
+			if(ctx->gray == NULL)
+				return NULL;
+		}
+		if(muRGB2GrayLevel(ctx->frame, ctx->gray))
+			return NULL;
+		ctx->valid |= FC_GRAY;
+	}
+
+	return ctx->gray;
+}
+
+/*===========================================================================================*/
+/*   muFrameIntegral                                                                         */
+/*                                                                                           */
+/*   DESCRIPTION:                                                                            */
+/*   Integral image of the gray frame in the muCalcIntegralImage layout, so it can be passed */
+/*   to muObjectDetection_Light/_SuperLight, muObjectDetection_Frame and                     */
+/*   muAdaptiveThresholding directly. sqsum is only computed when withsq = 1, it is NULL     */
+/*   while the squared integral of the current frame has not been requested.                 */
+/*===========================================================================================*/
+const muIntegralImg_t* muFrameIntegral(muFrameContext_t *ctx, MU_32S withsq)
+{
+	const muImage_t *gray;
+	MU_32S x, y, width, height, step;
+	MU_32U need;
+
+	gray = muFrameGray(ctx);
+	if(gray == NULL)
+	{
+		return NULL;
+	}
+
+	need = withsq ? (FC_INTEGRAL | FC_SQINTEGRAL) : FC_INTEGRAL;
+	if((ctx->valid & need) == need)
+	{
+		return &ctx->integral;
+	}
+
+	width = ctx->size.width;
+	height = ctx->size.height;
+	step = width + 1;
+
+	if(ctx->integral.sum == NULL)
+	{
+		ctx->integral.sum = (MU_32S *)malloc(step*(height+1)*sizeof(MU_32S));
+		if(ctx->integral.sum == NULL)
+			return NULL;
+	}
+	if(withsq && ctx->sqbuf == NULL)
+	{
+		ctx->sqbuf = (MU_64F *)malloc(step*(height+1)*sizeof(MU_64F));
+		if(ctx->sqbuf == NULL)
+			return NULL;
+	}
+
+	/* the sum is kept when only the squared sum is missing */
+	if(!(ctx->valid & FC_INTEGRAL))
+	{
+		MU_32S *sum = ctx->integral.sum;
+		const MU_8U *in = gray->imagedata;
+
+		memset(sum, 0, step*sizeof(MU_32S));
+		for(y=0; y<height; y++, in+=width)
+		{
+			MU_32S s = 0;
+			MU_32S *row = sum + (y+1)*step;
+			row[0] = 0;
+			for(x=0; x<width; x++)
+			{
+				s += in[x];
+				row[x+1] = row[x+1-step] + s;
+			}
+		}
+		ctx->valid |= FC_INTEGRAL;
+	}
+
+	if(withsq && !(ctx->valid & FC_SQINTEGRAL))
+	{
+		MU_64F *sqsum = ctx->sqbuf;
+		const MU_8U *in = gray->imagedata;
+
+		memset(sqsum, 0, step*sizeof(MU_64F));
+		for(y=0; y<height; y++, in+=width)
+		{
+			MU_64F sq = 0;
+			MU_64F *row = sqsum + (y+1)*step;
+			row[0] = 0;
+			for(x=0; x<width; x++)
+			{
+				sq += in[x]*in[x];
+				row[x+1] = row[x+1-step] + sq;
+			}
+		}
+		ctx->valid |= FC_SQINTEGRAL;
+		ctx->integral.sqsum = sqsum;
+	}
+
+	return &ctx->integral;
+}
+
+/*===========================================================================================*/
+/*   muFramePyramid                                                                          */
+/*                                                                                           */
+/*   DESCRIPTION:                                                                            */
+/*   Level l of the gray pyramid, every level is the 2x2 average of the level above (level  */
+/*   0 = gray). Only the requested level and the levels above it are computed.              */
+/*===========================================================================================*/
+const muImage_t* muFramePyramid(muFrameContext_t *ctx, MU_32S level)
+{
+	const muImage_t *up;
+	muSize_t size;
+
+	if(level < 0 || level >= MU_FRAME_PYRAMID_LEVELS)
+	{
+		return NULL;
+	}
+
+	if(level == 0)
+	{
+		return muFrameGray(ctx);
+	}
+
+	if(ctx != NULL && (ctx->valid & FC_PYRAMID(level)))
+	{
+		return ctx->pyramid[level];
+	}
+
+	up = muFramePyramid(ctx, level-1);
+	if(up == NULL || up->width < 2 || up->height < 2)
+	{
+		return NULL;
+	}
+
+	if(ctx->pyramid[level] == NULL)
+	{
+		size.width = up->width/2;
+		size.height = up->height/2;
+		ctx->pyramid[level] = muCreateImage(size, MU_IMG_DEPTH_8U, 1);
+		if(ctx->pyramid[level] == NULL)
+			return NULL;
+	}
+
+	halveImage(up, ctx->pyramid[level]);
+	ctx->valid |= FC_PYRAMID(level);
+
+	return ctx->pyramid[level];
+}
+
+/*===========================================================================================*/
+/*   muFrameGradient                                                                         */
+/*                                                                                           */
+/*   DESCRIPTION:                                                                            */
+/*   Sobel gradient magnitude (muSobel) of the gray frame.                                   */
+/*===========================================================================================*/
+const muImage_t* muFrameGradient(muFrameContext_t *ctx)
+{
+	const muImage_t *gray;
+
+	gray = muFrameGray(ctx);
+	if(gray == NULL)
+	{
+		return NULL;
+	}
+
+	if(!(ctx->valid & FC_GRADIENT))
+	{
+		if(ctx->gradient == NULL)
+		{
+			ctx->gradient = muCreateImage(ctx->size, MU_IMG_DEPTH_8U, 1);
+			if(ctx->gradient == NULL)
+				return NULL;
+		}
+		if(muSobel(gray, ctx->gradient))
+			return NULL;
+		ctx->valid |= FC_GRADIENT;
+	}
+
+	return ctx->gradient;
+}
+
+/*===========================================================================================*/
+/*   muFrameHistogram                                                                        */
+/*                                                                                           */
+/*   DESCRIPTION:                                                                            */
+/*   256-bin histogram of the gray frame (muHistogram).                                      */
+/*===========================================================================================*/
+const MU_32U* muFrameHistogram(muFrameContext_t *ctx)
+{
+	const muImage_t *gray;
+
+	gray = muFrameGray(ctx);
+	if(gray == NULL)
+	{
+		return NULL;
+	}
+
+	if(!(ctx->valid & FC_HISTOGRAM))
+	{
+		if(muHistogram(gray, ctx->hist))
+			return NULL;
+		ctx->valid |= FC_HISTOGRAM;
+	}
+
+	return ctx->hist;
+}
@@ -0,0 +1,522 @@
+/*
+% MIT License
+%
+% Copyright (c) 2016 OneCV
+%
+% Permission is hereby granted, free of charge, to any person obtaining a copy
+% of this software and associated documentation files (the "Software"), to deal
+% in the Software without restriction, including without limitation the rights
+% to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+% copies of the Software, and to permit persons to whom the Software is
+% furnished to do so, subject to the following conditions:
+%
+% The above copyright notice and this permission notice shall be included in all
+% copies or substantial portions of the Software.
+%
+% THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+% IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+% FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+% AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+% LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+% OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+% SOFTWARE.
+*/
+
+/* ------------------------------------------------------------------------- /
+ *
+ * Module: muGlobalmotion.c
+ * Author: Joe Lin
+ *
+ * Description:
+ *    Global (camera) motion between consecutive frames: phase correlation
+ *    and block matching on a downscaled frame, RANSAC model fitting.
+ *
+ -------------------------------------------------------------------------- */
+
+#include "muCore.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define MU_GM_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define MU_GM_SSE2 1
+#endif
+
+#define GM_BLOCK 8               /* block size on the downscaled frame */
+#define GM_MAX_BLOCKS 96
+#define GM_RANSAC_ITER 64
+#define GM_INLIER_TH 1.0         /* pixel on the downscaled frame */
+
+/* 8x8 SAD */
+static MU_32S blockSAD(const MU_8U *a, const MU_8U *b, MU_32S step)
+{
+#if defined(MU_GM_SSE2)
+	__m128i acc = _mm_setzero_si128();
+	MU_32S y;
+
+	for(y=0; y<GM_BLOCK; y+=2, a+=2*step, b+=2*step)
+	{
+		__m128i va = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)a), _mm_loadl_epi64((const __m128i *)(a+step)));
+		__m128i vb = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)b), _mm_loadl_epi64((const __m128i *)(b+step)));
+		acc = _mm_add_epi64(acc, _mm_sad_epu8(va, vb));
+	}
+
+	return _mm_cvtsi128_si32(acc) + _mm_cvtsi128_si32(_mm_srli_si128(acc, 8));
+#elif defined(MU_GM_NEON)
+	uint16x8_t acc = vdupq_n_u16(0);
+	uint32x4_t s32;
+	uint64x2_t s64;
+	MU_32S y;
+
+	for(y=0; y<GM_BLOCK; y++, a+=step, b+=step)
+		acc = vabal_u8(acc, vld1_u8(a), vld1_u8(b));
+
+	s32 = vpaddlq_u16(acc);
+	s64 = vpaddlq_u32(s32);
+	return (MU_32S)(vgetq_lane_u64(s64, 0) + vgetq_lane_u64(s64, 1));
+#else
+	MU_32S x, y, s = 0;
+
+	for(y=0; y<GM_BLOCK; y++, a+=step, b+=step)
+		for(x=0; x<GM_BLOCK; x++)
+			s += abs(a[x] - b[x]);
+
+	return s;
+#endif
+}
+
+/* box average by 1, 2 or 4 */
+static MU_VOID downscaleFrame(const muImage_t *src, muImage_t *dst, MU_32S scale)
+{
+	MU_32S x, y, i, j, area = scale*scale;
+
+	if(scale == 1)
+	{
+		memcpy(dst->imagedata, src->imagedata, dst->width*dst->height);
+		return;
+	}
+
+	for(y=0; y<dst->height; y++)
+	{
+		const MU_8U *in = src->imagedata + y*scale*src->width;
+		MU_8U *out = dst->imagedata + y*dst->width;
+		for(x=0; x<dst->width; x++)
+		{
+			MU_32S s = 0;
+			for(j=0; j<scale; j++)
+				for(i=0; i<scale; i++)
+					s += in[j*src->width + x*scale + i];
+			out[x] = (MU_8U)((s + area/2)/area);
+		}
+	}
+}
+
+/* minimal sample models, q = m p */
+static MU_32S fitMinimal(const MU_32F *p, const MU_32F *q, const MU_32S *idx, MU_32S model, MU_64F *m)
+{
+	if(model == MU_MOTION_TRANSLATION)
+	{
+		m[0] = 1; m[1] = 0; m[2] = q[2*idx[0]] - p[2*idx[0]];
+		m[3] = 0; m[4] = 1; m[5] = q[2*idx[0]+1] - p[2*idx[0]+1];
+		return 1;
+	}
+	else if(model == MU_MOTION_SIMILARITY)
+	{
+		/* q = [a -b; b a] p + t from two points */
+		MU_64F px = p[2*idx[1]] - p[2*idx[0]], py = p[2*idx[1]+1] - p[2*idx[0]+1];
+		MU_64F qx = q[2*idx[1]] - q[2*idx[0]], qy = q[2*idx[1]+1] - q[2*idx[0]+1];
+		MU_64F d = px*px + py*py, a, b;
+		if(d < 1e-6)
+			return 0;
+		a = (px*qx + py*qy)/d;
+		b = (px*qy - py*qx)/d;
+		m[0] = a; m[1] = -b; m[2] = q[2*idx[0]] - (a*p[2*idx[0]] - b*p[2*idx[0]+1]);
+		m[3] = b; m[4] = a;  m[5] = q[2*idx[0]+1] - (b*p[2*idx[0]] + a*p[2*idx[0]+1]);
+		return 1;
+	}
+	else
+	{
+		/* solve the 3x3 system of three points for each row */
+		MU_64F x0 = p[2*idx[0]], y0 = p[2*idx[0]+1];
+		MU_64F x1 = p[2*idx[1]], y1 = p[2*idx[1]+1];
+		MU_64F x2 = p[2*idx[2]], y2 = p[2*idx[2]+1];
+		MU_64F det = x0*(y1 - y2) - y0*(x1 - x2) + (x1*y2 - x2*y1);
+		MU_32S r;
+		if(fabs(det) < 1e-6)
+			return 0;
+		for(r=0; r<2; r++)
+		{
+			MU_64F v0 = q[2*idx[0]+r], v1 = q[2*idx[1]+r], v2 = q[2*idx[2]+r];
+			m[3*r]   = (v0*(y1 - y2) - y0*(v1 - v2) + (v1*y2 - v2*y1))/det;
+			m[3*r+1] = (x0*(v1 - v2) - v0*(x1 - x2) + (x1*v2 - x2*v1))/det;
+			m[3*r+2] = (x0*(y1*v2 - y2*v1) - y0*(x1*v2 - x2*v1) + v0*(x1*y2 - x2*y1))/det;
+		}
+		return 1;
+	}
+}
+
+/* least squares refit on the inliers */
+static MU_VOID fitLeastSquares(const MU_32F *p, const MU_32F *q, const MU_8U *inlier, MU_32S n, MU_32S model, MU_64F *m)
+{
+	MU_32S i, cnt = 0;
+	MU_64F mpx = 0, mpy = 0, mqx = 0, mqy = 0;
+
+	for(i=0; i<n; i++)
+	{
+		if(!inlier[i])
+			continue;
+		mpx += p[2*i]; mpy += p[2*i+1];
+		mqx += q[2*i]; mqy += q[2*i+1];
+		cnt++;
+	}
+	if(cnt == 0)
+		return;
+	mpx /= cnt; mpy /= cnt; mqx /= cnt; mqy /= cnt;
+
+	if(model == MU_MOTION_TRANSLATION)
+	{
+		m[0] = 1; m[1] = 0; m[2] = mqx - mpx;
+		m[3] = 0; m[4] = 1; m[5] = mqy - mpy;
+	}
+	else if(model == MU_MOTION_SIMILARITY)
+	{
+		MU_64F sa = 0, sb = 0, sd = 0, a, b;
+		for(i=0; i<n; i++)
+		{
+			MU_64F px, py, qx, qy;
+			if(!inlier[i])
+				continue;
+			px = p[2*i] - mpx; py = p[2*i+1] - mpy;
+			qx = q[2*i] - mqx; qy = q[2*i+1] - mqy;
+			sa += px*qx + py*qy;
+			sb += px*qy - py*qx;
+			sd += px*px + py*py;
+		}
+		if(sd < 1e-9)
+			return;
+		a = sa/sd;
+		b = sb/sd;
+		m[0] = a; m[1] = -b; m[2] = mqx - (a*mpx - b*mpy);
+		m[3] = b; m[4] = a;  m[5] = mqy - (b*mpx + a*mpy);
+	}
+	else
+	{
+		/* centered normal equations, 2x2 per row */
+		MU_64F sxx = 0, sxy = 0, syy = 0, sxu = 0, syu = 0, sxv = 0, syv = 0, det;
+		for(i=0; i<n; i++)
+		{
+			MU_64F px, py, qx, qy;
+			if(!inlier[i])
+				continue;
+			px = p[2*i] - mpx; py = p[2*i+1] - mpy;
+			qx = q[2*i] - mqx; qy = q[2*i+1] - mqy;
+			sxx += px*px; sxy += px*py; syy += py*py;
+			sxu += px*qx; syu += py*qx;
+			sxv += px*qy; syv += py*qy;
+		}
+		det = sxx*syy - sxy*sxy;
+		if(fabs(det) < 1e-9)
+			return;
+		m[0] = (sxu*syy - syu*sxy)/det;
+		m[1] = (syu*sxx - sxu*sxy)/det;
+		m[3] = (sxv*syy - syv*sxy)/det;
+		m[4] = (syv*sxx - sxv*sxy)/det;
+		m[2] = mqx - m[0]*mpx - m[1]*mpy;
+		m[5] = mqy - m[3]*mpx - m[4]*mpy;
+	}
+}
+
+/*===========================================================================================*/
+/*   muCreateGlobalMotion / muReleaseGlobalMotion                                            */
+/*                                                                                           */
+/*   DESCRIPTION:                                                                            */
+/*   Global motion estimator of frames of the given size. The frames are averaged down by    */
+/*   scale (1, 2 or 4) and the previous downscaled frame is kept, so every frame is only     */
+/*   downscaled once.                                                                        */
+/*                                                                                           */
+/*   USAGE                                                                                   */
+/*   muSize_t size --> frame size                                                            */
+/*   MU_32S model --> MU_MOTION_TRANSLATION, MU_MOTION_SIMILARITY or MU_MOTION_AFFINE         */
+/*   MU_32S scale --> downscale factor                                                       */
+/*===========================================================================================*/
+muGlobalMotion_t* muCreateGlobalMotion(muSize_t size, MU_32S model, MU_32S scale)
+{
+	muGlobalMotion_t *gm;
+	muSize_t low;
+
+	if((scale != 1 && scale != 2 && scale != 4) || model < MU_MOTION_TRANSLATION || model > MU_MOTION_AFFINE)
+	{
+		return NULL;
+	}
+
+	low.width = size.width/scale;
+	low.height = size.height/scale;
+	if(low.width < 4*GM_BLOCK || low.height < 4*GM_BLOCK)
+	{
+		return NULL;
+	}
+
+	gm = (muGlobalMotion_t *)calloc(1, sizeof(muGlobalMotion_t));
+	if(gm == NULL)
+	{
+		return NULL;
+	}
+
+	gm->model = model;
+	gm->scale = scale;
+	gm->size = size;
+	gm->prev = muCreateImage(low, MU_IMG_DEPTH_8U, 1);
+	gm->cur = muCreateImage(low, MU_IMG_DEPTH_8U, 1);
+	gm->plan = muCreateFFTPlan(low.width, low.height);
+	if(gm->prev == NULL || gm->cur == NULL || gm->plan == NULL)
+	{
+		muReleaseGlobalMotion(&gm);
+		return NULL;
+	}
+
+	gm->m[0] = gm->m[4] = 1;
+
+	return gm;
+}
+
+muError_t muReleaseGlobalMotion(muGlobalMotion_t **gm)
+{
+	if(gm == NULL || *gm == NULL)
+	{
+		return MU_ERR_NULL_POINTER;
+	}
+
+	if((*gm)->prev)
+		muReleaseImage(&(*gm)->prev);
+	if((*gm)->cur)
+		muReleaseImage(&(*gm)->cur);
+	if((*gm)->plan)
+		muReleaseFFTPlan(&(*gm)->plan);
+	free(*gm);
+	*gm = NULL;
+
+	return MU_ERR_SUCCESS;
+}
+
+/*===========================================================================================*/
+/*   muEstimateGlobalMotion                                                                  */
+/*                                                                                           */
+/*   DESCRIPTION:                                                                            */
+/*   Estimates the transform m from the previous frame to frame (q = m p, 2x3 in full        */
+/*   resolution). muWarpAffine(frame, dst, m) aligns frame onto the previous frame, the     */
+/*   inverse (muInvertAffine) moves a model of the previous frame onto frame.                */
+/*                                                                                           */
+/*   NOTE                                                                                    */
+/*   1. phase correlation of the downscaled frames gives the dominant translation,           */
+/*   2. textured 8x8 blocks on a grid are matched by SAD (SSE2/NEON) around it, with sub     */
+/*      pixel refinement,                                                                    */
+/*   3. RANSAC on the block vectors and a least squares refit on the inliers.                */
+/*   The first frame returns the identity. gm->inliers/gm->blocks tell the fit quality.      */
+/*===========================================================================================*/
+muError_t muEstimateGlobalMotion(muGlobalMotion_t *gm, const muImage_t *frame, MU_64F *m)
+{
+	MU_32F p[2*GM_MAX_BLOCKS], q[2*GM_MAX_BLOCKS];
+	MU_8U inlier[GM_MAX_BLOCKS], best[GM_MAX_BLOCKS];
+	MU_32S W, H, step, gx, gy, nx, ny, n, i, j, it, radius, bestcnt;
+	MU_32S sx = 0, sy = 0;
+	MU_32U seed = 0x2545F491;
+	muPoint2D32f_t shift;
+	MU_64F response = 0, model[6], s, c;
+	muImage_t *tmp;
+	muError_t ret;
+
+	ret = muCheckDepth(2, frame, MU_IMG_DEPTH_8U);
+	if(ret)
+	{
+		return ret;
+	}
+
+	if(gm == NULL || m == NULL)
+	{
+		return MU_ERR_NULL_POINTER;
+	}
+
+	if(frame->channels != 1 || frame->width != gm->size.width || frame->height != gm->size.height)
+	{
+		return MU_ERR_NOT_SUPPORT;
+	}
+
+	downscaleFrame(frame, gm->cur, gm->scale);
+
+	gm->m[0] = 1; gm->m[1] = 0; gm->m[2] = 0;
+	gm->m[3] = 0; gm->m[4] = 1; gm->m[5] = 0;
+	gm->blocks = 0;
+	gm->inliers = 0;
+
+	if(!gm->initialized)
+	{
+		gm->initialized = 1;
+		goto swap;
+	}
+
+	W = gm->cur->width;
+	H = gm->cur->height;
+
+	/* dominant translation, narrows the block search */
+	if(muPhaseCorrelation(gm->plan, gm->prev, gm->cur, 1, &shift, &response) == MU_ERR_SUCCESS && response > 0.05)
+	{
+		sx = muRound(shift.x);
+		sy = muRound(shift.y);
+		radius = 3;
+	}
+	else
+	{
+		radius = 8;
+	}
+
+	/* block grid inside the margin */
+	step = 2*GM_BLOCK;
+	nx = (W - 2*(radius + 2) - GM_BLOCK)/step + 1;
+	ny = (H - 2*(radius + 2) - GM_BLOCK)/step + 1;
+	while(nx*ny > GM_MAX_BLOCKS)
+	{
+		step += GM_BLOCK/2;
+		nx = (W - 2*(radius + 2) - GM_BLOCK)/step + 1;
+		ny = (H - 2*(radius + 2) - GM_BLOCK)/step + 1;
+	}
+
+	n = 0;
+	for(gy=0; gy<ny; gy++)
+	{
+		for(gx=0; gx<nx; gx++)
+		{
+			MU_32S bx = radius + 2 + gx*step, by = radius + 2 + gy*step;
+			const MU_8U *a = gm->prev->imagedata + by*W + bx;
+			MU_32S texture = 0, dx, dy, bdx = 0, bdy = 0, bsad = 0x7fffffff;
+			MU_32S sad[3][3];
+			MU_32F fx = 0, fy = 0;
+
+			/* skip flat blocks, they match everywhere */
+			for(j=0; j<GM_BLOCK; j++)
+				for(i=0; i<GM_BLOCK-1; i++)
+					texture += abs(a[j*W+i+1] - a[j*W+i]) + abs(a[(j+1)*W+i] - a[j*W+i]);
+			if(texture < GM_BLOCK*GM_BLOCK*4)
+				continue;
+
+			for(dy=sy-radius; dy<=sy+radius; dy++)
+			{
+				if(by+dy < 0 || by+dy+GM_BLOCK > H)
+					continue;
+				for(dx=sx-radius; dx<=sx+radius; dx++)
+				{
+					MU_32S v;
+					if(bx+dx < 0 || bx+dx+GM_BLOCK > W)
+						continue;
+					v = blockSAD(a, gm->cur->imagedata + (by+dy)*W + bx+dx, W);
+					if(v < bsad)
+					{
+						bsad = v;
+						bdx = dx;
+						bdy = dy;
+					}
+				}
+			}
+			if(bsad == 0x7fffffff)
+				continue;
+
+			/* parabolic sub pixel refinement of the SAD surface */
+			for(j=-1; j<=1; j++)
+			{
+				for(i=-1; i<=1; i++)
+				{
+					MU_32S cx = bx+bdx+i, cy = by+bdy+j;
+					sad[j+1][i+1] = (cx < 0 || cy < 0 || cx+GM_BLOCK > W || cy+GM_BLOCK > H) ? -1 :
+						blockSAD(a, gm->cur->imagedata + cy*W + cx, W);
+				}
+			}
+			if(sad[1][0] >= 0 && sad[1][2] >= 0)
+			{
+				MU_32S d = sad[1][0] - 2*sad[1][1] + sad[1][2];
+				fx = d > 0 ? 0.5f*(sad[1][0] - sad[1][2])/d : 0;
+			}
+			if(sad[0][1] >= 0 && sad[2][1] >= 0)
+			{
+				MU_32S d = sad[0][1] - 2*sad[1][1] + sad[2][1];
+				fy = d > 0 ? 0.5f*(sad[0][1] - sad[2][1])/d : 0;
+			}
+
+			p[2*n] = bx + GM_BLOCK*0.5f;
+			p[2*n+1] = by + GM_BLOCK*0.5f;
+			q[2*n] = p[2*n] + bdx + fx;
+			q[2*n+1] = p[2*n+1] + bdy + fy;
+			n++;
+		}
+	}
+
+	gm->blocks = n;
+	j = gm->model == MU_MOTION_TRANSLATION ? 1 : (gm->model == MU_MOTION_SIMILARITY ? 2 : 3);
+	if(n < j)
+		goto swap;
+
+	/* RANSAC */
+	bestcnt = 0;
+	memset(best, 0, sizeof(best));
+	for(it=0; it<GM_RANSAC_ITER; it++)
+	{
+		MU_32S idx[3], k, cnt = 0;
+
+		for(k=0; k<j; k++)
+		{
+			MU_32S r;
+			do
+			{
+				seed ^= seed << 13;
+				seed ^= seed >> 17;
+				seed ^= seed << 5;
+				r = (MU_32S)(seed % (MU_32U)n);
+			}while((k > 0 && r == idx[0]) || (k > 1 && r == idx[1]));
+			idx[k] = r;
+		}
+
+		if(!fitMinimal(p, q, idx, gm->model, model))
+			continue;
+
+		for(k=0; k<n; k++)
+		{
+			MU_64F ex = model[0]*p[2*k] + model[1]*p[2*k+1] + model[2] - q[2*k];
+			MU_64F ey = model[3]*p[2*k] + model[4]*p[2*k+1] + model[5] - q[2*k+1];
+			inlier[k] = ex*ex + ey*ey < GM_INLIER_TH*GM_INLIER_TH;
+			cnt += inlier[k];
+		}
+
+		if(cnt > bestcnt)
+		{
+			bestcnt = cnt;
+			memcpy(best, inlier, n);
+			if(cnt == n)
+				break;
+		}
+	}
+
+	if(bestcnt < j)
+		goto swap;
+
+	model[0] = 1; model[1] = 0; model[2] = 0;
+	model[3] = 0; model[4] = 1; model[5] = 0;
+	fitLeastSquares(p, q, best, n, gm->model, model);
+	gm->inliers = bestcnt;
+
+	/* back to full resolution: P = s*p + c, c = (s-1)/2 */
+	s = gm->scale;
+	c = (s - 1)*0.5;
+	gm->m[0] = model[0];
+	gm->m[1] = model[1];
+	gm->m[3] = model[3];
+	gm->m[4] = model[4];
+	gm->m[2] = s*model[2] + c - (model[0]*c + model[1]*c);
+	gm->m[5] = s*model[5] + c - (model[3]*c + model[4]*c);
+
+swap:
+	memcpy(m, gm->m, 6*sizeof(MU_64F));
+	tmp = gm->prev;
+	gm->prev = gm->cur;
+	gm->cur = tmp;
+
+	return MU_ERR_SUCCESS;
+}
@@ -68,57 +68,25 @@ typedef struct _Grayvalue
 
 muError_t muEqualization( const muImage_t* src, muImage_t* dst)
 {
-	MU_32S i, temp=0;
-	MU_32U *his;
-	MU_32U *cdfHis;
-	MU_32S cdfMin = 0x3FFFFFFFF;
-	MU_32S area;
+	MU_32U his[256];
+	MU_8U lut[256];
+	muError_t ret;
 
 	if(src->depth != MU_IMG_DEPTH_8U || dst->depth != MU_IMG_DEPTH_8U) 
 	{
 		return MU_ERR_NOT_SUPPORT; 
 	}
 
-	his = (MU_32U *)malloc(256*sizeof(MU_32U));
-	memset(his, 0, 256*sizeof(MU_32U));
-
-	cdfHis = (MU_32U *)malloc(256*sizeof(MU_32U));
-	memset(cdfHis, 0, 256*sizeof(MU_32U));
-
-	muHistogram(src, his);
-	//find CDF
-	for(i=0; i<256; i++)
+	ret = muHistogram(src, his);
+	if(ret)
 	{
-		if(his[i])
-		{
-			cdfHis[i] = temp+his[i];
-			temp = cdfHis[i];
-			if(cdfHis[i] < cdfMin)
-				cdfMin = cdfHis[i];
-		}
+		return ret;
 	}
-	area = src->width*src->height;
 
 	//round((cdf(v) - cdfMin)/(area-cdfMin) x 255)
-	for(i=0; i<256; i++)
-	{
-		if(cdfHis[i])
-		{
-			cdfHis[i] = muRound(((MU_64F)(((cdfHis[i]-cdfMin)/(MU_64F)(area-cdfMin)))*255.0));
-		}
-	}
-
-	for(i=0; i<area; i++)
-	{
-		dst->imagedata[i] = cdfHis[src->imagedata[i]];
-	}
+	muBuildEqualizationLUT(his, lut);
 
-	if(his)
-		free(his);
-	if(cdfHis)
-		free(cdfHis);
-
-	return MU_ERR_SUCCESS;
+	return muApplyLUT(src, dst, lut, 1);
 }
 
 /*===========================================================================================*/
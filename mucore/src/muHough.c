@@ -0,0 +1,713 @@
+/*
+% MIT License
+%
+% Copyright (c) 2016 OneCV
+%
+% Permission is hereby granted, free of charge, to any person obtaining a copy
+% of this software and associated documentation files (the "Software"), to deal
+% in the Software without restriction, including without limitation the rights
+% to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+% copies of the Software, and to permit persons to whom the Software is
+% furnished to do so, subject to the following conditions:
+%
+% The above copyright notice and this permission notice shall be included in all
+% copies or substantial portions of the Software.
+%
+% THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+% IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+% FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+% AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+% LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+% OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+% SOFTWARE.
+*/
+
+/* ------------------------------------------------------------------------- /
+ *
+ * Module: muHough.c
+ * Author: Joe Lin
+ *
+ * Description:
+ *    Hough line (standard, probabilistic) and gradient circle transform.
+ *    All transforms work on the sparse list of edge points.
+ *
+ -------------------------------------------------------------------------- */
+
+#include "muCore.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#define HOUGH_ANGLE_BLOCK 16    /* accumulator rows voted together, keeps them in L1/L2 */
+#define HOUGH_CENTER_BANDS 4    /* center accumulator bands per thread */
+#define HOUGH_SHIFT 16
+
+typedef struct _houghSortItem
+{
+	MU_32S votes;
+	MU_32S index;
+}houghSortItem_t;
+
+static int compareVotes(const void *a, const void *b)
+{
+	const houghSortItem_t *p = (const houghSortItem_t *)a, *q = (const houghSortItem_t *)b;
+
+	if(p->votes != q->votes)
+		return p->votes > q->votes ? -1 : 1;
+	return p->index - q->index;
+}
+
+/* non-zero pixels of the edge map, row major */
+static MU_32S collectEdgePoints(const muImage_t *edge, muPoint_t **points)
+{
+	MU_32S x, y, n = 0;
+	const MU_8U *in = edge->imagedata;
+	muPoint_t *pts;
+
+	for(y=0; y<edge->width*edge->height; y++)
+		n += in[y] != 0;
+
+	pts = (muPoint_t *)malloc((n > 0 ? n : 1)*sizeof(muPoint_t));
+	if(pts == NULL)
+		return -1;
+
+	n = 0;
+	for(y=0; y<edge->height; y++, in+=edge->width)
+	{
+		for(x=0; x<edge->width; x++)
+		{
+			if(in[x])
+			{
+				pts[n].x = x;
+				pts[n].y = y;
+				n++;
+			}
+		}
+	}
+
+	*points = pts;
+	return n;
+}
+
+/* tab[2n] = cos(n*theta)/rho, tab[2n+1] = sin(n*theta)/rho */
+static MU_32F* createTrigTable(MU_32S numangle, MU_64F rho, MU_64F theta)
+{
+	MU_32S n;
+	MU_32F *tab = (MU_32F *)malloc(2*numangle*sizeof(MU_32F));
+
+	if(tab == NULL)
+		return NULL;
+
+	for(n=0; n<numangle; n++)
+	{
+		tab[2*n] = (MU_32F)(cos(n*theta)/rho);
+		tab[2*n+1] = (MU_32F)(sin(n*theta)/rho);
+	}
+
+	return tab;
+}
+
+/*===========================================================================================*/
+/*   muHoughLines                                                                            */
+/*                                                                                           */
+/*   DESCRIPTION:                                                                            */
+/*   Standard Hough line transform, rho = x*cos(theta)+y*sin(theta).                         */
+/*                                                                                           */
+/*   NOTE                                                                                    */
+/*   The edge points are collected once, then voted by blocks of HOUGH_ANGLE_BLOCK angles so */
+/*   the touched accumulator rows stay in cache. Each angle block owns its accumulator rows, */
+/*   so the blocks are voted in parallel without merging. Lines are the local maxima above   */
+/*   threshold, sorted by votes.                                                             */
+/*                                                                                           */
+/*   USAGE                                                                                   */
+/*   muImage_t *edge --> edge map (8-bit, 1 channel, non-zero = edge), e.g. muCannyEdge      */
+/*   MU_64F rho, theta --> distance (pixel) and angle (radian) resolution                    */
+/*   MU_32S threshold --> minimal votes                                                      */
+/*   muHoughLine_t *lines, MU_32S maxlines --> output buffer                                 */
+/*   MU_32S *count --> number of lines found                                                 */
+/*===========================================================================================*/
+muError_t muHoughLines(const muImage_t *edge, MU_64F rho, MU_64F theta, MU_32S threshold,
+					   muHoughLine_t *lines, MU_32S maxlines, MU_32S *count)
+{
+	MU_32S numangle, numrho, offset, npts, nblock, total, i, n, r;
+	MU_32S *acc;
+	MU_32F *tab;
+	muPoint_t *pts = NULL;
+	houghSortItem_t *peaks;
+	muError_t ret;
+
+	ret = muCheckDepth(2, edge, MU_IMG_DEPTH_8U);
+	if(ret)
+	{
+		return ret;
+	}
+
+	if(lines == NULL || count == NULL)
+	{
+		return MU_ERR_NULL_POINTER;
+	}
+
+	if(edge->channels != 1)
+	{
+		return MU_ERR_NOT_SUPPORT;
+	}
+
+	if(rho <= 0 || theta <= 0 || maxlines <= 0)
+	{
+		return MU_ERR_INVALID_PARAMETER;
+	}
+
+	*count = 0;
+	numangle = muRound(MU_PI/theta);
+	numrho = muRound(((edge->width + edge->height)*2 + 1)/rho);
+	offset = (numrho - 1)/2;
+
+	acc = (MU_32S *)calloc(numangle*numrho, sizeof(MU_32S));
+	tab = createTrigTable(numangle, rho, theta);
+	npts = collectEdgePoints(edge, &pts);
+	if(acc == NULL || tab == NULL || npts < 0)
+	{
+		free(acc);
+		free(tab);
+		free(pts);
+		return MU_ERR_OUT_OF_MEMORY;
+	}
+
+	nblock = (numangle + HOUGH_ANGLE_BLOCK - 1)/HOUGH_ANGLE_BLOCK;
+
+#ifdef _OPENMP
+#pragma omp parallel for private(i, n, r) schedule(dynamic)
+#endif
+	for(total=0; total<nblock; total++)
+	{
+		MU_32S n0 = total*HOUGH_ANGLE_BLOCK;
+		MU_32S n1 = n0 + HOUGH_ANGLE_BLOCK < numangle ? n0 + HOUGH_ANGLE_BLOCK : numangle;
+
+		for(i=0; i<npts; i++)
+		{
+			MU_32F x = (MU_32F)pts[i].x, y = (MU_32F)pts[i].y;
+			for(n=n0; n<n1; n++)
+			{
+				r = muRound(x*tab[2*n] + y*tab[2*n+1]) + offset;
+				acc[n*numrho + r]++;
+			}
+		}
+	}
+
+	/* local maxima in the 4-neighbourhood */
+	peaks = (houghSortItem_t *)malloc(numangle*numrho*sizeof(houghSortItem_t));
+	if(peaks == NULL)
+	{
+		free(acc);
+		free(tab);
+		free(pts);
+		return MU_ERR_OUT_OF_MEMORY;
+	}
+
+	total = 0;
+	for(n=0; n<numangle; n++)
+	{
+		const MU_32S *a = acc + n*numrho;
+		for(r=0; r<numrho; r++)
+		{
+			MU_32S v = a[r];
+			if(v > threshold &&
+				(r == 0 || v > a[r-1]) && (r == numrho-1 || v >= a[r+1]) &&
+				(n == 0 || v > a[r-numrho]) && (n == numangle-1 || v >= a[r+numrho]))
+			{
+				peaks[total].votes = v;
+				peaks[total].index = n*numrho + r;
+				total++;
+			}
+		}
+	}
+
+	qsort(peaks, total, sizeof(houghSortItem_t), compareVotes);
+
+	total = total < maxlines ? total : maxlines;
+	for(i=0; i<total; i++)
+	{
+		n = peaks[i].index / numrho;
+		r = peaks[i].index - n*numrho;
+		lines[i].rho = (MU_32F)((r - offset)*rho);
+		lines[i].theta = (MU_32F)(n*theta);
+		lines[i].votes = peaks[i].votes;
+	}
+	*count = total;
+
+	free(peaks);
+	free(acc);
+	free(tab);
+	free(pts);
+
+	return MU_ERR_SUCCESS;
+}
+
+/*===========================================================================================*/
+/*   muHoughLinesP                                                                           */
+/*                                                                                           */
+/*   DESCRIPTION:                                                                            */
+/*   Progressive probabilistic Hough transform (Matas et al.). Edge points are voted in      */
+/*   random order, once a bin reaches threshold the corresponding segment is walked in the   */
+/*   edge map, its points are removed and unvoted, so most points are never voted at all.    */
+/*                                                                                           */
+/*   USAGE                                                                                   */
+/*   muImage_t *edge --> edge map (8-bit, 1 channel)                                         */
+/*   MU_64F rho, theta --> resolution                                                        */
+/*   MU_32S threshold --> minimal votes                                                      */
+/*   MU_32S minlength --> minimal segment length                                             */
+/*   MU_32S maxgap --> maximal gap between points on the same segment                        */
+/*   muLineSegment_t *segs, MU_32S maxsegs --> output buffer                                 */
+/*   MU_32S *count --> number of segments found                                              */
+/*===========================================================================================*/
+muError_t muHoughLinesP(const muImage_t *edge, MU_64F rho, MU_64F theta, MU_32S threshold,
+						MU_32S minlength, MU_32S maxgap, muLineSegment_t *segs, MU_32S maxsegs, MU_32S *count)
+{
+	MU_32S numangle, numrho, offset, npts, width, height, i, n, r, k;
+	MU_32S *acc;
+	MU_32F *tab;
+	MU_8U *mask;
+	MU_32U seed = 0x9E3779B9;
+	muPoint_t *pts = NULL;
+	muError_t ret;
+
+	ret = muCheckDepth(2, edge, MU_IMG_DEPTH_8U);
+	if(ret)
+	{
+		return ret;
+	}
+
+	if(segs == NULL || count == NULL)
+	{
+		return MU_ERR_NULL_POINTER;
+	}
+
+	if(edge->channels != 1)
+	{
+		return MU_ERR_NOT_SUPPORT;
+	}
+
+	if(rho <= 0 || theta <= 0 || maxsegs <= 0)
+	{
+		return MU_ERR_INVALID_PARAMETER;
+	}
+
+	*count = 0;
+	width = edge->width;
+	height = edge->height;
+	numangle = muRound(MU_PI/theta);
+	numrho = muRound(((width + height)*2 + 1)/rho);
+	offset = (numrho - 1)/2;
+
+	acc = (MU_32S *)calloc(numangle*numrho, sizeof(MU_32S));
+	tab = createTrigTable(numangle, rho, theta);
+	mask = (MU_8U *)malloc(width*height*sizeof(MU_8U));
+	npts = collectEdgePoints(edge, &pts);
+	if(acc == NULL || tab == NULL || mask == NULL || npts < 0)
+	{
+		free(acc);
+		free(tab);
+		free(mask);
+		free(pts);
+		return MU_ERR_OUT_OF_MEMORY;
+	}
+
+	/* 1 = edge point not voted yet, 2 = voted */
+	for(i=0; i<width*height; i++)
+		mask[i] = edge->imagedata[i] != 0;
+
+	for(; npts > 0; npts--)
+	{
+		MU_32S maxval = threshold - 1, maxn = 0;
+		MU_32S x0, y0, dx0, dy0, xflag, good, side;
+		MU_32F a, b;
+		muPoint_t pt, lineend[2];
+
+		/* pick a random remaining point (xorshift) */
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		k = (MU_32S)(seed % (MU_32U)npts);
+		pt = pts[k];
+		pts[k] = pts[npts-1];
+
+		if(mask[pt.y*width + pt.x] != 1)
+			continue;
+		mask[pt.y*width + pt.x] = 2;
+
+		for(n=0; n<numangle; n++)
+		{
+			MU_32S *a0 = acc + n*numrho;
+			r = muRound(pt.x*tab[2*n] + pt.y*tab[2*n+1]) + offset;
+			if(++a0[r] > maxval)
+			{
+				maxval = a0[r];
+				maxn = n;
+			}
+		}
+
+		if(maxval < threshold)
+			continue;
+
+		/* walk along the line direction (-sin, cos) with fixed point steps */
+		a = -tab[2*maxn+1]*(MU_32F)rho;
+		b = tab[2*maxn]*(MU_32F)rho;
+		x0 = pt.x;
+		y0 = pt.y;
+
+		if(fabs(a) > fabs(b))
+		{
+			xflag = 1;
+			dx0 = a > 0 ? 1 : -1;
+			dy0 = muRound(b*(1 << HOUGH_SHIFT)/fabs(a));
+			y0 = (y0 << HOUGH_SHIFT) + (1 << (HOUGH_SHIFT-1));
+		}
+		else
+		{
+			xflag = 0;
+			dy0 = b > 0 ? 1 : -1;
+			dx0 = muRound(a*(1 << HOUGH_SHIFT)/fabs(b));
+			x0 = (x0 << HOUGH_SHIFT) + (1 << (HOUGH_SHIFT-1));
+		}
+
+		for(side=0; side<2; side++)
+		{
+			MU_32S gap = 0, dx = side ? -dx0 : dx0, dy = side ? -dy0 : dy0;
+			MU_32S x = x0, y = y0;
+
+			lineend[side] = pt;
+			for(;; x += dx, y += dy)
+			{
+				MU_32S i1, j1;
+				if(xflag)
+				{
+					j1 = x;
+					i1 = y >> HOUGH_SHIFT;
+				}
+				else
+				{
+					j1 = x >> HOUGH_SHIFT;
+					i1 = y;
+				}
+
+				if(j1 < 0 || j1 >= width || i1 < 0 || i1 >= height)
+					break;
+
+				if(mask[i1*width + j1])
+				{
+					gap = 0;
+					lineend[side].x = j1;
+					lineend[side].y = i1;
+				}
+				else if(++gap > maxgap)
+					break;
+			}
+		}
+
+		good = abs(lineend[1].x - lineend[0].x) >= minlength ||
+			abs(lineend[1].y - lineend[0].y) >= minlength;
+
+		/* remove the segment points from the mask, unvote the voted ones */
+		for(side=0; side<2; side++)
+		{
+			MU_32S dx = side ? -dx0 : dx0, dy = side ? -dy0 : dy0;
+			MU_32S x = x0, y = y0;
+
+			for(;; x += dx, y += dy)
+			{
+				MU_32S i1, j1;
+				MU_8U *m;
+				if(xflag)
+				{
+					j1 = x;
+					i1 = y >> HOUGH_SHIFT;
+				}
+				else
+				{
+					j1 = x >> HOUGH_SHIFT;
+					i1 = y;
+				}
+
+				m = &mask[i1*width + j1];
+				if(*m)
+				{
+					if(good && *m == 2)
+					{
+						for(n=0; n<numangle; n++)
+						{
+							r = muRound(j1*tab[2*n] + i1*tab[2*n+1]) + offset;
+							acc[n*numrho + r]--;
+						}
+					}
+					*m = 0;
+				}
+
+				if(i1 == lineend[side].y && j1 == lineend[side].x)
+					break;
+			}
+		}
+
+		if(good)
+		{
+			segs[*count].start = lineend[0];
+			segs[*count].end = lineend[1];
+			if(++(*count) >= maxsegs)
+				break;
+		}
+	}
+
+	free(acc);
+	free(tab);
+	free(mask);
+	free(pts);
+
+	return MU_ERR_SUCCESS;
+}
+
+/*===========================================================================================*/
+/*   muHoughCircles                                                                          */
+/*                                                                                           */
+/*   DESCRIPTION:                                                                            */
+/*   Gradient Hough circle transform. Every edge point votes only along its gradient         */
+/*   direction (both signs) for radii in [minradius, maxradius], then the radius of each     */
+/*   center candidate is the most supported distance to the edge points.                     */
+/*                                                                                           */
+/*   NOTE                                                                                    */
+/*   The gradient is the 3x3 Sobel of src at the edge points only. The center accumulator is */
+/*   voted by bands of rows, every band clips the rays to its own rows, so the bands are     */
+/*   voted in parallel into one accumulator without merging.                                 */
+/*                                                                                           */
+/*   USAGE                                                                                   */
+/*   muImage_t *src --> gray image (8-bit, 1 channel)                                        */
+/*   muImage_t *edge --> edge map of src, e.g. muCannyEdge                                   */
+/*   MU_32S minradius, maxradius --> radius range                                            */
+/*   MU_32S mindist --> minimal distance between the centers                                 */
+/*   MU_32S threshold --> minimal center votes (3x3 sum of the accumulator)                  */
+/*   muCircle_t *circles, MU_32S maxcircles --> output buffer                                */
+/*   MU_32S *count --> number of circles found                                               */
+/*===========================================================================================*/
+muError_t muHoughCircles(const muImage_t *src, const muImage_t *edge, MU_32S minradius, MU_32S maxradius,
+						 MU_32S mindist, MU_32S threshold, muCircle_t *circles, MU_32S maxcircles, MU_32S *count)
+{
+	MU_32S width, height, npts, ncenter, nband, i, k, nthreads = 1;
+	MU_32S *acc, *sacc, *hist;
+	MU_32F *dir;
+	muPoint_t *pts = NULL;
+	houghSortItem_t *centers;
+	muError_t ret;
+
+	ret = muCheckDepth(4, src, MU_IMG_DEPTH_8U, edge, MU_IMG_DEPTH_8U);
+	if(ret)
+	{
+		return ret;
+	}
+
+	if(circles == NULL || count == NULL)
+	{
+		return MU_ERR_NULL_POINTER;
+	}
+
+	if(src->channels != 1 || edge->channels != 1 || src->width != edge->width || src->height != edge->height)
+	{
+		return MU_ERR_NOT_SUPPORT;
+	}
+
+	if(minradius < 0 || maxradius < minradius || maxradius <= 0 || maxcircles <= 0)
+	{
+		return MU_ERR_INVALID_PARAMETER;
+	}
+
+	*count = 0;
+	width = src->width;
+	height = src->height;
+
+#ifdef _OPENMP
+	nthreads = omp_get_max_threads();
+#endif
+
+	npts = collectEdgePoints(edge, &pts);
+	acc = (MU_32S *)calloc(width*height, sizeof(MU_32S));
+	dir = (MU_32F *)malloc(2*(npts > 0 ? npts : 1)*sizeof(MU_32F));
+	if(npts < 0 || acc == NULL || dir == NULL)
+	{
+		free(pts);
+		free(acc);
+		free(dir);
+		return MU_ERR_OUT_OF_MEMORY;
+	}
+
+	/* unit gradient at the edge points, points without gradient are dropped */
+	for(i=0, k=0; i<npts; i++)
+	{
+		MU_32S x = pts[i].x, y = pts[i].y, gx, gy;
+		const MU_8U *p = src->imagedata + y*width + x;
+		MU_32F mag;
+
+		if(x < 1 || y < 1 || x >= width-1 || y >= height-1)
+			continue;
+
+		gx = (p[-width+1] + 2*p[1] + p[width+1]) - (p[-width-1] + 2*p[-1] + p[width-1]);
+		gy = (p[width-1] + 2*p[width] + p[width+1]) - (p[-width-1] + 2*p[-width] + p[-width+1]);
+		if(gx == 0 && gy == 0)
+			continue;
+
+		mag = 1.f/(MU_32F)sqrt((MU_64F)(gx*gx + gy*gy));
+		pts[k] = pts[i];
+		dir[2*k] = gx*mag;
+		dir[2*k+1] = gy*mag;
+		k++;
+	}
+	npts = k;
+
+	/* the rays are monotone in x and y and start inside the image or leave it, so the votes
+	   of a ray are a prefix of its steps and every band clips that prefix to its rows */
+	nband = nthreads*HOUGH_CENTER_BANDS < height ? nthreads*HOUGH_CENTER_BANDS : height;
+#ifdef _OPENMP
+#pragma omp parallel for private(i) schedule(dynamic)
+#endif
+	for(k=0; k<nband; k++)
+	{
+		MU_32S y0 = (MU_32S)((MU_64S)height*k/nband), y1 = (MU_32S)((MU_64S)height*(k+1)/nband);
+		MU_32S lo = y0 << HOUGH_SHIFT, hi = (y1 << HOUGH_SHIFT) - 1;
+
+		for(i=0; i<npts; i++)
+		{
+			MU_32S sign, r;
+			for(sign=-1; sign<=1; sign+=2)
+			{
+				/* fixed point walk along the gradient */
+				MU_32S sx = muRound(sign*dir[2*i]*(1 << HOUGH_SHIFT));
+				MU_32S sy = muRound(sign*dir[2*i+1]*(1 << HOUGH_SHIFT));
+				MU_32S cx = (pts[i].x << HOUGH_SHIFT) + (1 << (HOUGH_SHIFT-1)) + sx*minradius;
+				MU_32S cy = (pts[i].y << HOUGH_SHIFT) + (1 << (HOUGH_SHIFT-1)) + sy*minradius;
+				MU_32S skip = 0;
+
+				/* first step inside the band */
+				if(sy > 0 && cy < lo)
+					skip = (lo - cy + sy - 1)/sy;
+				else if(sy < 0 && cy > hi)
+					skip = (cy - hi - sy - 1)/(-sy);
+				else if(sy == 0 && (cy < lo || cy > hi))
+					continue;
+
+				if(skip > maxradius - minradius)
+					continue;
+
+				cx += sx*skip;
+				cy += sy*skip;
+				for(r=minradius+skip; r<=maxradius && cy>=lo && cy<=hi; r++, cx+=sx, cy+=sy)
+				{
+					MU_32S x = cx >> HOUGH_SHIFT, y = cy >> HOUGH_SHIFT;
+					if((MU_32U)x >= (MU_32U)width || (MU_32U)y >= (MU_32U)height)
+						break;
+					acc[y*width + x]++;
+				}
+			}
+		}
+	}
+
+	centers = (houghSortItem_t *)malloc(width*height*sizeof(houghSortItem_t));
+	hist = (MU_32S *)malloc((maxradius+2)*sizeof(MU_32S));
+	sacc = (MU_32S *)calloc(width*height, sizeof(MU_32S));
+	if(centers == NULL || hist == NULL || sacc == NULL)
+	{
+		free(centers);
+		free(hist);
+		free(sacc);
+		free(pts);
+		free(acc);
+		free(dir);
+		return MU_ERR_OUT_OF_MEMORY;
+	}
+
+	/* the gradient direction of a 3x3 Sobel is a few degrees off, so the votes of one
+	   center spread over its neighbours: the center score is the 3x3 sum */
+#ifdef _OPENMP
+#pragma omp parallel for private(k) schedule(static)
+#endif
+	for(i=1; i<height-1; i++)
+	{
+		const MU_32S *a = acc + i*width;
+		MU_32S *b = sacc + i*width;
+		for(k=1; k<width-1; k++)
+		{
+			b[k] = a[k-width-1] + a[k-width] + a[k-width+1] +
+				a[k-1] + a[k] + a[k+1] +
+				a[k+width-1] + a[k+width] + a[k+width+1];
+		}
+	}
+
+	/* center candidates: local maxima above threshold */
+	ncenter = 0;
+	for(i=1; i<height-1; i++)
+	{
+		const MU_32S *a = sacc + i*width;
+		for(k=1; k<width-1; k++)
+		{
+			MU_32S v = a[k];
+			if(v > threshold && v > a[k-1] && v >= a[k+1] && v > a[k-width] && v >= a[k+width])
+			{
+				centers[ncenter].votes = v;
+				centers[ncenter].index = i*width + k;
+				ncenter++;
+			}
+		}
+	}
+
+	qsort(centers, ncenter, sizeof(houghSortItem_t), compareVotes);
+
+	for(i=0; i<ncenter && *count<maxcircles; i++)
+	{
+		MU_32S cx = centers[i].index % width, cy = centers[i].index / width;
+		MU_32S j, best = 0, bestr = 0;
+		MU_32S rmin2 = minradius*minradius, rmax2 = maxradius*maxradius;
+
+		for(j=0; j<*count; j++)
+		{
+			MU_32F dx = circles[j].x - cx, dy = circles[j].y - cy;
+			if(dx*dx + dy*dy < (MU_32F)mindist*mindist)
+				break;
+		}
+		if(j < *count)
+			continue;
+
+		/* radius histogram of the edge points around the center */
+		memset(hist, 0, (maxradius+2)*sizeof(MU_32S));
+		for(j=0; j<npts; j++)
+		{
+			MU_32S dx = pts[j].x - cx, dy = pts[j].y - cy, d2 = dx*dx + dy*dy;
+			if(d2 >= rmin2 && d2 <= rmax2)
+				hist[muRound(sqrt((MU_64F)d2))]++;
+		}
+
+		for(j=minradius; j<=maxradius; j++)
+		{
+			/* the support of a radius counts its neighbour bins as well */
+			MU_32S s = hist[j] + (j > 0 ? hist[j-1] : 0) + hist[j+1];
+			if(s > best)
+			{
+				best = s;
+				bestr = j;
+			}
+		}
+
+		if(best == 0)
+			continue;
+
+		circles[*count].x = (MU_32F)cx;
+		circles[*count].y = (MU_32F)cy;
+		circles[*count].radius = (MU_32F)bestr;
+		circles[*count].votes = centers[i].votes;
+		(*count)++;
+	}
+
+	free(centers);
+	free(hist);
+	free(sacc);
+	free(pts);
+	free(acc);
+	free(dir);
+
+	return MU_ERR_SUCCESS;
+}
@@ -333,6 +333,116 @@ muError_t muBilinearScale(const muImage_t *in, muImage_t *out)
 }
 
 
+/*===========================================================================================*/
+/*   muWarpAffine                                                                            */
+/*                                                                                           */
+/*   DESCRIPTION:                                                                            */
+/*   dst(x,y) = src(m0*x + m1*y + m2, m3*x + m4*y + m5), bilinear, the border is replicated. */
+/*   m is the inverse mapping (dst -> src), e.g. the muEstimateGlobalMotion result warps    */
+/*   the current frame back onto the previous one.                                           */
+/*                                                                                           */
+/*   NOTE                                                                                    */
+/*   Source coordinates are stepped along the row in 16.16 fixed point, the bilinear weights */
+/*   are 8 bits. Only 8-bit 1 channel images are supported, src must not be dst.             */
+/*                                                                                           */
+/*   USAGE                                                                                   */
+/*   muImage_t *src --> input image                                                          */
+/*   muImage_t *dst --> output image                                                         */
+/*   MU_64F *m --> 2x3 matrix                                                                */
+/*===========================================================================================*/
+muError_t muWarpAffine(const muImage_t *src, muImage_t *dst, const MU_64F *m)
+{
+	MU_32S x, y, sw, sh, maxX, maxY;
+	MU_32S X, Y, dX, dY;
+	const MU_8U *in;
+	MU_8U *out;
+	muError_t ret;
+
+	ret = muCheckDepth(4, src, MU_IMG_DEPTH_8U, dst, MU_IMG_DEPTH_8U);
+	if(ret)
+	{
+		return ret;
+	}
+
+	if(m == NULL)
+	{
+		return MU_ERR_NULL_POINTER;
+	}
+
+	if(src->channels != 1 || dst->channels != 1 || src == dst)
+	{
+		return MU_ERR_NOT_SUPPORT;
+	}
+
+	sw = src->width;
+	sh = src->height;
+	maxX = (sw-1) << 16;
+	maxY = (sh-1) << 16;
+	in = src->imagedata;
+	dX = muRound(m[0]*65536);
+	dY = muRound(m[3]*65536);
+
+	for(y=0; y<dst->height; y++)
+	{
+		out = dst->imagedata + y*dst->width;
+		X = muRound((m[1]*y + m[2])*65536);
+		Y = muRound((m[4]*y + m[5])*65536);
+
+		for(x=0; x<dst->width; x++, X+=dX, Y+=dY)
+		{
+			MU_32S cx = X < 0 ? 0 : (X > maxX ? maxX : X);
+			MU_32S cy = Y < 0 ? 0 : (Y > maxY ? maxY : Y);
+			MU_32S x0 = cx >> 16, y0 = cy >> 16;
+			MU_32S ax = (cx >> 8) & 255, ay = (cy >> 8) & 255;
+			const MU_8U *p = in + y0*sw + x0;
+			MU_32S nx = x0 < sw-1 ? 1 : 0, ny = y0 < sh-1 ? sw : 0;
+			MU_32S top = p[0]*(256-ax) + p[nx]*ax;
+			MU_32S bottom = p[ny]*(256-ax) + p[ny+nx]*ax;
+
+			out[x] = (MU_8U)((top*(256-ay) + bottom*ay + 32768) >> 16);
+		}
+	}
+
+	return MU_ERR_SUCCESS;
+}
+
+/*===========================================================================================*/
+/*   muInvertAffine                                                                          */
+/*                                                                                           */
+/*   DESCRIPTION:                                                                            */
+/*   inv = m^-1 of the 2x3 affine matrix.                                                    */
+/*===========================================================================================*/
+muError_t muInvertAffine(const MU_64F *m, MU_64F *inv)
+{
+	MU_64F det, a, b, c, d;
+
+	if(m == NULL || inv == NULL)
+	{
+		return MU_ERR_NULL_POINTER;
+	}
+
+	det = m[0]*m[4] - m[1]*m[3];
+	if(fabs(det) < 1e-12)
+	{
+		return MU_ERR_INVALID_PARAMETER;
+	}
+
+	a = m[4]/det;
+	b = -m[1]/det;
+	c = -m[3]/det;
+	d = m[0]/det;
+
+	inv[2] = -(a*m[2] + b*m[5]);
+	inv[5] = -(c*m[2] + d*m[5]);
+	inv[0] = a;
+	inv[1] = b;
+	inv[3] = c;
+	inv[4] = d;
+
+	return MU_ERR_SUCCESS;
+}
+
+
 /*===========================================================================================*/
 /*   muImageRotate                                                                           */
 /*                                                                                           */
@@ -0,0 +1,345 @@
+/*
+% MIT License
+%
+% Copyright (c) 2016 OneCV
+%
+% Permission is hereby granted, free of charge, to any person obtaining a copy
+% of this software and associated documentation files (the "Software"), to deal
+% in the Software without restriction, including without limitation the rights
+% to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+% copies of the Software, and to permit persons to whom the Software is
+% furnished to do so, subject to the following conditions:
+%
+% The above copyright notice and this permission notice shall be included in all
+% copies or substantial portions of the Software.
+%
+% THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+% IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+% FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+% AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+% LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+% OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+% SOFTWARE.
+*/
+
+/* ------------------------------------------------------------------------- /
+ *
+ * Module: muLut.c
+ * Author: Joe Lin
+ *
+ * Description:
+ *    8-bit lookup table apply engine and the LUT builders (stretch, gamma,
+ *    equalization, threshold) that reduce point operations to one pass.
+ *
+ -------------------------------------------------------------------------- */
+
+#include "muCore.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define MU_LUT_NEON 1
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#define MU_LUT_SSSE3 1
+#endif
+
+
+#if defined(MU_LUT_NEON) && defined(__aarch64__)
+/* 256 entries = 4 x 64-byte tables, tbx keeps the lanes which are out of range */
+static MU_32S lutApplyVector(const MU_8U *in, MU_8U *out, MU_32S length, const MU_8U *lut)
+{
+	MU_32S i;
+	uint8x16x4_t t0, t1, t2, t3;
+	uint8x16_t k64 = vdupq_n_u8(64);
+
+	for(i=0; i<4; i++)
+	{
+		t0.val[i] = vld1q_u8(lut+i*16);
+		t1.val[i] = vld1q_u8(lut+64+i*16);
+		t2.val[i] = vld1q_u8(lut+128+i*16);
+		t3.val[i] = vld1q_u8(lut+192+i*16);
+	}
+
+	for(i=0; i+16<=length; i+=16)
+	{
+		uint8x16_t idx = vld1q_u8(in+i);
+		uint8x16_t res = vqtbl4q_u8(t0, idx);
+		idx = vsubq_u8(idx, k64);
+		res = vqtbx4q_u8(res, t1, idx);
+		idx = vsubq_u8(idx, k64);
+		res = vqtbx4q_u8(res, t2, idx);
+		idx = vsubq_u8(idx, k64);
+		res = vqtbx4q_u8(res, t3, idx);
+		vst1q_u8(out+i, res);
+	}
+
+	return i;
+}
+#elif defined(MU_LUT_NEON)
+/* 256 entries = 8 x 32-byte tables, vtbx4 keeps the lanes which are out of range */
+static MU_32S lutApplyVector(const MU_8U *in, MU_8U *out, MU_32S length, const MU_8U *lut)
+{
+	MU_32S i, k;
+	uint8x8x4_t t[8];
+	uint8x8_t k32 = vdup_n_u8(32);
+
+	for(k=0; k<8; k++)
+	{
+		t[k].val[0] = vld1_u8(lut+k*32);
+		t[k].val[1] = vld1_u8(lut+k*32+8);
+		t[k].val[2] = vld1_u8(lut+k*32+16);
+		t[k].val[3] = vld1_u8(lut+k*32+24);
+	}
+
+	for(i=0; i+8<=length; i+=8)
+	{
+		uint8x8_t idx = vld1_u8(in+i);
+		uint8x8_t res = vtbl4_u8(t[0], idx);
+		for(k=1; k<8; k++)
+		{
+			idx = vsub_u8(idx, k32);
+			res = vtbx4_u8(res, t[k], idx);
+		}
+		vst1_u8(out+i, res);
+	}
+
+	return i;
+}
+#elif defined(MU_LUT_SSSE3)
+/* 256 entries = 16 x 16-byte tables. Lanes outside the current table get the
+   sign bit set by the saturating add, which makes pshufb write zero */
+static MU_32S lutApplyVector(const MU_8U *in, MU_8U *out, MU_32S length, const MU_8U *lut)
+{
+	MU_32S i, k;
+	__m128i t[16];
+	__m128i k16 = _mm_set1_epi8(16);
+	__m128i k70 = _mm_set1_epi8(0x70);
+
+	for(k=0; k<16; k++)
+	{
+		t[k] = _mm_loadu_si128((const __m128i *)(lut+k*16));
+	}
+
+	for(i=0; i+16<=length; i+=16)
+	{
+		__m128i idx = _mm_loadu_si128((const __m128i *)(in+i));
+		__m128i res = _mm_setzero_si128();
+		for(k=0; k<16; k++)
+		{
+			res = _mm_or_si128(res, _mm_shuffle_epi8(t[k], _mm_adds_epu8(idx, k70)));
+			idx = _mm_sub_epi8(idx, k16);
+		}
+		_mm_storeu_si128((__m128i *)(out+i), res);
+	}
+
+	return i;
+}
+#else
+static MU_32S lutApplyVector(const MU_8U *in, MU_8U *out, MU_32S length, const MU_8U *lut)
+{
+	MU_32S i;
+
+	for(i=0; i+4<=length; i+=4)
+	{
+		MU_8U a = lut[in[i]];
+		MU_8U b = lut[in[i+1]];
+		MU_8U c = lut[in[i+2]];
+		MU_8U d = lut[in[i+3]];
+		out[i] = a;
+		out[i+1] = b;
+		out[i+2] = c;
+		out[i+3] = d;
+	}
+
+	return i;
+}
+#endif
+
+
+/*===========================================================================================*/
+/*   muApplyLUT                                                                              */
+/*                                                                                           */
+/*   DESCRIPTION:                                                                            */
+/*   This routine maps every pixel through a 256-entry table: dst = lut[src].                */
+/*                                                                                           */
+/*   NOTE                                                                                    */
+/*   Only 8-bit images with 1 or 3 channels are supported. lutchannels = 1 applies the same  */
+/*   table to every channel (vectorized by pshufb/vtbl), lutchannels = 3 expects three       */
+/*   consecutive tables lut[c*256+v] for the interleaved channels. src may equal dst.        */
+/*                                                                                           */
+/*   USAGE                                                                                   */
+/*   muImage_t *src --> input image                                                          */
+/*   muImage_t *dst --> output image                                                         */
+/*   MU_8U *lut --> lookup table(s)                                                          */
+/*   MU_32S lutchannels --> number of tables (1 or src->channels)                            */
+/*===========================================================================================*/
+muError_t muApplyLUT(const muImage_t *src, muImage_t *dst, const MU_8U *lut, MU_32S lutchannels)
+{
+	MU_8U *in, *out;
+	MU_32S i, length;
+	muError_t ret;
+
+	ret = muCheckDepth(4, src, MU_IMG_DEPTH_8U, dst, MU_IMG_DEPTH_8U);
+	if(ret)
+	{
+		return ret;
+	}
+
+	if(lut == NULL)
+	{
+		return MU_ERR_NULL_POINTER;
+	}
+
+	if((src->channels != 1 && src->channels != 3) || src->channels != dst->channels ||
+		src->width != dst->width || src->height != dst->height)
+	{
+		return MU_ERR_NOT_SUPPORT;
+	}
+
+	if(lutchannels != 1 && lutchannels != src->channels)
+	{
+		return MU_ERR_INVALID_PARAMETER;
+	}
+
+	in = src->imagedata;
+	out = dst->imagedata;
+	length = src->width*src->height*src->channels;
+
+	if(lutchannels == 1)
+	{
+		i = lutApplyVector(in, out, length, lut);
+		for(; i<length; i++)
+		{
+			out[i] = lut[in[i]];
+		}
+	}
+	else
+	{
+		const MU_8U *lut0 = lut, *lut1 = lut+256, *lut2 = lut+512;
+		for(i=0; i<length; i+=3)
+		{
+			out[i] = lut0[in[i]];
+			out[i+1] = lut1[in[i+1]];
+			out[i+2] = lut2[in[i+2]];
+		}
+	}
+
+	return MU_ERR_SUCCESS;
+}
+
+/*===========================================================================================*/
+/*   muBuildStretchLUT                                                                       */
+/*                                                                                           */
+/*   DESCRIPTION:                                                                            */
+/*   lut[v] = (v-min)/(max-min)*maxvalue, clamped outside of [min, max].                     */
+/*   This is the table used by muContraststretching.                                        */
+/*===========================================================================================*/
+muError_t muBuildStretchLUT(MU_8U minvalue, MU_8U maxvalue, MU_8U stretchvalue, MU_8U *lut)
+{
+	MU_32S v;
+
+	if(lut == NULL)
+	{
+		return MU_ERR_NULL_POINTER;
+	}
+
+	for(v=0; v<256; v++)
+	{
+		if(v <= minvalue || maxvalue <= minvalue)
+			lut[v] = 0;
+		else if(v >= maxvalue)
+			lut[v] = stretchvalue;
+		else
+			lut[v] = (MU_8U)(((MU_32F)(v-minvalue)/(MU_32F)(maxvalue-minvalue))*stretchvalue);
+	}
+
+	return MU_ERR_SUCCESS;
+}
+
+/*===========================================================================================*/
+/*   muBuildGammaLUT                                                                         */
+/*                                                                                           */
+/*   DESCRIPTION:                                                                            */
+/*   lut[v] = round(255*(v/255)^gamma)                                                       */
+/*===========================================================================================*/
+muError_t muBuildGammaLUT(MU_64F gamma, MU_8U *lut)
+{
+	MU_32S v, g;
+
+	if(lut == NULL)
+	{
+		return MU_ERR_NULL_POINTER;
+	}
+
+	if(gamma <= 0)
+	{
+		return MU_ERR_INVALID_PARAMETER;
+	}
+
+	for(v=0; v<256; v++)
+	{
+		g = muRound(255.0*pow(v/255.0, gamma));
+		lut[v] = (MU_8U)(g > 255 ? 255 : g);
+	}
+
+	return MU_ERR_SUCCESS;
+}
+
+/*===========================================================================================*/
+/*   muBuildEqualizationLUT                                                                  */
+/*                                                                                           */
+/*   DESCRIPTION:                                                                            */
+/*   lut[v] = round((cdf(v) - cdfMin)/(area-cdfMin) x 255), from the muHistogram output.     */
+/*   This is the table used by muEqualization.                                              */
+/*===========================================================================================*/
+muError_t muBuildEqualizationLUT(const MU_32U *hist, MU_8U *lut)
+{
+	MU_32S i;
+	MU_32U cdf = 0, cdfMin = 0, area = 0;
+
+	if(hist == NULL || lut == NULL)
+	{
+		return MU_ERR_NULL_POINTER;
+	}
+
+	for(i=0; i<256; i++)
+	{
+		area += hist[i];
+		if(cdfMin == 0)
+			cdfMin = hist[i];
+	}
+
+	for(i=0; i<256; i++)
+	{
+		cdf += hist[i];
+		if(hist[i] && area > cdfMin)
+			lut[i] = (MU_8U)muRound(((cdf-cdfMin)/(MU_64F)(area-cdfMin))*255.0);
+		else
+			lut[i] = 0;
+	}
+
+	return MU_ERR_SUCCESS;
+}
+
+/*===========================================================================================*/
+/*   muBuildThresholdLUT                                                                     */
+/*                                                                                           */
+/*   DESCRIPTION:                                                                            */
+/*   lut[v] = 255 if th.min < v <= th.max, else 0. This is the table used by muThresholding. */
+/*===========================================================================================*/
+muError_t muBuildThresholdLUT(muDoubleThreshold_t th, MU_8U *lut)
+{
+	MU_32S v;
+
+	if(lut == NULL)
+	{
+		return MU_ERR_NULL_POINTER;
+	}
+
+	for(v=0; v<256; v++)
+	{
+		lut[v] = (v > th.min && v <= th.max) ? 255 : 0;
+	}
+
+	return MU_ERR_SUCCESS;
+}
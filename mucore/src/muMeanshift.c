@@ -0,0 +1,522 @@
+/*
+% MIT License
+%
+% Copyright (c) 2016 OneCV
+%
+% Permission is hereby granted, free of charge, to any person obtaining a copy
+% of this software and associated documentation files (the "Software"), to deal
+% in the Software without restriction, including without limitation the rights
+% to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+% copies of the Software, and to permit persons to whom the Software is
+% furnished to do so, subject to the following conditions:
+%
+% The above copyright notice and this permission notice shall be included in all
+% copies or substantial portions of the Software.
+%
+% THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+% IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+% FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+% AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+% LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+% OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+% SOFTWARE.
+*/
+
+/* ------------------------------------------------------------------------- /
+ *
+ * Module: muMeanshift.c
+ * Author: Joe Lin
+ *
+ * Description:
+ *    Hue histogram model, LUT back-projection restricted to a search window,
+ *    and the mean-shift / CamShift trackers with incremental window moments.
+ *
+ -------------------------------------------------------------------------- */
+
+#include "muCore.h"
+
+
+/* integer h (0~359), s (0~100), v (0~100) of one pixel, the muRGB2HSV ranges */
+static MU_VOID pixelHSV(MU_32S b, MU_32S g, MU_32S r, MU_32S *h, MU_32S *s, MU_32S *v)
+{
+	MU_32S max = r, min = r, d, hue;
+
+	if(g > max) max = g;
+	if(b > max) max = b;
+	if(g < min) min = g;
+	if(b < min) min = b;
+
+	d = max - min;
+	*v = (max*100 + 127)/255;
+	*s = max ? (d*100 + max/2)/max : 0;
+
+	if(d == 0)
+		hue = 0;
+	else if(max == r)
+		hue = (60*(g - b)*2 + d)/(2*d);
+	else if(max == g)
+		hue = (60*(b - r)*2 + d)/(2*d) + 120;
+	else
+		hue = (60*(r - g)*2 + d)/(2*d) + 240;
+
+	if(hue < 0)
+		hue += 360;
+	if(hue >= 360)
+		hue -= 360;
+	*h = hue;
+}
+
+static muRect_t clipRect(muRect_t r, MU_32S width, MU_32S height)
+{
+	MU_32S x1 = r.x + r.width, y1 = r.y + r.height;
+
+	if(r.x < 0) r.x = 0;
+	if(r.y < 0) r.y = 0;
+	if(x1 > width) x1 = width;
+	if(y1 > height) y1 = height;
+	r.width = x1 > r.x ? x1 - r.x : 0;
+	r.height = y1 > r.y ? y1 - r.y : 0;
+
+	return r;
+}
+
+/* m[0] += sum(w), m[1] += sum(w*x), m[2] += sum(w*y) over [x0,x1)x[y0,y1), sign = +1/-1 */
+static MU_VOID stripMoments(const muImage_t *prob, MU_32S x0, MU_32S y0, MU_32S x1, MU_32S y1, MU_32S sign, MU_64S *m)
+{
+	MU_32S x, y;
+	MU_64S s0 = 0, s1 = 0, s2 = 0;
+
+	for(y=y0; y<y1; y++)
+	{
+		const MU_8U *p = prob->imagedata + y*prob->width;
+		MU_32S r0 = 0;
+		MU_64S r1 = 0;
+		for(x=x0; x<x1; x++)
+		{
+			r0 += p[x];
+			r1 += p[x]*x;
+		}
+		s0 += r0;
+		s1 += r1;
+		s2 += (MU_64S)r0*y;
+	}
+
+	m[0] += sign*s0;
+	m[1] += sign*s1;
+	m[2] += sign*s2;
+}
+
+/*===========================================================================================*/
+/*   muHueHistogram                                                                          */
+/*                                                                                           */
+/*   DESCRIPTION:                                                                            */
+/*   Builds the hue model of the object inside rect: a hue histogram scaled to 0~255 and     */
+/*   the lookup tables used by muHueBackProject.                                             */
+/*                                                                                           */
+/*   NOTE                                                                                    */
+/*   src is a BGR 8-bit image, a muRGB2Hue output (16-bit, 1 channel) or a muRGB2HSV output  */
+/*   (16-bit, 3 channels). Pixels with saturation < smin or value < vmin have no reliable    */
+/*   hue and are not counted (not checked for the hue plane). For BGR input the table is     */
+/*   indexed by the 5:5:5 quantized color, so back-projection is one lookup per pixel.      */
+/*                                                                                           */
+/*   USAGE                                                                                   */
+/*   muImage_t *src --> input image                                                          */
+/*   muRect_t rect --> object                                                                */
+/*   MU_32S bins --> number of hue bins (1~360)                                              */
+/*   MU_32S smin, vmin --> minimal saturation and value (0~100)                              */
+/*   muHueModel_t *model --> output model                                                    */
+/*===========================================================================================*/
+muError_t muHueHistogram(const muImage_t *src, muRect_t rect, MU_32S bins, MU_32S smin, MU_32S vmin, muHueModel_t *model)
+{
+	MU_32S x, y, h, s, v, i;
+	MU_32U count[360];
+	MU_32U maxcount = 0;
+
+	if(src == NULL || src->imagedata == NULL || model == NULL)
+	{
+		return MU_ERR_NULL_POINTER;
+	}
+
+	if(!((src->depth == MU_IMG_DEPTH_8U && src->channels == 3) ||
+		(src->depth == MU_IMG_DEPTH_16U && (src->channels == 1 || src->channels == 3))))
+	{
+		return MU_ERR_NOT_SUPPORT;
+	}
+
+	if(bins < 1 || bins > 360)
+	{
+		return MU_ERR_INVALID_PARAMETER;
+	}
+
+	rect = clipRect(rect, src->width, src->height);
+	if(rect.width == 0 || rect.height == 0)
+	{
+		return MU_ERR_INVALID_PARAMETER;
+	}
+
+	model->bins = bins;
+	model->smin = smin;
+	model->vmin = vmin;
+	memset(count, 0, sizeof(count));
+
+	for(y=rect.y; y<rect.y+rect.height; y++)
+	{
+		for(x=rect.x; x<rect.x+rect.width; x++)
+		{
+			if(src->depth == MU_IMG_DEPTH_8U)
+			{
+				const MU_8U *p = src->imagedata + (y*src->width + x)*3;
+				pixelHSV(p[0], p[1], p[2], &h, &s, &v);
+			}
+			else if(src->channels == 3)
+			{
+				const MU_16U *p = (const MU_16U *)src->imagedata + (y*src->width + x)*3;
+				h = p[0] >= 360 ? 0 : p[0];
+				s = p[1];
+				v = p[2];
+			}
+			else
+			{
+				h = ((const MU_16U *)src->imagedata)[y*src->width + x];
+				h = h >= 360 ? 0 : h;
+				s = smin;
+				v = vmin;
+			}
+
+			if(s >= smin && v >= vmin)
+				count[h*bins/360]++;
+		}
+	}
+
+	for(i=0; i<bins; i++)
+	{
+		if(count[i] > maxcount)
+			maxcount = count[i];
+	}
+
+	for(i=0; i<bins; i++)
+	{
+		model->hist[i] = maxcount ? count[i]*255.f/maxcount : 0.f;
+	}
+
+	for(h=0; h<360; h++)
+	{
+		model->hue[h] = (MU_8U)(model->hist[h*bins/360] + 0.5f);
+	}
+
+	/* every 5:5:5 color cell is represented by its center */
+	for(i=0; i<32768; i++)
+	{
+		pixelHSV(((i >> 10) << 3) + 4, (((i >> 5) & 31) << 3) + 4, ((i & 31) << 3) + 4, &h, &s, &v);
+		model->rgb[i] = (s >= smin && v >= vmin) ? model->hue[h] : 0;
+	}
+
+	return MU_ERR_SUCCESS;
+}
+
+/*===========================================================================================*/
+/*   muHueBackProject                                                                        */
+/*                                                                                           */
+/*   DESCRIPTION:                                                                            */
+/*   prob(x,y) = model histogram of the hue at (x,y), only inside rect. The pixels outside   */
+/*   rect are not touched, so only the search window around the track has to be projected.  */
+/*                                                                                           */
+/*   USAGE                                                                                   */
+/*   muImage_t *src --> input image, same format as for muHueHistogram                       */
+/*   muHueModel_t *model --> hue model                                                       */
+/*   muRect_t rect --> search window                                                         */
+/*   muImage_t *prob --> 8-bit 1 channel probability image of the src size                  */
+/*===========================================================================================*/
+muError_t muHueBackProject(const muImage_t *src, const muHueModel_t *model, muRect_t rect, muImage_t *prob)
+{
+	MU_32S x, y;
+	muError_t ret;
+
+	ret = muCheckDepth(2, prob, MU_IMG_DEPTH_8U);
+	if(ret)
+	{
+		return ret;
+	}
+
+	if(src == NULL || src->imagedata == NULL || model == NULL)
+	{
+		return MU_ERR_NULL_POINTER;
+	}
+
+	if(prob->channels != 1 || prob->width != src->width || prob->height != src->height)
+	{
+		return MU_ERR_NOT_SUPPORT;
+	}
+
+	rect = clipRect(rect, src->width, src->height);
+
+	if(src->depth == MU_IMG_DEPTH_8U && src->channels == 3)
+	{
+		const MU_8U *lut = model->rgb;
+		for(y=rect.y; y<rect.y+rect.height; y++)
+		{
+			const MU_8U *in = src->imagedata + (y*src->width + rect.x)*3;
+			MU_8U *out = prob->imagedata + y*src->width + rect.x;
+			for(x=0; x<rect.width; x++, in+=3)
+			{
+				out[x] = lut[((in[0] >> 3) << 10) | ((in[1] >> 3) << 5) | (in[2] >> 3)];
+			}
+		}
+	}
+	else if(src->depth == MU_IMG_DEPTH_16U && src->channels == 1)
+	{
+		for(y=rect.y; y<rect.y+rect.height; y++)
+		{
+			const MU_16U *in = (const MU_16U *)src->imagedata + y*src->width + rect.x;
+			MU_8U *out = prob->imagedata + y*src->width + rect.x;
+			for(x=0; x<rect.width; x++)
+			{
+				out[x] = in[x] < 360 ? model->hue[in[x]] : model->hue[0];
+			}
+		}
+	}
+	else if(src->depth == MU_IMG_DEPTH_16U && src->channels == 3)
+	{
+		for(y=rect.y; y<rect.y+rect.height; y++)
+		{
+			const MU_16U *in = (const MU_16U *)src->imagedata + (y*src->width + rect.x)*3;
+			MU_8U *out = prob->imagedata + y*src->width + rect.x;
+			for(x=0; x<rect.width; x++, in+=3)
+			{
+				if(in[1] < model->smin || in[2] < model->vmin)
+					out[x] = 0;
+				else
+					out[x] = in[0] < 360 ? model->hue[in[0]] : model->hue[0];
+			}
+		}
+	}
+	else
+	{
+		return MU_ERR_NOT_SUPPORT;
+	}
+
+	return MU_ERR_SUCCESS;
+}
+
+/*===========================================================================================*/
+/*   muMeanShift                                                                             */
+/*                                                                                           */
+/*   DESCRIPTION:                                                                            */
+/*   Moves window to the centroid of prob until it stops, moves less than eps pixels or     */
+/*   maxiter is reached. The window stays inside search.                                     */
+/*                                                                                           */
+/*   NOTE                                                                                    */
+/*   The window moments are updated incrementally: a move only adds the strips entering the */
+/*   window and removes the strips leaving it. iterations may be NULL, it gets -1 when the  */
+/*   window holds no probability (target lost).                                              */
+/*                                                                                           */
+/*   USAGE                                                                                   */
+/*   muImage_t *prob --> back-projection, valid inside search                                */
+/*   muRect_t search --> search window (usually the last window plus a margin)               */
+/*   muRect_t *window --> in: last position, out: new position                               */
+/*   MU_32S maxiter --> maximal iterations                                                   */
+/*   MU_64F eps --> minimal move                                                             */
+/*===========================================================================================*/
+muError_t muMeanShift(const muImage_t *prob, muRect_t search, muRect_t *window, MU_32S maxiter, MU_64F eps, MU_32S *iterations)
+{
+	MU_64S m[3] = {0, 0, 0};
+	MU_32S it, x, y, w, h, dx, dy;
+	muError_t ret;
+
+	ret = muCheckDepth(2, prob, MU_IMG_DEPTH_8U);
+	if(ret)
+	{
+		return ret;
+	}
+
+	if(window == NULL)
+	{
+		return MU_ERR_NULL_POINTER;
+	}
+
+	search = clipRect(search, prob->width, prob->height);
+	w = window->width < search.width ? window->width : search.width;
+	h = window->height < search.height ? window->height : search.height;
+	if(w <= 0 || h <= 0 || maxiter < 1)
+	{
+		return MU_ERR_INVALID_PARAMETER;
+	}
+
+	x = window->x < search.x ? search.x : (window->x + w > search.x + search.width ? search.x + search.width - w : window->x);
+	y = window->y < search.y ? search.y : (window->y + h > search.y + search.height ? search.y + search.height - h : window->y);
+
+	stripMoments(prob, x, y, x+w, y+h, 1, m);
+
+	for(it=0; it<maxiter; it++)
+	{
+		MU_64F cx, cy;
+		MU_32S nx, ny;
+
+		if(m[0] == 0)
+		{
+			it = -1;
+			break;
+		}
+
+		cx = (MU_64F)m[1]/m[0];
+		cy = (MU_64F)m[2]/m[0];
+		nx = muRound(cx - (w - 1)*0.5);
+		ny = muRound(cy - (h - 1)*0.5);
+		if(nx < search.x) nx = search.x;
+		if(ny < search.y) ny = search.y;
+		if(nx + w > search.x + search.width) nx = search.x + search.width - w;
+		if(ny + h > search.y + search.height) ny = search.y + search.height - h;
+
+		dx = nx - x;
+		dy = ny - y;
+		if(dx == 0 && dy == 0)
+			break;
+
+		if(abs(dx) >= w || abs(dy) >= h)
+		{
+			m[0] = m[1] = m[2] = 0;
+			stripMoments(prob, nx, ny, nx+w, ny+h, 1, m);
+		}
+		else
+		{
+			/* horizontal move on the old rows, then vertical move on the new columns */
+			if(dx > 0)
+			{
+				stripMoments(prob, x, y, x+dx, y+h, -1, m);
+				stripMoments(prob, x+w, y, nx+w, y+h, 1, m);
+			}
+			else if(dx < 0)
+			{
+				stripMoments(prob, nx+w, y, x+w, y+h, -1, m);
+				stripMoments(prob, nx, y, x, y+h, 1, m);
+			}
+			if(dy > 0)
+			{
+				stripMoments(prob, nx, y, nx+w, y+dy, -1, m);
+				stripMoments(prob, nx, y+h, nx+w, ny+h, 1, m);
+			}
+			else if(dy < 0)
+			{
+				stripMoments(prob, nx, ny+h, nx+w, y+h, -1, m);
+				stripMoments(prob, nx, ny, nx+w, y, 1, m);
+			}
+		}
+
+		x = nx;
+		y = ny;
+		if(dx*dx + dy*dy < eps*eps)
+		{
+			it++;
+			break;
+		}
+	}
+
+	window->x = x;
+	window->y = y;
+	window->width = w;
+	window->height = h;
+	if(iterations)
+		*iterations = it;
+
+	return MU_ERR_SUCCESS;
+}
+
+/*===========================================================================================*/
+/*   muCamShift                                                                              */
+/*                                                                                           */
+/*   DESCRIPTION:                                                                            */
+/*   Mean-shift followed by the orientation and size of the target from the second order   */
+/*   moments. box is the oriented target, window is resized to the box bounding rect so the */
+/*   next search adapts to the scale of the target.                                          */
+/*                                                                                           */
+/*   NOTE                                                                                    */
+/*   Typical tracking loop of a frame:                                                       */
+/*     search = window grown by a margin,                                                    */
+/*     muHueBackProject(frame, model, search, prob),                                         */
+/*     muCamShift(prob, search, &window, 10, 1, &box).                                       */
+/*   MU_ERR_INVALID_PARAMETER is returned when the target is lost (no probability).          */
+/*===========================================================================================*/
+muError_t muCamShift(const muImage_t *prob, muRect_t search, muRect_t *window, MU_32S maxiter, MU_64F eps, muBox2D_t *box)
+{
+	MU_32S it, x, y;
+	MU_64F m00 = 0, m10 = 0, m01 = 0, m20 = 0, m11 = 0, m02 = 0;
+	MU_64F cx, cy, a, b, c, sq, theta, cs, sn, la, lb, bw, bh;
+	muError_t ret;
+
+	ret = muMeanShift(prob, search, window, maxiter, eps, &it);
+	if(ret)
+	{
+		return ret;
+	}
+
+	if(it < 0)
+	{
+		return MU_ERR_INVALID_PARAMETER;
+	}
+
+	/* second order moments relative to the window origin */
+	for(y=0; y<window->height; y++)
+	{
+		const MU_8U *p = prob->imagedata + (window->y + y)*prob->width + window->x;
+		MU_32S r0 = 0, r1 = 0;
+		MU_64S r2 = 0;
+		for(x=0; x<window->width; x++)
+		{
+			r0 += p[x];
+			r1 += p[x]*x;
+			r2 += (MU_64S)(p[x]*x)*x;
+		}
+		m00 += r0;
+		m10 += r1;
+		m01 += (MU_64F)r0*y;
+		m20 += (MU_64F)r2;
+		m11 += (MU_64F)r1*y;
+		m02 += (MU_64F)r0*y*y;
+	}
+
+	if(m00 <= 0)
+	{
+		return MU_ERR_INVALID_PARAMETER;
+	}
+
+	cx = m10/m00;
+	cy = m01/m00;
+	a = m20/m00 - cx*cx;
+	b = m11/m00 - cx*cy;
+	c = m02/m00 - cy*cy;
+
+	/* major axis direction and the variances along both axes */
+	sq = sqrt(4*b*b + (a - c)*(a - c));
+	theta = atan2(2*b, a - c + sq);
+	cs = cos(theta);
+	sn = sin(theta);
+	la = cs*cs*a + 2*cs*sn*b + sn*sn*c;
+	lb = sn*sn*a - 2*cs*sn*b + cs*cs*c;
+	la = 4*sqrt(la > 0 ? la : 0);
+	lb = 4*sqrt(lb > 0 ? lb : 0);
+
+	cx += window->x;
+	cy += window->y;
+
+	if(box)
+	{
+		box->center.x = (MU_32F)cx;
+		box->center.y = (MU_32F)cy;
+		box->size.width = (MU_32F)la;
+		box->size.height = (MU_32F)lb;
+		box->angle = (MU_32F)(theta*180.0/MU_PI);
+	}
+
+	/* bounding rect of the box for the next search */
+	bw = fabs(la*cs) + fabs(lb*sn);
+	bh = fabs(la*sn) + fabs(lb*cs);
+	if(bw < 2) bw = 2;
+	if(bh < 2) bh = 2;
+	window->x = muRound(cx - bw*0.5);
+	window->y = muRound(cy - bh*0.5);
+	window->width = muRound(bw);
+	window->height = muRound(bh);
+	*window = clipRect(*window, prob->width, prob->height);
+
+	return MU_ERR_SUCCESS;
+}
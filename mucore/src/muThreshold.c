@@ -34,6 +34,10 @@
  
 #include "muCore.h"
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 typedef struct _Link{
 
 		struct _Link *add;
@@ -334,9 +338,7 @@ muError_t muOtsuThresholding(const muImage_t * src, muImage_t * dst)
 
 muError_t muThresholding(const muImage_t *src, muImage_t *dst,  muDoubleThreshold_t th)
 {
-	MU_8U *in, *out;
-	MU_32S i;
-	MU_32S width, height;
+	MU_8U lut[256];
 	muError_t ret;
 
 	ret = muCheckDepth(4, src, MU_IMG_DEPTH_8U, dst, MU_IMG_DEPTH_8U);
@@ -350,26 +352,9 @@ muError_t muThresholding(const muImage_t *src, muImage_t *dst,  muDoubleThreshol
 		return MU_ERR_NOT_SUPPORT;
 	}
 
-	width = src->width;
-	height = src->height;
-	in = src->imagedata;
-	out = dst->imagedata;
-
-	i = width*height;
-
-	do
-	{
-		if((*in > th.min) && (*in <= th.max))
-			*out = 255;
-		else
-			*out = 0;
-
-		in++;
-		out++;
+	muBuildThresholdLUT(th, lut);
 
-	}while(--i);
-
-	return MU_ERR_SUCCESS;
+	return muApplyLUT(src, dst, lut, 1);
 }
 
 /* find iso data from input image */
@@ -550,3 +535,239 @@ muError_t muMeanThresholding(const muImage_t *src, muImage_t *dst, MU_8U offset)
 
 
 
+/* integral image with the muCalcIntegralImage layout: (width+1)*(height+1), first row/column = 0 */
+static MU_VOID calcAdaptiveIntegral(const muImage_t *src, MU_32S *sum, MU_64F *sqsum)
+{
+	MU_32S x, y;
+	MU_32S width = src->width, height = src->height;
+	MU_32S step = width+1;
+	MU_8U *in = src->imagedata;
+
+	memset(sum, 0, step*sizeof(MU_32S));
+	if(sqsum)
+		memset(sqsum, 0, step*sizeof(MU_64F));
+
+	for(y=0; y<height; y++, in+=width)
+	{
+		MU_32S s = 0;
+		MU_64F sq = 0;
+		MU_32S *srow = sum + (y+1)*step;
+
+		srow[0] = 0;
+		for(x=0; x<width; x++)
+		{
+			s += in[x];
+			srow[x+1] = srow[x+1-step] + s;
+		}
+
+		if(sqsum)
+		{
+			MU_64F *qrow = sqsum + (y+1)*step;
+			qrow[0] = 0;
+			for(x=0; x<width; x++)
+			{
+				sq += (MU_64F)in[x]*in[x];
+				qrow[x+1] = qrow[x+1-step] + sq;
+			}
+		}
+	}
+}
+
+/*===========================================================================================*/
+/*   muAdaptiveThresholding                                                                  */
+/*                                                                                           */
+/*   DESCRIPTION:                                                                            */
+/*   Local thresholding over a winsize*winsize window centered at each pixel.                */
+/*   MU_ADAPTIVE_BRADLEY: dst = 255 if src > mean*(1-k)             (k ~ 0.15)               */
+/*   MU_ADAPTIVE_SAUVOLA: dst = 255 if src > mean*(1+k*(std/128-1))  (k ~ 0.2 ~ 0.5)         */
+/*                                                                                           */
+/*   NOTE                                                                                    */
+/*   The window sums come from the integral image, so the cost is O(1) per pixel for any     */
+/*   window size. The windows are clipped at the border. An integral image which is already  */
+/*   calculated for detection (muIntegral_Light) can be passed by ii, the sqsum is only      */
+/*   needed by Sauvola. ii = NULL calculates it internally.                                  */
+/*   Rows are processed in parallel when OneMu is built with MU_WITH_OPENMP.                 */
+/*                                                                                           */
+/*   USAGE                                                                                   */
+/*   muImage_t *src --> input image (8-bit, 1 channel)                                       */
+/*   muImage_t *dst --> output image (8-bit, 1 channel)                                      */
+/*   muIntegralImg_t *ii --> integral image of src or NULL                                   */
+/*   MU_32S winsize --> window size (odd number >= 3)                                        */
+/*   MU_32S method --> MU_ADAPTIVE_BRADLEY or MU_ADAPTIVE_SAUVOLA                            */
+/*   MU_64F k --> sensitivity                                                                */
+/*===========================================================================================*/
+muError_t muAdaptiveThresholding(const muImage_t *src, muImage_t *dst, const muIntegralImg_t *ii,
+								 MU_32S winsize, MU_32S method, MU_64F k)
+{
+	MU_32S width, height, step, r;
+	MU_32S *sum = NULL;
+	MU_64F *sqsum = NULL;
+	MU_32F *invcols;
+	MU_32S *rowbuf;
+	MU_32S y, nthreads = 1;
+	muError_t ret;
+
+	ret = muCheckDepth(4, src, MU_IMG_DEPTH_8U, dst, MU_IMG_DEPTH_8U);
+	if(ret)
+	{
+		return ret;
+	}
+
+	if(src->channels != 1 || dst->channels != 1)
+	{
+		return MU_ERR_NOT_SUPPORT;
+	}
+
+	if(winsize < 3 || (method != MU_ADAPTIVE_BRADLEY && method != MU_ADAPTIVE_SAUVOLA))
+	{
+		return MU_ERR_INVALID_PARAMETER;
+	}
+
+	width = src->width;
+	height = src->height;
+	step = width+1;
+	r = winsize/2;
+
+	if(ii != NULL)
+	{
+		if(ii->imgSize.width != width || ii->imgSize.height != height || ii->origin.x || ii->origin.y || ii->sum == NULL ||
+			(method == MU_ADAPTIVE_SAUVOLA && ii->sqsum == NULL))
+		{
+			return MU_ERR_INVALID_PARAMETER;
+		}
+		sum = ii->sum;
+		sqsum = ii->sqsum;
+	}
+	else
+	{
+		sum = (MU_32S *)malloc(step*(height+1)*sizeof(MU_32S));
+		if(method == MU_ADAPTIVE_SAUVOLA)
+			sqsum = (MU_64F *)malloc(step*(height+1)*sizeof(MU_64F));
+		if(sum == NULL || (method == MU_ADAPTIVE_SAUVOLA && sqsum == NULL))
+		{
+			free(sum);
+			free(sqsum);
+			return MU_ERR_OUT_OF_MEMORY;
+		}
+		calcAdaptiveIntegral(src, sum, sqsum);
+	}
+
+#ifdef _OPENMP
+	nthreads = omp_get_max_threads();
+#endif
+
+	/* 1/(window width) of every column, the window is clipped at the border */
+	invcols = (MU_32F *)malloc(width*sizeof(MU_32F));
+	/* per-row window sums and thresholds of every thread */
+	rowbuf = (MU_32S *)malloc((size_t)nthreads*2*width*sizeof(MU_32S));
+	if(invcols == NULL || rowbuf == NULL)
+	{
+		free(invcols);
+		free(rowbuf);
+		if(ii == NULL)
+		{
+			free(sum);
+			free(sqsum);
+		}
+		return MU_ERR_OUT_OF_MEMORY;
+	}
+	for(y=0; y<width; y++)
+	{
+		MU_32S x0 = y-r < 0 ? 0 : y-r;
+		MU_32S x1 = y+r+1 > width ? width : y+r+1;
+		invcols[y] = 1.0f/(MU_32F)(x1-x0);
+	}
+
+#ifdef _OPENMP
+	#pragma omp parallel
+#endif
+	{
+		/* per-row window sums and thresholds, private to each thread */
+		MU_32S *rowsum = rowbuf;
+		MU_32F *rowth;
+
+#ifdef _OPENMP
+		rowsum += (size_t)omp_get_thread_num()*2*width;
+#endif
+		rowth = (MU_32F *)(rowsum + width);
+
+#ifdef _OPENMP
+		#pragma omp for schedule(static)
+#endif
+		for(y=0; y<height; y++)
+		{
+			MU_32S x, x0, x1, y0, y1, xa, xb;
+			MU_32F invrows;
+			const MU_32S *top, *bot;
+			const MU_8U *in = src->imagedata + y*width;
+			MU_8U *out = dst->imagedata + y*width;
+
+			y0 = y-r < 0 ? 0 : y-r;
+			y1 = y+r+1 > height ? height : y+r+1;
+			invrows = 1.0f/(MU_32F)(y1-y0);
+			top = sum + y0*step;
+			bot = sum + y1*step;
+
+			/* window sums, the unclipped columns [xa, xb) run in one contiguous loop */
+			xa = r < width ? r : width;
+			xb = width-r-1 > xa ? width-r-1 : xa;
+			for(x=0; x<xa; x++)
+			{
+				x1 = x+r+1 > width ? width : x+r+1;
+				rowsum[x] = bot[x1] - bot[0] - top[x1] + top[0];
+			}
+			for(x=xa; x<xb; x++)
+			{
+				rowsum[x] = bot[x+r+1] - bot[x-r] - top[x+r+1] + top[x-r];
+			}
+			for(x=xb; x<width; x++)
+			{
+				x0 = x-r < 0 ? 0 : x-r;
+				rowsum[x] = bot[width] - bot[x0] - top[width] + top[x0];
+			}
+
+			if(method == MU_ADAPTIVE_BRADLEY)
+			{
+				/* threshold = mean*(1-k) */
+				MU_32F kk = (MU_32F)(1.0-k)*invrows;
+				for(x=0; x<width; x++)
+				{
+					rowth[x] = (MU_32F)rowsum[x]*kk*invcols[x];
+				}
+			}
+			else
+			{
+				/* threshold = mean*(1+k*(std/R-1)), R = 128 */
+				const MU_64F *qtop = sqsum + y0*step, *qbot = sqsum + y1*step;
+				for(x=0; x<width; x++)
+				{
+					MU_64F inv, mean, var, sd;
+					x0 = x-r < 0 ? 0 : x-r;
+					x1 = x+r+1 > width ? width : x+r+1;
+					inv = (MU_64F)invcols[x]*invrows;
+					mean = rowsum[x]*inv;
+					var = (qbot[x1] - qbot[x0] - qtop[x1] + qtop[x0])*inv - mean*mean;
+					sd = var > 0 ? sqrt(var) : 0;
+					rowth[x] = (MU_32F)(mean*(1.0 + k*(sd/128.0 - 1.0)));
+				}
+			}
+
+			/* branch-free compare, vectorized by the compiler */
+			for(x=0; x<width; x++)
+			{
+				out[x] = (MU_8U)(-((MU_32F)in[x] > rowth[x]));
+			}
+		}
+	}
+
+	free(invcols);
+	free(rowbuf);
+
+	if(ii == NULL)
+	{
+		free(sum);
+		free(sqsum);
+	}
+
+	return MU_ERR_SUCCESS;
+}
@@ -0,0 +1,358 @@
+/*
+% MIT License
+%
+% Copyright (c) 2016 OneCV
+%
+% Permission is hereby granted, free of charge, to any person obtaining a copy
+% of this software and associated documentation files (the "Software"), to deal
+% in the Software without restriction, including without limitation the rights
+% to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+% copies of the Software, and to permit persons to whom the Software is
+% furnished to do so, subject to the following conditions:
+%
+% The above copyright notice and this permission notice shall be included in all
+% copies or substantial portions of the Software.
+%
+% THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+% IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+% FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+% AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+% LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+% OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+% SOFTWARE.
+*/
+
+/* ------------------------------------------------------------------------- /
+ *
+ * Module: muTilechange.c
+ * Author: Joe Lin
+ *
+ * Description:
+ *    Tile change map of consecutive frames (SAD per tile against a
+ *    reference) and the per tile result cache invalidated by it.
+ *
+ -------------------------------------------------------------------------- */
+
+#include "muCore.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define MU_TC_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define MU_TC_SSE2 1
+#endif
+
+
+/* sum of absolute differences of one row segment */
+static MU_32U rowSAD(const MU_8U *a, const MU_8U *b, MU_32S n)
+{
+	MU_32S x = 0;
+	MU_32U s = 0;
+
+#if defined(MU_TC_SSE2)
+	__m128i acc = _mm_setzero_si128();
+	for(; x+16<=n; x+=16)
+	{
+		acc = _mm_add_epi64(acc, _mm_sad_epu8(_mm_loadu_si128((const __m128i *)(a+x)), _mm_loadu_si128((const __m128i *)(b+x))));
+	}
+	s = _mm_cvtsi128_si32(acc) + _mm_cvtsi128_si32(_mm_srli_si128(acc, 8));
+#elif defined(MU_TC_NEON)
+	uint16x8_t acc = vdupq_n_u16(0);
+	uint64x2_t s64;
+	/* 128 iterations add at most 2x255 per lane each, the rest goes to the scalar loop */
+	for(; x+16<=n && x<2048; x+=16)
+	{
+		acc = vabal_u8(acc, vget_low_u8(vld1q_u8(a+x)), vget_low_u8(vld1q_u8(b+x)));
+		acc = vabal_u8(acc, vget_high_u8(vld1q_u8(a+x)), vget_high_u8(vld1q_u8(b+x)));
+	}
+	s64 = vpaddlq_u32(vpaddlq_u16(acc));
+	s = (MU_32U)(vgetq_lane_u64(s64, 0) + vgetq_lane_u64(s64, 1));
+#endif
+
+	for(; x<n; x++)
+	{
+		s += abs(a[x] - b[x]);
+	}
+
+	return s;
+}
+
+/*===========================================================================================*/
+/*   muCreateTileChange / muReleaseTileChange                                                */
+/*                                                                                           */
+/*   DESCRIPTION:                                                                            */
+/*   Tile change map of frames of the given size, tile x tile pixels per tile (the last      */
+/*   row/column of tiles may be smaller).                                                    */
+/*                                                                                           */
+/*   USAGE                                                                                   */
+/*   muSize_t size --> frame size                                                            */
+/*   MU_32S tile --> tile size                                                               */
+/*   MU_32S threshold --> a tile is changed when its mean absolute difference is larger      */
+/*   MU_32S cachesize --> bytes of the cached result of a tile, 0 = no cache                 */
+/*===========================================================================================*/
+muTileChange_t* muCreateTileChange(muSize_t size, MU_32S tile, MU_32S threshold, MU_32S cachesize)
+{
+	muTileChange_t *tc;
+	MU_32S n;
+
+	if(size.width <= 0 || size.height <= 0 || tile < 4 || threshold < 0 || cachesize < 0)
+	{
+		return NULL;
+	}
+
+	tc = (muTileChange_t *)calloc(1, sizeof(muTileChange_t));
+	if(tc == NULL)
+	{
+		return NULL;
+	}
+
+	tc->size = size;
+	tc->tile = tile;
+	tc->threshold = threshold;
+	tc->cols = (size.width + tile - 1)/tile;
+	tc->rows = (size.height + tile - 1)/tile;
+	tc->cachesize = cachesize;
+	n = tc->cols*tc->rows;
+
+	tc->changed = (MU_8U *)malloc(n);
+	tc->ref = muCreateImage(size, MU_IMG_DEPTH_8U, 1);
+	if(cachesize)
+	{
+		tc->cache = (MU_8U *)malloc(n*cachesize);
+		tc->cachevalid = (MU_8U *)calloc(n, 1);
+	}
+	if(tc->changed == NULL || tc->ref == NULL || (cachesize && (tc->cache == NULL || tc->cachevalid == NULL)))
+	{
+		muReleaseTileChange(&tc);
+		return NULL;
+	}
+
+	memset(tc->changed, 1, n);
+	tc->nchanged = n;
+
+	return tc;
+}
+
+muError_t muReleaseTileChange(muTileChange_t **tc)
+{
+	if(tc == NULL || *tc == NULL)
+	{
+		return MU_ERR_NULL_POINTER;
+	}
+
+	if((*tc)->ref)
+		muReleaseImage(&(*tc)->ref);
+	free((*tc)->changed);
+	free((*tc)->cache);
+	free((*tc)->cachevalid);
+	free(*tc);
+	*tc = NULL;
+
+	return MU_ERR_SUCCESS;
+}
+
+/*===========================================================================================*/
+/*   muUpdateTileChange                                                                      */
+/*                                                                                           */
+/*   DESCRIPTION:                                                                            */
+/*   Compares every tile of frame with the reference (SAD by SSE2/NEON) and fills changed,   */
+/*   nchanged and bound. The cached results of changed tiles are invalidated.                */
+/*                                                                                           */
+/*   NOTE                                                                                    */
+/*   The reference of a tile is only replaced when the tile changes, so a slow drift is      */
+/*   accumulated until it passes the threshold instead of being lost frame by frame. The     */
+/*   first frame marks every tile as changed.                                                */
+/*===========================================================================================*/
+muError_t muUpdateTileChange(muTileChange_t *tc, const muImage_t *frame)
+{
+	MU_32S i, n, width, minx, miny, maxx, maxy;
+	muError_t ret;
+
+	ret = muCheckDepth(2, frame, MU_IMG_DEPTH_8U);
+	if(ret)
+	{
+		return ret;
+	}
+
+	if(tc == NULL)
+	{
+		return MU_ERR_NULL_POINTER;
+	}
+
+	if(frame->channels != 1 || frame->width != tc->size.width || frame->height != tc->size.height)
+	{
+		return MU_ERR_NOT_SUPPORT;
+	}
+
+	width = tc->size.width;
+	n = tc->cols*tc->rows;
+
+	if(tc->frameid == 0)
+	{
+		memcpy(tc->ref->imagedata, frame->imagedata, width*tc->size.height);
+		memset(tc->changed, 1, n);
+	}
+	else
+	{
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+		for(i=0; i<n; i++)
+		{
+			MU_32S tx = (i % tc->cols)*tc->tile, ty = (i / tc->cols)*tc->tile;
+			MU_32S tw = tx + tc->tile > width ? width - tx : tc->tile;
+			MU_32S th = ty + tc->tile > tc->size.height ? tc->size.height - ty : tc->tile;
+			MU_64U sad = 0, limit = (MU_64U)tc->threshold*tw*th; //255*tile*tile passes 32 bits at tile 4096
+			MU_32S y;
+
+			for(y=ty; y<ty+th && sad<=limit; y++)
+			{
+				sad += rowSAD(frame->imagedata + y*width + tx, tc->ref->imagedata + y*width + tx, tw);
+			}
+
+			tc->changed[i] = sad > limit;
+			if(tc->changed[i])
+			{
+				for(y=ty; y<ty+th; y++)
+					memcpy(tc->ref->imagedata + y*width + tx, frame->imagedata + y*width + tx, tw);
+			}
+		}
+	}
+
+	tc->frameid++;
+	tc->nchanged = 0;
+	minx = tc->cols; miny = tc->rows; maxx = -1; maxy = -1;
+	for(i=0; i<n; i++)
+	{
+		if(!tc->changed[i])
+			continue;
+		tc->nchanged++;
+		if(tc->cachevalid)
+			tc->cachevalid[i] = 0;
+		if(i % tc->cols < minx) minx = i % tc->cols;
+		if(i % tc->cols > maxx) maxx = i % tc->cols;
+		if(i / tc->cols < miny) miny = i / tc->cols;
+		if(i / tc->cols > maxy) maxy = i / tc->cols;
+	}
+
+	if(tc->nchanged)
+	{
+		tc->bound.x = minx*tc->tile;
+		tc->bound.y = miny*tc->tile;
+		tc->bound.width = ((maxx+1)*tc->tile > width ? width : (maxx+1)*tc->tile) - tc->bound.x;
+		tc->bound.height = ((maxy+1)*tc->tile > tc->size.height ? tc->size.height : (maxy+1)*tc->tile) - tc->bound.y;
+	}
+	else
+	{
+		tc->bound = muRect(0, 0, 0, 0);
+	}
+
+	return MU_ERR_SUCCESS;
+}
+
+/*===========================================================================================*/
+/*   muTileChanged                                                                           */
+/*                                                                                           */
+/*   DESCRIPTION:                                                                            */
+/*   1 when one of the tiles overlapped by rect has changed, else 0. A detector can skip a   */
+/*   scan window or ROI, a blur metric or tampering block can keep its last result.          */
+/*===========================================================================================*/
+MU_32S muTileChanged(const muTileChange_t *tc, muRect_t rect)
+{
+	MU_32S c0, c1, r0, r1, r, c;
+
+	if(tc == NULL || rect.width <= 0 || rect.height <= 0)
+	{
+		return 0;
+	}
+
+	c0 = rect.x < 0 ? 0 : rect.x/tc->tile;
+	r0 = rect.y < 0 ? 0 : rect.y/tc->tile;
+	c1 = (rect.x + rect.width - 1)/tc->tile;
+	r1 = (rect.y + rect.height - 1)/tc->tile;
+	if(c1 >= tc->cols) c1 = tc->cols - 1;
+	if(r1 >= tc->rows) r1 = tc->rows - 1;
+
+	for(r=r0; r<=r1; r++)
+		for(c=c0; c<=c1; c++)
+			if(tc->changed[r*tc->cols + c])
+				return 1;
+
+	return 0;
+}
+
+/*===========================================================================================*/
+/*   muTileCacheGet / muTileCacheSet / muTileCacheInvalidate                                 */
+/*                                                                                           */
+/*   DESCRIPTION:                                                                            */
+/*   Per tile result cache of cachesize bytes. Get returns the stored result of a tile or    */
+/*   NULL when there is none or the tile changed since it was stored. Invalidate drops the   */
+/*   results of all tiles overlapped by rect (e.g. after a parameter change).                */
+/*===========================================================================================*/
+MU_VOID* muTileCacheGet(muTileChange_t *tc, MU_32S col, MU_32S row)
+{
+	MU_32S i;
+
+	if(tc == NULL || tc->cache == NULL || col < 0 || row < 0 || col >= tc->cols || row >= tc->rows)
+	{
+		return NULL;
+	}
+
+	i = row*tc->cols + col;
+
+	return tc->cachevalid[i] ? tc->cache + i*tc->cachesize : NULL;
+}
+
+muError_t muTileCacheSet(muTileChange_t *tc, MU_32S col, MU_32S row, const MU_VOID *result)
+{
+	MU_32S i;
+
+	if(tc == NULL || result == NULL)
+	{
+		return MU_ERR_NULL_POINTER;
+	}
+
+	if(tc->cache == NULL || col < 0 || row < 0 || col >= tc->cols || row >= tc->rows)
+	{
+		return MU_ERR_INVALID_PARAMETER;
+	}
+
+	i = row*tc->cols + col;
+	memcpy(tc->cache + i*tc->cachesize, result, tc->cachesize);
+	tc->cachevalid[i] = 1;
+
+	return MU_ERR_SUCCESS;
+}
+
+muError_t muTileCacheInvalidate(muTileChange_t *tc, muRect_t rect)
+{
+	MU_32S c0, c1, r0, r1, r, c;
+
+	if(tc == NULL)
+	{
+		return MU_ERR_NULL_POINTER;
+	}
+
+	if(tc->cachevalid == NULL || rect.width <= 0 || rect.height <= 0)
+	{
+		return MU_ERR_SUCCESS;
+	}
+
+	c0 = rect.x < 0 ? 0 : rect.x/tc->tile;
+	r0 = rect.y < 0 ? 0 : rect.y/tc->tile;
+	c1 = (rect.x + rect.width - 1)/tc->tile;
+	r1 = (rect.y + rect.height - 1)/tc->tile;
+	if(c1 >= tc->cols) c1 = tc->cols - 1;
+	if(r1 >= tc->rows) r1 = tc->rows - 1;
+
+	for(r=r0; r<=r1; r++)
+		for(c=c0; c<=c1; c++)
+			tc->cachevalid[r*tc->cols + c] = 0;
+
+	return MU_ERR_SUCCESS;
+}
@@ -0,0 +1,342 @@
+/*
+% MIT License
+%
+% Copyright (c) 2016 OneCV
+%
+% Permission is hereby granted, free of charge, to any person obtaining a copy
+% of this software and associated documentation files (the "Software"), to deal
+% in the Software without restriction, including without limitation the rights
+% to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+% copies of the Software, and to permit persons to whom the Software is
+% furnished to do so, subject to the following conditions:
+%
+% The above copyright notice and this permission notice shall be included in all
+% copies or substantial portions of the Software.
+%
+% THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+% IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+% FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+% AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+% LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+% OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+% SOFTWARE.
+*/
+
+/* ------------------------------------------------------------------------- /
+ *
+ * Module: muTiledintegral.c
+ * Author: Joe Lin
+ *
+ * Description:
+ *    Tiled integral image: 32-bit local integrals per tile, 64-bit tile
+ *    corner and strip offsets, built in parallel and free of overflow for
+ *    any frame size.
+ *
+ -------------------------------------------------------------------------- */
+
+#include "muCore.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+
+/*===========================================================================================*/
+/*   muCreateTiledIntegral / muReleaseTiledIntegral                                          */
+/*                                                                                           */
+/*   DESCRIPTION:                                                                            */
+/*   Tiled integral image of frames of the given size. Every tile covers                     */
+/*   (1 << tileshift) + margin pixels in both directions, so windows up to margin + 1 pixels */
+/*   always lie in the tile of their top-left corner.                                        */
+/*                                                                                           */
+/*   NOTE                                                                                    */
+/*   tileshift 4~8, tile + margin <= 256 keeps the local squared sums in 32 bits.            */
+/*===========================================================================================*/
+muTiledIntegral_t* muCreateTiledIntegral(muSize_t size, MU_32S tileshift, MU_32S margin)
+{
+	muTiledIntegral_t *ti;
+	MU_32S tile, local;
+
+	if(size.width <= 0 || size.height <= 0 || tileshift < 4 || tileshift > 8)
+	{
+		return NULL;
+	}
+
+	tile = 1 << tileshift;
+	if(margin < 0 || tile + margin > 256)
+	{
+		return NULL;
+	}
+
+	ti = (muTiledIntegral_t *)calloc(1, sizeof(muTiledIntegral_t));
+	if(ti == NULL)
+	{
+		return NULL;
+	}
+
+	ti->imgSize = size;
+	ti->tileshift = tileshift;
+	ti->tile = tile;
+	ti->margin = margin;
+	ti->cols = (size.width + tile - 1) >> tileshift;
+	ti->rows = (size.height + tile - 1) >> tileshift;
+	ti->step = tile + margin + 1;
+	local = ti->cols*ti->rows*ti->step*ti->step;
+
+	ti->sum = (MU_32S *)calloc(local, sizeof(MU_32S));
+	ti->sqsum = (MU_32U *)calloc(local, sizeof(MU_32U));
+	ti->cornersum = (MU_64S *)malloc(ti->cols*ti->rows*sizeof(MU_64S));
+	ti->cornersq = (MU_64U *)malloc(ti->cols*ti->rows*sizeof(MU_64U));
+	ti->rowsum = (MU_64S *)malloc(ti->rows*(size.width+1)*sizeof(MU_64S));
+	ti->rowsq = (MU_64U *)malloc(ti->rows*(size.width+1)*sizeof(MU_64U));
+	ti->colsum = (MU_64S *)malloc(ti->cols*(size.height+1)*sizeof(MU_64S));
+	ti->colsq = (MU_64U *)malloc(ti->cols*(size.height+1)*sizeof(MU_64U));
+
+	if(ti->sum == NULL || ti->sqsum == NULL || ti->cornersum == NULL || ti->cornersq == NULL ||
+		ti->rowsum == NULL || ti->rowsq == NULL || ti->colsum == NULL || ti->colsq == NULL)
+	{
+		muReleaseTiledIntegral(&ti);
+		return NULL;
+	}
+
+	return ti;
+}
+
+muError_t muReleaseTiledIntegral(muTiledIntegral_t **ti)
+{
+	if(ti == NULL || *ti == NULL)
+	{
+		return MU_ERR_NULL_POINTER;
+	}
+
+	free((*ti)->sum);
+	free((*ti)->sqsum);
+	free((*ti)->cornersum);
+	free((*ti)->cornersq);
+	free((*ti)->rowsum);
+	free((*ti)->rowsq);
+	free((*ti)->colsum);
+	free((*ti)->colsq);
+	free(*ti);
+	*ti = NULL;
+
+	return MU_ERR_SUCCESS;
+}
+
+/*===========================================================================================*/
+/*   muTiledIntegral                                                                         */
+/*                                                                                           */
+/*   DESCRIPTION:                                                                            */
+/*   Computes the tiled integral image of src:                                               */
+/*     sum[tile](lx,ly)   local integral inside the tile (32-bit),                           */
+/*     cornersum[tile]    sum of everything above and left of the tile (64-bit),             */
+/*     rowsum[ty](x)      sum above tile row ty from the tile start to x (64-bit),           */
+/*     colsum[tx](y)      sum left of tile column tx from the tile start to y (64-bit),      */
+/*   and the same for the squared values. I(x,y) is the sum of the four terms.              */
+/*                                                                                           */
+/*   NOTE                                                                                    */
+/*   The tiles are independent and are computed in parallel (OpenMP), the offsets are a     */
+/*   small second pass over the tile borders.                                                */
+/*===========================================================================================*/
+muError_t muTiledIntegral(const muImage_t *src, muTiledIntegral_t *ti)
+{
+	MU_32S t, n, x, y, W, H, T, E, s;
+	muError_t ret;
+
+	ret = muCheckDepth(2, src, MU_IMG_DEPTH_8U);
+	if(ret)
+	{
+		return ret;
+	}
+
+	if(ti == NULL)
+	{
+		return MU_ERR_NULL_POINTER;
+	}
+
+	if(src->channels != 1 || src->width != ti->imgSize.width || src->height != ti->imgSize.height)
+	{
+		return MU_ERR_NOT_SUPPORT;
+	}
+
+	W = src->width;
+	H = src->height;
+	T = ti->tile;
+	E = ti->step;
+	s = ti->tileshift;
+	n = ti->cols*ti->rows;
+
+	/* local integrals, the first row/column of a tile stays 0 */
+#ifdef _OPENMP
+#pragma omp parallel for private(x, y) schedule(dynamic)
+#endif
+	for(t=0; t<n; t++)
+	{
+		MU_32S x0 = (t % ti->cols) << s, y0 = (t / ti->cols) << s;
+		MU_32S w = x0 + E - 1 > W ? W - x0 : E - 1;
+		MU_32S h = y0 + E - 1 > H ? H - y0 : E - 1;
+		MU_32S *sum = ti->sum + t*E*E;
+		MU_32U *sq = ti->sqsum + t*E*E;
+
+		for(y=0; y<h; y++)
+		{
+			const MU_8U *in = src->imagedata + (y0 + y)*W + x0;
+			MU_32S *srow = sum + (y+1)*E + 1;
+			MU_32U *qrow = sq + (y+1)*E + 1;
+			MU_32S rs = 0;
+			MU_32U rq = 0;
+			for(x=0; x<w; x++)
+			{
+				rs += in[x];
+				rq += in[x]*in[x];
+				srow[x] = srow[x-E] + rs;
+				qrow[x] = qrow[x-E] + rq;
+			}
+		}
+	}
+
+	/* rowsum[ty](x) = rowsum[ty-1](x) + bottom row of the tile above */
+#ifdef _OPENMP
+#pragma omp parallel for private(t)
+#endif
+	for(x=0; x<=W; x++)
+	{
+		MU_32S tx = x >> s;
+		MU_32S lx;
+		MU_64S as = 0;
+		MU_64U aq = 0;
+
+		if(tx >= ti->cols)
+			tx = ti->cols - 1;
+		lx = x - (tx << s);
+
+		ti->rowsum[x] = 0;
+		ti->rowsq[x] = 0;
+		for(t=1; t<ti->rows; t++)
+		{
+			MU_32S o = ((t-1)*ti->cols + tx)*E*E + T*E + lx;
+			as += ti->sum[o];
+			aq += ti->sqsum[o];
+			ti->rowsum[t*(W+1) + x] = as;
+			ti->rowsq[t*(W+1) + x] = aq;
+		}
+	}
+
+	/* colsum[tx](y) = colsum[tx-1](y) + right column of the tile on the left */
+#ifdef _OPENMP
+#pragma omp parallel for private(t)
+#endif
+	for(y=0; y<=H; y++)
+	{
+		MU_32S ty = y >> s;
+		MU_32S ly;
+		MU_64S bs = 0;
+		MU_64U bq = 0;
+
+		if(ty >= ti->rows)
+			ty = ti->rows - 1;
+		ly = y - (ty << s);
+
+		ti->colsum[y] = 0;
+		ti->colsq[y] = 0;
+		for(t=1; t<ti->cols; t++)
+		{
+			MU_32S o = (ty*ti->cols + t - 1)*E*E + ly*E + T;
+			bs += ti->sum[o];
+			bq += ti->sqsum[o];
+			ti->colsum[t*(H+1) + y] = bs;
+			ti->colsq[t*(H+1) + y] = bq;
+		}
+	}
+
+	/* corner offsets, 2-D prefix of the tile totals */
+	for(y=0; y<ti->rows; y++)
+	{
+		for(x=0; x<ti->cols; x++)
+		{
+			MU_32S i = y*ti->cols + x;
+			MU_64S cs = 0;
+			MU_64U cq = 0;
+			if(x > 0 && y > 0)
+			{
+				MU_32S o = (i - ti->cols - 1)*E*E + T*E + T;
+				cs = ti->cornersum[i-1] + ti->cornersum[i-ti->cols] - ti->cornersum[i-ti->cols-1] + ti->sum[o];
+				cq = ti->cornersq[i-1] + ti->cornersq[i-ti->cols] - ti->cornersq[i-ti->cols-1] + ti->sqsum[o];
+			}
+			ti->cornersum[i] = cs;
+			ti->cornersq[i] = cq;
+		}
+	}
+
+	return MU_ERR_SUCCESS;
+}
+
+/*===========================================================================================*/
+/*   muTiledIntegralPoint / muTiledIntegralPointSq                                           */
+/*                                                                                           */
+/*   DESCRIPTION:                                                                            */
+/*   I(x,y) = sum of src over [0,x)x[0,y), 0 <= x <= width, 0 <= y <= height.                */
+/*===========================================================================================*/
+MU_64S muTiledIntegralPoint(const muTiledIntegral_t *ti, MU_32S x, MU_32S y)
+{
+	MU_32S tx = x >> ti->tileshift, ty = y >> ti->tileshift;
+
+	if(tx >= ti->cols)
+		tx = ti->cols - 1;
+	if(ty >= ti->rows)
+		ty = ti->rows - 1;
+
+	return ti->cornersum[ty*ti->cols + tx] + ti->rowsum[ty*(ti->imgSize.width+1) + x] +
+		ti->colsum[tx*(ti->imgSize.height+1) + y] +
+		ti->sum[(ty*ti->cols + tx)*ti->step*ti->step + (y - (ty << ti->tileshift))*ti->step + x - (tx << ti->tileshift)];
+}
+
+MU_64U muTiledIntegralPointSq(const muTiledIntegral_t *ti, MU_32S x, MU_32S y)
+{
+	MU_32S tx = x >> ti->tileshift, ty = y >> ti->tileshift;
+
+	if(tx >= ti->cols)
+		tx = ti->cols - 1;
+	if(ty >= ti->rows)
+		ty = ti->rows - 1;
+
+	return ti->cornersq[ty*ti->cols + tx] + ti->rowsq[ty*(ti->imgSize.width+1) + x] +
+		ti->colsq[tx*(ti->imgSize.height+1) + y] +
+		ti->sqsum[(ty*ti->cols + tx)*ti->step*ti->step + (y - (ty << ti->tileshift))*ti->step + x - (tx << ti->tileshift)];
+}
+
+/*===========================================================================================*/
+/*   muTiledIntegralSum                                                                      */
+/*                                                                                           */
+/*   DESCRIPTION:                                                                            */
+/*   Sum and squared sum of rect in O(1) wherever the rect lies relative to the tiles.      */
+/*   sqsum may be NULL.                                                                      */
+/*===========================================================================================*/
+muError_t muTiledIntegralSum(const muTiledIntegral_t *ti, muRect_t rect, MU_64S *sum, MU_64U *sqsum)
+{
+	MU_32S x1, y1;
+
+	if(ti == NULL || sum == NULL)
+	{
+		return MU_ERR_NULL_POINTER;
+	}
+
+	x1 = rect.x + rect.width;
+	y1 = rect.y + rect.height;
+	if(rect.x < 0 || rect.y < 0 || rect.width < 0 || rect.height < 0 ||
+		x1 > ti->imgSize.width || y1 > ti->imgSize.height)
+	{
+		return MU_ERR_INVALID_PARAMETER;
+	}
+
+	*sum = muTiledIntegralPoint(ti, x1, y1) - muTiledIntegralPoint(ti, rect.x, y1) -
+		muTiledIntegralPoint(ti, x1, rect.y) + muTiledIntegralPoint(ti, rect.x, rect.y);
+
+	if(sqsum)
+	{
+		*sqsum = muTiledIntegralPointSq(ti, x1, y1) - muTiledIntegralPointSq(ti, rect.x, y1) -
+			muTiledIntegralPointSq(ti, x1, rect.y) + muTiledIntegralPointSq(ti, rect.x, rect.y);
+	}
+
+	return MU_ERR_SUCCESS;
+}
@@ -47,6 +47,9 @@
 * sensitivity:    from 1 to 5
 * return value:   detection result (MU_CAM_LOSTFOCUS/ MU_CAM_OCCLUSION)
 *
+* muDetectCamTampering_Frame() does the same on the gray frame of a frame context and
+* takes the downscaled frame from its pyramid.
+*
 */
 
 #define MU_CAM_NORMAL      0x00
@@ -54,6 +57,7 @@
 #define MU_CAM_OCCLUSION   0x02
 
 MU_API(MU_32S) muDetectCamTampering( const muImage_t* src, MU_32S flags, MU_32S sensitivity);
+MU_API(MU_32S) muDetectCamTampering_Frame( muFrameContext_t* ctx, MU_32S flags, MU_32S sensitivity);
 /* end of muDetectCamTampering */
 
 #define MU_HAAR_FEATURE_MAX  3
@@ -116,6 +120,132 @@ typedef struct MuSimpleDetector
     int *p0, *p1, *p2, *p3;
 } MuSimpleDetector;
 
+/* MuQuantCascade
+*
+* Integer version of a MuSimpleDetector built by muQuantizeCascade. Leaves and stage
+* thresholds are int16/int32 in Q(leafshift). muSetImagesForQuantCascade takes the rect
+* layout of a scale from the source cascade (which must outlive it) and premultiplies the
+* weights (int16) and feature thresholds (int32) in Q(shift). Tilted features are not supported.
+*
+*/
+typedef struct MuQuantRect
+{
+    MU_32S offset;      //top-left corner in the sum, relative to the window
+    MU_32S dy;          //height*sum step
+    MU_16S dx;          //width
+    MU_16S weight;
+} MuQuantRect;
+
+typedef struct MuQuantNode
+{
+    MuQuantRect rect[MU_HAAR_FEATURE_MAX];  //weight = 0 for the third rect of two rect features
+    MU_32S threshold;
+    MU_16S left;
+    MU_16S right;
+} MuQuantNode;
+
+typedef struct MuQuantStage
+{
+    MU_32S count;
+    MU_32S threshold;
+    MuQuantNode *node;
+} MuQuantStage;
+
+typedef struct MuQuantCascade
+{
+    MuSimpleDetector *source;
+    MU_32S count;
+    MU_32S leafshift;
+    MU_32S shift;
+    muSize_t real_window_size;
+    muSize_t sumSize;
+    MU_32S area;            //variance window
+    MU_32S offset, dx, dy;
+    const MU_32S *sum;
+    const MU_32U *sqsum;
+    MuQuantStage *stage;
+} MuQuantCascade;
+
+typedef struct MuQuantIntegral
+{
+    MU_32S *sum;
+    MU_32U *sqsum;
+    muSize_t sumSize;
+    muSize_t imgSize;
+} MuQuantIntegral;
+
+/* MuDetectionAtlas
+*
+* Batch detection of many small frames (substreams, thumbnails): the frames are stacked in
+* frameSize cells, integrated in bands of bandFrames cells sized to stay in cache. The feature
+* setup of every scale is done once per call for all the frames. The integral is kept between
+* calls of muObjectDetection_Atlas.
+*
+*/
+typedef struct MuDetectionAtlas
+{
+    muSize_t frameSize;     //cell size, the largest frame
+    int capacity;           //frames per call
+    int bandFrames;         //frames per integral band
+    muIntegralImg_t Itlmg;
+} MuDetectionAtlas;
+
+/* MuDetectQuality
+*
+* Per stream controller of muObjectDetection_Quality. level goes from 0 (the parameters
+* given to muDetectQualityInit) to MU_QUALITY_LEVELS-1 when the smoothed cost per frame
+* exceeds the budget, and back when it stays well below. The current level and parameters
+* can be read for monitoring.
+*
+*/
+#define MU_QUALITY_LEVELS 8
+
+typedef struct MuDetectQuality
+{
+    double budget;              //ms per frame
+    double baseScaleFactor;
+    muSize_t baseMinSize, baseMaxSize;
+    int level;                  //0 = full quality
+    double scaleFactor;
+    int stride;
+    muSize_t minSize, maxSize;
+    int tiles;                  //ROI strips, one scanned per frame
+    int skip;                   //frames skipped between detections
+    double cost;                //smoothed ms per detection
+    int frame, tile, calm, hold;
+} MuDetectQuality;
+
+/* MuCandidateResult
+*
+* Verdict of muVerifyCandidates for one candidate rectangle. depth is the number of
+* passed stages (count of the cascade when pass is 1) and score the stage sum minus the
+* threshold of the last evaluated stage, negative for a rejected candidate. Flat windows
+* and candidates smaller than the cascade window or outside the integral get all zeros.
+*
+*/
+typedef struct MuCandidateResult
+{
+    int pass;
+    int depth;
+    double score;
+} MuCandidateResult;
+
+/* MuScalePrior
+*
+* Plausible object heights of a fixed camera scene, indexed by the bottom row of the
+* object (minHeight[y] <= height <= maxHeight[y]). Set from two rows with
+* muScalePriorSetRange or learned from past detections (muScalePriorLearn/muScalePriorFit),
+* muObjectDetection_Prior evaluates every scale only on the rows where it is plausible.
+*
+*/
+typedef struct MuScalePrior
+{
+    int height;             //rows of the frame
+    int *minHeight;
+    int *maxHeight;
+    double n, sy, sh, syy, syh;    //learning sums of bottom row and height
+} MuScalePrior;
+
 /*Mu Examinator structures*/
 typedef struct MuStatus
 {
@@ -153,11 +283,43 @@ typedef struct MuExamData
 	MU_32S TagNum;
 } MuExamData;
 
+/* MuExamModel
+*
+* One cascade of an examinator in a single arena. A model loaded without a cache is
+* private: it holds the parsed stages and classifiers (Cascade) and its MuDetector runs
+* on them directly.
+*
+* Identical tables loaded through the same MuExamModelCache share one model, freed with
+* its last examinator. Only the parameter table is deduplicated: a cached model holds the
+* table alone and every MuDetector parses its own stages and classifiers from it, since
+* muSetImagesForHaarClassifierCascade writes the per-scale feature pointers and weights
+* into them. The shared model is never written, so examinators sharing a cache can be
+* run from different threads.
+*
+*/
+typedef struct MuExamModel
+{
+	MU_32S Refs;
+	MU_32S TableSize;
+	MU_32S StageNum;
+	MU_32S ClassifierNum;
+	MuSimpleDetector Cascade;             //private model only
+	double *Table;                       //cached model only
+	MuHaarStageClassifier *Stages;       //private model only, then the classifiers
+	struct MuExamModelCache *Cache;
+	struct MuExamModel *Next;
+} MuExamModel;
+
+typedef struct MuExamModelCache
+{
+	MuExamModel *First;
+} MuExamModelCache;
+
 typedef struct MuDetector
 {
 	MuSimpleDetector Cascade;
-	MuHaarStageClassifier CascadeStages[25];
-	MuHaarClassifier CascadeClassifiers[500];
+	MuExamModel *Model;
+	MuHaarStageClassifier *Stages; //stages parsed from a cached model, then classifiers
 	muSeq_t *Objects;
 	muSeq_t *Tracks;
 	muRect_t ScanROI;
@@ -175,6 +337,41 @@ typedef struct MuExaminator
 } MuExaminator;
 /*End of mu examinator*/
 
+/* muCorrelationTracker
+*
+* MOSSE correlation filter tracker, the appearance of the target is learned
+* online so it can be followed between sparse detections.
+*
+* Tracker:        filled by muCorrelationTrackerInit, released by muCorrelationTrackerRelease
+* box:            the target in the first frame (Init) / the tracked target (Update)
+* psr:            peak-to-sidelobe ratio of the response, Lost is set below PSRThreshold
+*                 and the filter is not updated while lost
+*
+*/
+typedef struct MuCorrelationTracker
+{
+	muRect_t Box;
+	MU_32F Cx;
+	MU_32F Cy;
+	MU_32F Confidence;
+	MU_8U Lost;
+	MU_32F LearningRate;
+	MU_32F PSRThreshold;
+	MU_32F Scale;
+	MU_32S PatchW;
+	MU_32S PatchH;
+	muFFTPlan_t *Plan;
+	muComplex_t *Spectrum;
+	muComplex_t *G;
+	muComplex_t *A;
+	muComplex_t *B;
+	muComplex_t *F;
+	MU_32F *Window;
+	MU_32F *Patch;
+	MU_32F *Response;
+} MuCorrelationTracker;
+/* end of muCorrelationTracker */
+
 /* Mu Boost Learning structure start */
 
 #define features_num 2000
@@ -233,29 +430,71 @@ enum
 {
 	MU_BGM_GMM = 1,
 	MU_BGM_ISB,
+	MU_BGM_VIBE,	//sample consensus, integer only, foreground mask by muBackgroundModelingForeground
 };
 
 MU_API(muError_t) muBackgroundModelingInit(MU_32U width, MU_32U height, MU_32U type);
+MU_API(muError_t) muBackgroundModelingInitMultiRes(MU_32U width, MU_32U height, MU_32U type, MU_32U factor);
 
 MU_API(muError_t) muBackgroundModeling(muImage_t *curimg, muImage_t *bkimg);
+MU_API(muError_t) muBackgroundModelingFrame(muFrameContext_t *ctx, muImage_t *bkimg);
 
 MU_API(muError_t) muBackgroundModelingReset();
 MU_API(muError_t) muBackgroundModelingRelease();
+MU_API(muError_t) muBackgroundModelingCompensate(const MU_64F *m);
+MU_API(muError_t) muBackgroundModelingForeground(muImage_t *curimg, muImage_t *fgmask);
+MU_API(muError_t) muBackgroundModelingForegroundFrame(muFrameContext_t *ctx, muImage_t *fgmask);
+MU_API(muError_t) muBackgroundModelingSave(FILE *fp);
+MU_API(muError_t) muBackgroundModelingLoad(FILE *fp);
+MU_API(muError_t) muBackgroundModelingLoad_Buf(const MU_8U *buf, MU_32U size);
 
 /**Object Detection Function Headers**/
 MU_API(MU_VOID) muCalcIntegralImage( const MU_8U* src, MU_32S* sum, MU_64F* sqsum, muSize_t size);
 MU_API(MuSimpleDetector*) muLoadSimpleDetector(const char* filename);
 MU_API(MU_VOID) muReleaseSimpleDetector(MuSimpleDetector* Detector);
 MU_API(MU_VOID) muObjectDetectionInit(MuSimpleDetector* Detector, MuHaarStageClassifier *cascade_stages, MuHaarClassifier *cascade_classifiers, double *CascadeParaTable);
+MU_API(MU_VOID) muSetImagesForHaarClassifierCascade(MuSimpleDetector *Detector, muSize_t sumSize, MU_32S *sum, MU_64F *sqsum, double scale);
 
 /*Classic Object Detection Function*/
 MU_API(muSeq_t*) muObjectDetection(muImage_t* img, MuSimpleDetector* Detector, double scaleFactor, muSize_t minSize, muSize_t maxSize);
+MU_API(muSeq_t*) muObjectDetection_Prior(muImage_t* img, MuSimpleDetector* Detector, double scaleFactor, muSize_t minSize, muSize_t maxSize, const MuScalePrior *prior);
+MU_API(muSeq_t*) muObjectDetection_Frame(muFrameContext_t *ctx, MuSimpleDetector* Detector, double scaleFactor, muSize_t minSize, muSize_t maxSize, const MuScalePrior *prior);
+MU_API(MuScalePrior*) muCreateScalePrior(int height);
+MU_API(MU_VOID) muReleaseScalePrior(MuScalePrior *prior);
+MU_API(MU_VOID) muScalePriorSetRange(MuScalePrior *prior, int y0, int minH0, int maxH0, int y1, int minH1, int maxH1);
+MU_API(MU_VOID) muScalePriorLearn(MuScalePrior *prior, const muSeq_t *Objects);
+MU_API(int) muScalePriorFit(MuScalePrior *prior, double tolerance);
 
 /*Lightened Object Detection functions*/
 MU_API(muIntegralImg_t*) muIntegral_Light(muImage_t *img);
+MU_API(muIntegralImg_t*) muIntegral_LightROI(muImage_t *img, muRect_t ScanROI, muSize_t maxWinSize);
 MU_API(MU_VOID) muIntegral_LightRelease(muIntegralImg_t* Itlmg);
 MU_API(MU_VOID) muObjectDetection_Light(muIntegralImg_t *Itlmg, muRect_t ScanROI, muSeq_t* Objects, MuSimpleDetector* Detector, double scaleFactor, muSize_t minSize, muSize_t maxSize);
 MU_API(MU_VOID) muObjectDetection_SuperLight(muIntegralImg_t *Itlmg, muRect_t ScanROI, muSeq_t* Objects, MuSimpleDetector* Detector, muSize_t winSize);
+MU_API(MU_VOID) muObjectDetection_LightStride(muIntegralImg_t *Itlmg, muRect_t ScanROI, muSeq_t* Objects, MuSimpleDetector* Detector, double scaleFactor, muSize_t minSize, muSize_t maxSize, int stride);
+
+/*Deadline-aware Object Detection*/
+MU_API(MU_VOID) muDetectQualityInit(MuDetectQuality *q, double budget, double scaleFactor, muSize_t minSize, muSize_t maxSize);
+MU_API(MU_VOID) muDetectQualityUpdate(MuDetectQuality *q, double ms);
+MU_API(MU_32S) muObjectDetection_Quality(MuDetectQuality *q, muIntegralImg_t *Itlmg, muRect_t ScanROI, muSeq_t *Objects, MuSimpleDetector *Detector);
+
+/*Batch Object Detection of many small frames in one atlas*/
+MU_API(MuDetectionAtlas*) muCreateDetectionAtlas(muSize_t frameSize, int num);
+MU_API(MU_VOID) muReleaseDetectionAtlas(MuDetectionAtlas *atlas);
+MU_API(MU_VOID) muObjectDetection_Atlas(MuDetectionAtlas *atlas, muImage_t **frames, int num, muSeq_t **Objects, MuSimpleDetector* Detector, double scaleFactor, muSize_t minSize, muSize_t maxSize);
+
+/*Verification of given candidate rectangles (motion blobs, tracker predictions, ...)*/
+MU_API(MU_VOID) muVerifyCandidates(muIntegralImg_t *Itlmg, MuSimpleDetector* Detector, const muRect_t *Candidates, int num, MuCandidateResult *Results);
+
+/*Tiled integral Object Detection, for frames whose global integral overflows 32 bits (4K+)*/
+MU_API(MU_VOID) muObjectDetection_Tiled(const muTiledIntegral_t *ti, muRect_t ScanROI, muSeq_t* Objects, MuSimpleDetector* Detector, double scaleFactor, muSize_t minSize, muSize_t maxSize);
+/*Quantized (integer only) Object Detection*/
+MU_API(MuQuantCascade*) muQuantizeCascade(MuSimpleDetector *Detector);
+MU_API(MU_VOID) muReleaseQuantCascade(MuQuantCascade *Quant);
+MU_API(MuQuantIntegral*) muIntegral_Quant(muImage_t *img);
+MU_API(MU_VOID) muIntegral_QuantRelease(MuQuantIntegral *Itg);
+MU_API(MU_32S) muSetImagesForQuantCascade(MuQuantCascade *Quant, const MuQuantIntegral *Itg, double scale);
+MU_API(MU_VOID) muObjectDetection_Quant(MuQuantIntegral *Itg, muRect_t ScanROI, muSeq_t* Objects, MuQuantCascade* Quant, double scaleFactor, muSize_t minSize, muSize_t maxSize);
 MU_API(MU_VOID) muMergeRectangles(muSeq_t *Rectangles, int MergeObjDistTH, int HitNum);
 
 /*Boost Learning function*/
@@ -263,12 +502,18 @@ MU_API(MU_VOID) muObjectLearning_Init(muImage_t *img, muRect_t *box, muImage_t *
 
 /**Examinator Function Headers**/
 MU_API(MU_VOID) Examinator_Init_Buf(MU_8U *buf, MuExaminator *Examinator);
+MU_API(MU_VOID) Examinator_Init_Shared(MU_8U *buf, MuExaminator *Examinator, MuExamModelCache *Cache);
 MU_API(MU_VOID) Examinator_Init(FILE *fp, MuExaminator *Examinator);
 MU_API(MU_VOID) Examinator_Run(muImage_t *src, MuExaminator *Examinator);
 MU_API(MU_VOID) Examinator_Release(MuExaminator *Examinator);
 MU_API(MU_VOID) Examinator_Teach(MuExamData *Data);
 MU_API(MU_VOID) ExampleExaminatorMaker();
 
+/**Correlation Tracker Function Headers**/
+MU_API(muError_t) muCorrelationTrackerInit(MuCorrelationTracker *Tracker, const muImage_t *img, muRect_t box);
+MU_API(muError_t) muCorrelationTrackerUpdate(MuCorrelationTracker *Tracker, const muImage_t *img, muRect_t *box, MU_32F *psr);
+MU_API(MU_VOID) muCorrelationTrackerRelease(MuCorrelationTracker *Tracker);
+
 #endif /* _MUGADGET_H_ */
 
 /* End of file. */
@@ -35,6 +35,14 @@
 
 #include "muGadget.h"
 
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define MU_VIBE_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define MU_VIBE_SSE2 1
+#endif
+
 #define	INIT_STD 36 
 #define STD_WEIGHT 3	
 #define ALPHA 0.01
@@ -43,6 +51,7 @@ static MU_32U gmm_init_flag = 0;
 static MU_32U isb_init_flag = 0;
 static MU_32U frame_count_isb = 0, frame_count_gmm = 0;
 static MU_32U g_height = 0;
+static MU_32U bgm_width = 0, bgm_height = 0;
 static MU_64F pre_entropy = 0;
 
 typedef struct gmm_buf
@@ -63,8 +72,91 @@ typedef struct isb_buf
 static gmm_buf_t gmm_buf;
 static isb_buf_t isb_buf;
 
+//sample consensus (ViBe) model
+#define VIBE_SAMPLES 20		//samples per pixel
+#define VIBE_RADIUS 20		//a sample matches when |pixel-sample| < radius
+#define VIBE_MATCHES 2		//matches for background
+#define VIBE_SUBSAMPLE 16	//1/16 of the background pixels update their model
+#define VIBE_TABLE 1024		//random tables, power of 2
+
+static MU_32U vibe_init_flag = 0;
+static MU_32U frame_count_vibe = 0;
+
+typedef struct vibe_buf
+{
+	MU_8U *samples;		//VIBE_SAMPLES planes of width*height
+	MU_8U *mask;		//foreground of the last frame, 255 = foreground
+	MU_32U rng;			//xorshift state
+	MU_8U jump[VIBE_TABLE];		//distance to the next updated pixel, mean VIBE_SUBSAMPLE
+	MU_8U sample[VIBE_TABLE];	//sample to replace
+	MU_32S neighbor[VIBE_TABLE][2];	//dx, dy of the neighbour to update
+}vibe_buf_t;
+
+static vibe_buf_t vibe_buf;
+
+//multi-resolution: frames are box downscaled by 1 << bgm_shift before the model
+static MU_32U bgm_shift = 0;
+static MU_32U bgm_full_width = 0, bgm_full_height = 0;
+static muImage_t *bgm_small_cur = NULL, *bgm_small_bk = NULL;
+
+static MU_VOID releaseMultiRes(MU_VOID)
+{
+	if(bgm_small_cur)
+		muReleaseImage(&bgm_small_cur);
+	if(bgm_small_bk)
+		muReleaseImage(&bgm_small_bk);
+	bgm_small_cur = NULL;
+	bgm_small_bk = NULL;
+	bgm_shift = 0;
+}
+
+//box average of (1<<bgm_shift)^2 blocks, the rows of a block are read in one pass
+static MU_VOID downscaleBox(const muImage_t *src, muImage_t *dst)
+{
+	MU_32U x, y;
+	MU_32U s = src->width;
+
+	for(y=0; y<dst->height; y++)
+	{
+		const MU_8U *p = src->imagedata + (y << bgm_shift)*s;
+		MU_8U *out = dst->imagedata + y*dst->width;
+
+		if(bgm_shift == 1)
+		{
+			for(x=0; x<dst->width; x++, p+=2)
+				out[x] = (MU_8U)((p[0] + p[1] + p[s] + p[s+1] + 2) >> 2);
+		}
+		else
+		{
+			for(x=0; x<dst->width; x++, p+=4)
+				out[x] = (MU_8U)((p[0] + p[1] + p[2] + p[3] +
+				                  p[s] + p[s+1] + p[s+2] + p[s+3] +
+				                  p[2*s] + p[2*s+1] + p[2*s+2] + p[2*s+3] +
+				                  p[3*s] + p[3*s+1] + p[3*s+2] + p[3*s+3] + 8) >> 4);
+		}
+	}
+}
+
+//pixel replication back to the frame size, the right/bottom rest repeats the last block
+static MU_VOID upscaleNearest(const muImage_t *src, muImage_t *dst)
+{
+	MU_32U x, y, sx, sy;
+
+	for(y=0; y<dst->height; y++)
+	{
+		sy = y >> bgm_shift;
+		sy = sy >= src->height ? src->height-1 : sy;
+		for(x=0; x<dst->width; x++)
+		{
+			sx = x >> bgm_shift;
+			sx = sx >= src->width ? src->width-1 : sx;
+			dst->imagedata[y*dst->width + x] = src->imagedata[sy*src->width + sx];
+		}
+	}
+}
+
 
-static muError_t muBackgroundModelingISB(muImage_t *curimg, muImage_t *bkimg, isb_buf_t *isb_buf)
+static muError_t muBackgroundModelingISB(const muImage_t *curimg, muImage_t *bkimg, isb_buf_t *isb_buf)
 {
 	MU_8U min_l, max_l;
 	MU_32U temp;
@@ -217,7 +309,7 @@ static muError_t muBackgroundModelingISB(muImage_t *curimg, muImage_t *bkimg, is
 
 
 
-static muError_t muBackgroundModelingGMM(muImage_t *curimg, muImage_t *bkimg, gmm_buf_t *gmm_buf)
+static muError_t muBackgroundModelingGMM(const muImage_t *curimg, muImage_t *bkimg, gmm_buf_t *gmm_buf)
 {
 	MU_32U i, j;
 	MU_32U width, height;
@@ -300,6 +392,229 @@ static muError_t muBackgroundModelingGMM(muImage_t *curimg, muImage_t *bkimg, gm
 	return MU_ERR_SUCCESS;
 }
 
+static MU_32U vibeRand(vibe_buf_t *vibe_buf)
+{
+	MU_32U x = vibe_buf->rng;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	vibe_buf->rng = x;
+
+	return x;
+}
+
+//number of matching samples of 16 (or 8) pixels at once, returns the first pixel not classified
+static MU_32U vibeClassifyVector(const MU_8U *in, const MU_8U *samples, MU_8U *mask, MU_32U length)
+{
+	MU_32U i = 0, k;
+
+#if defined(MU_VIBE_NEON)
+	uint8x16_t radius = vdupq_n_u8(VIBE_RADIUS);
+	uint8x16_t matches = vdupq_n_u8(VIBE_MATCHES);
+
+	for(i=0; i+16<=length; i+=16)
+	{
+		uint8x16_t x = vld1q_u8(in+i);
+		uint8x16_t count = vdupq_n_u8(0);
+
+		for(k=0; k<VIBE_SAMPLES; k++)
+		{
+			uint8x16_t s = vld1q_u8(samples + k*length + i);
+			count = vsubq_u8(count, vcltq_u8(vabdq_u8(x, s), radius));
+		}
+		vst1q_u8(mask+i, vcltq_u8(count, matches));
+	}
+#elif defined(MU_VIBE_SSE2)
+	__m128i radius = _mm_set1_epi8(VIBE_RADIUS-1);
+	__m128i matches = _mm_set1_epi8(VIBE_MATCHES);
+	__m128i zero = _mm_setzero_si128();
+
+	for(i=0; i+16<=length; i+=16)
+	{
+		__m128i x = _mm_loadu_si128((const __m128i *)(in+i));
+		__m128i count = zero;
+
+		for(k=0; k<VIBE_SAMPLES; k++)
+		{
+			__m128i s = _mm_loadu_si128((const __m128i *)(samples + k*length + i));
+			__m128i d = _mm_or_si128(_mm_subs_epu8(x, s), _mm_subs_epu8(s, x));
+			count = _mm_sub_epi8(count, _mm_cmpeq_epi8(_mm_subs_epu8(d, radius), zero));
+		}
+		//foreground when matches-count > 0
+		_mm_storeu_si128((__m128i *)(mask+i), _mm_andnot_si128(_mm_cmpeq_epi8(_mm_subs_epu8(matches, count), zero), _mm_set1_epi8(-1)));
+	}
+#endif
+
+	return i;
+}
+
+static muError_t muBackgroundModelingVIBE(const muImage_t *curimg, muImage_t *bkimg, muImage_t *fgmask, vibe_buf_t *vibe_buf)
+{
+	MU_32U i, k, x, y, r;
+	MU_32U width, height, length;
+	MU_32S nx, ny;
+	MU_8U *in;
+	MU_8U *samples;
+	MU_8U *mask;
+
+	width = curimg->width;
+	height = curimg->height;
+	length = width*height;
+
+	if(width != bgm_width || height != bgm_height || curimg->channels != 1)
+	{
+		return MU_ERR_NOT_SUPPORT;
+	}
+
+	in = (MU_8U *)curimg->imagedata;
+	samples = vibe_buf->samples;
+	mask = vibe_buf->mask;
+
+	if(frame_count_vibe == 0)
+	{
+		//samples from the 3x3 neighbourhood of the first frame
+		for(y=0; y<height; y++)
+			for(x=0; x<width; x++)
+				for(k=0; k<VIBE_SAMPLES; k++)
+				{
+					r = vibeRand(vibe_buf);
+					nx = (MU_32S)x + (MU_32S)(r%3) - 1;
+					ny = (MU_32S)y + (MU_32S)((r>>8)%3) - 1;
+					nx = nx < 0 ? 0 : (nx >= (MU_32S)width ? width-1 : nx);
+					ny = ny < 0 ? 0 : (ny >= (MU_32S)height ? height-1 : ny);
+					samples[k*length + y*width + x] = in[ny*width + nx];
+				}
+
+		memset(mask, 0, length);
+	}
+	else
+	{
+		//classification
+		i = vibeClassifyVector(in, samples, mask, length);
+		for(; i<length; i++)
+		{
+			MU_32U count = 0;
+			for(k=0; k<VIBE_SAMPLES; k++)
+			{
+				count += abs((MU_32S)in[i] - (MU_32S)samples[k*length + i]) < VIBE_RADIUS;
+			}
+			mask[i] = count < VIBE_MATCHES ? 255 : 0;
+		}
+
+		//random subsampled update of the background pixels, own model and one neighbour
+		r = vibeRand(vibe_buf);
+		for(y=0; y<height; y++)
+		{
+			for(x=vibe_buf->jump[r++ & (VIBE_TABLE-1)]-1; x<width; x+=vibe_buf->jump[r++ & (VIBE_TABLE-1)])
+			{
+				i = y*width + x;
+				if(mask[i])
+					continue;
+
+				samples[vibe_buf->sample[r & (VIBE_TABLE-1)]*length + i] = in[i];
+
+				nx = (MU_32S)x + vibe_buf->neighbor[r & (VIBE_TABLE-1)][0];
+				ny = (MU_32S)y + vibe_buf->neighbor[r & (VIBE_TABLE-1)][1];
+				nx = nx < 0 ? 0 : (nx >= (MU_32S)width ? width-1 : nx);
+				ny = ny < 0 ? 0 : (ny >= (MU_32S)height ? height-1 : ny);
+				samples[vibe_buf->sample[(r+1) & (VIBE_TABLE-1)]*length + ny*width + nx] = in[i];
+			}
+		}
+	}
+
+	//one sample plane stands for the background image
+	if(bkimg)
+	{
+		memcpy(bkimg->imagedata, samples, length);
+	}
+
+	if(fgmask)
+	{
+		memcpy(fgmask->imagedata, mask, length);
+	}
+
+	return MU_ERR_SUCCESS;
+}
+
+//full resolution mask from the coarse one. Blocks whose 3x3 neighbourhood is all background
+//or all foreground are filled, the pixels of the edge blocks in between are matched against
+//the samples of their block
+static MU_VOID refineVIBE(const muImage_t *curimg, muImage_t *fgmask, const vibe_buf_t *vibe_buf)
+{
+	MU_32U x, y, k, bx, by, x0, x1, count;
+	MU_32U sw = bgm_width, sh = bgm_height, slength = bgm_width*bgm_height;
+	const MU_8U *mask = vibe_buf->mask;
+	MU_8U *any, *all, *cls;
+
+	any = (MU_8U *)malloc(3*slength);
+	if(any == NULL)
+	{
+		upscaleNearest(bgm_small_cur, fgmask);
+		return;
+	}
+	all = any + slength;
+	cls = all + slength;
+
+	//horizontal dilation/erosion, then vertical: cls 0 = background, 255 = foreground, 1 = edge
+	for(by=0; by<sh; by++)
+	{
+		const MU_8U *m = mask + by*sw;
+		for(bx=0; bx<sw; bx++)
+		{
+			MU_8U l = m[bx ? bx-1 : bx], r = m[bx+1 < sw ? bx+1 : bx];
+			any[by*sw + bx] = l | m[bx] | r;
+			all[by*sw + bx] = l & m[bx] & r;
+		}
+	}
+	for(by=0; by<sh; by++)
+	{
+		MU_32U u = (by ? by-1 : by)*sw, c = by*sw, d = (by+1 < sh ? by+1 : by)*sw;
+		for(bx=0; bx<sw; bx++)
+		{
+			if(all[u+bx] & all[c+bx] & all[d+bx])
+				cls[c+bx] = 255;
+			else
+				cls[c+bx] = (any[u+bx] | any[c+bx] | any[d+bx]) ? 1 : 0;
+		}
+	}
+
+	for(y=0; y<fgmask->height; y++)
+	{
+		const MU_8U *in = curimg->imagedata + y*curimg->width;
+		MU_8U *out = fgmask->imagedata + y*fgmask->width;
+		const MU_8U *c;
+
+		by = y >> bgm_shift;
+		by = by >= sh ? sh-1 : by;
+		c = cls + by*sw;
+
+		for(bx=0; bx<sw; bx++)
+		{
+			x0 = bx << bgm_shift;
+			x1 = bx+1 < sw ? x0 + (1 << bgm_shift) : fgmask->width;
+
+			if(c[bx] != 1)
+			{
+				memset(out + x0, c[bx], x1 - x0);
+				continue;
+			}
+
+			for(x=x0; x<x1; x++)
+			{
+				count = 0;
+				for(k=0; k<VIBE_SAMPLES && count<VIBE_MATCHES; k++)
+				{
+					count += abs((MU_32S)in[x] - (MU_32S)vibe_buf->samples[k*slength + by*sw + bx]) < VIBE_RADIUS;
+				}
+				out[x] = count < VIBE_MATCHES ? 255 : 0;
+			}
+		}
+	}
+
+	free(any);
+}
+
 static muError_t muGMMBackgroundInit(MU_32U width, MU_32U height, gmm_buf_t *gmm_buf)
 {
 	if(!gmm_init_flag)
@@ -312,6 +627,7 @@ static muError_t muGMMBackgroundInit(MU_32U width, MU_32U height, gmm_buf_t *gmm
 	
 	gmm_init_flag = 1;
 	frame_count_gmm = 0;
+	g_height = 0;
 	return MU_ERR_SUCCESS;
 }
 
@@ -327,46 +643,244 @@ static muError_t muISBBackgroundInit(MU_32U width, MU_32U height, isb_buf_t *isb
 	
 	isb_init_flag = 1;
 	frame_count_isb = 0;
+	pre_entropy = 0;
 	return MU_ERR_SUCCESS;
 }
 
-muError_t muBackgroundModelingRelease()
+static muError_t muVIBEBackgroundInit(MU_32U width, MU_32U height, vibe_buf_t *vibe_buf)
+{
+	MU_32U i, r;
+
+	if(!vibe_init_flag)
+	{
+		printf("[MUGADGET] VIBE Background modeling init\n");
+		vibe_buf->samples = (MU_8U *)malloc(VIBE_SAMPLES*width*height*sizeof(MU_8U));
+		vibe_buf->mask = (MU_8U *)malloc(width*height*sizeof(MU_8U));
+		if(vibe_buf->samples == NULL || vibe_buf->mask == NULL)
+		{
+			free(vibe_buf->samples);
+			free(vibe_buf->mask);
+			return MU_ERR_OUT_OF_MEMORY;
+		}
+	}
+
+	vibe_buf->rng = 2463534242U;
+	for(i=0; i<VIBE_TABLE; i++)
+	{
+		r = vibeRand(vibe_buf);
+		vibe_buf->jump[i] = (MU_8U)(1 + r%(2*VIBE_SUBSAMPLE-1));
+		vibe_buf->sample[i] = (MU_8U)((r>>8)%VIBE_SAMPLES);
+		do
+		{
+			r = vibeRand(vibe_buf);
+			vibe_buf->neighbor[i][0] = (MU_32S)(r%3) - 1;
+			vibe_buf->neighbor[i][1] = (MU_32S)((r>>8)%3) - 1;
+		}while(vibe_buf->neighbor[i][0] == 0 && vibe_buf->neighbor[i][1] == 0);
+	}
+
+	vibe_init_flag = 1;
+	frame_count_vibe = 0;
+	return MU_ERR_SUCCESS;
+}
+
+//frees the buffers of every initialized model, the next init allocates them again
+static MU_VOID releaseModels(MU_VOID)
 {
 	if(gmm_init_flag)
 	{
 		free(gmm_buf.mean);
 		free(gmm_buf.std);
 		free(gmm_buf.weight);
+		gmm_init_flag = 0;
 	}
-	else if(isb_init_flag)
+
+	if(isb_init_flag)
 	{
 		free(isb_buf.pre_bg);
 		free(isb_buf.bg_light);
 		free(isb_buf.bg_dark);
+		isb_init_flag = 0;
+	}
+
+	if(vibe_init_flag)
+	{
+		free(vibe_buf.samples);
+		free(vibe_buf.mask);
+		vibe_init_flag = 0;
 	}
+}
+
+muError_t muBackgroundModelingRelease()
+{
+	releaseModels();
+	releaseMultiRes();
 	
 	return MU_ERR_SUCCESS;
 }
 
 
+//nearest neighbour warp of one model plane, dst(x,y) = src(m*(x,y)), border replicated
+static MU_VOID warpPlane(MU_VOID *plane, MU_VOID *tmp, MU_32S elemsize, const MU_64F *m)
+{
+	MU_32S x, y, sx, sy;
+	MU_32S w = bgm_width, h = bgm_height;
+	MU_8U *src = (MU_8U *)plane;
+	MU_8U *dst = (MU_8U *)tmp;
+
+	for(y=0; y<h; y++)
+	{
+		for(x=0; x<w; x++)
+		{
+			sx = (MU_32S)floor(m[0]*x + m[1]*y + m[2] + 0.5);
+			sy = (MU_32S)floor(m[3]*x + m[4]*y + m[5] + 0.5);
+			sx = sx < 0 ? 0 : (sx >= w ? w-1 : sx);
+			sy = sy < 0 ? 0 : (sy >= h ? h-1 : sy);
+			memcpy(dst + (y*w + x)*elemsize, src + (sy*w + sx)*elemsize, elemsize);
+		}
+	}
+
+	memcpy(plane, tmp, w*h*elemsize);
+}
+
+//move the model of the previous frame onto the current one after a camera motion,
+//m is the muEstimateGlobalMotion result (previous -> current)
+muError_t muBackgroundModelingCompensate(const MU_64F *m)
+{
+	MU_64F inv[6];
+	MU_VOID *tmp;
+
+	if(m == NULL)
+	{
+		return MU_ERR_NULL_POINTER;
+	}
+
+	if(!gmm_init_flag && !isb_init_flag && !vibe_init_flag)
+	{
+		return MU_ERR_INVALID_PARAMETER;
+	}
+
+	//nothing to do for a still camera
+	if(fabs(m[0]-1) < 1e-6 && fabs(m[1]) < 1e-6 && fabs(m[2]) < 1e-3 &&
+	   fabs(m[3]) < 1e-6 && fabs(m[4]-1) < 1e-6 && fabs(m[5]) < 1e-3)
+	{
+		return MU_ERR_SUCCESS;
+	}
+
+	if(muInvertAffine(m, inv))
+	{
+		return MU_ERR_INVALID_PARAMETER;
+	}
+
+	//m is in frame coordinates, the model may be downscaled
+	inv[2] /= 1 << bgm_shift;
+	inv[5] /= 1 << bgm_shift;
+
+	tmp = malloc(bgm_width*bgm_height*sizeof(MU_64F));
+	if(tmp == NULL)
+	{
+		return MU_ERR_OUT_OF_MEMORY;
+	}
+
+	if(gmm_init_flag && frame_count_gmm > 0)
+	{
+		warpPlane(gmm_buf.mean, tmp, sizeof(MU_64F), inv);
+		warpPlane(gmm_buf.std, tmp, sizeof(MU_64F), inv);
+		warpPlane(gmm_buf.weight, tmp, sizeof(MU_64F), inv);
+	}
+
+	if(isb_init_flag && frame_count_isb > 0)
+	{
+		warpPlane(isb_buf.pre_bg, tmp, sizeof(MU_8U), inv);
+		warpPlane(isb_buf.bg_light, tmp, sizeof(MU_8U), inv);
+		warpPlane(isb_buf.bg_dark, tmp, sizeof(MU_8U), inv);
+	}
+
+	if(vibe_init_flag && frame_count_vibe > 0)
+	{
+		MU_32U k;
+		for(k=0; k<VIBE_SAMPLES; k++)
+		{
+			warpPlane(vibe_buf.samples + k*bgm_width*bgm_height, tmp, sizeof(MU_8U), inv);
+		}
+	}
+
+	free(tmp);
+
+	return MU_ERR_SUCCESS;
+}
+
 /* TODO reset type for moultiple background modeling*/
 muError_t muBackgroundModelingReset()
 {
 	frame_count_gmm = 0;
 	frame_count_isb = 0;
+	frame_count_vibe = 0;
+	g_height = 0;
+	pre_entropy = 0;
+
+	return MU_ERR_SUCCESS;
 }
 
 
 muError_t muBackgroundModelingInit(MU_32U width, MU_32U height, MU_32U type)
 {
+	return muBackgroundModelingInitMultiRes(width, height, type, 1);
+}
+
+//the model runs at width/factor x height/factor (factor 1, 2 or 4), the frames are box
+//downscaled on the way in and the background/foreground scaled back to width x height
+muError_t muBackgroundModelingInitMultiRes(MU_32U width, MU_32U height, MU_32U type, MU_32U factor)
+{
+	MU_32U shift;
+
+	switch(factor)
+	{
+		case 1: shift = 0; break;
+		case 2: shift = 1; break;
+		case 4: shift = 2; break;
+		default:
+			return MU_ERR_INVALID_PARAMETER;
+	}
+
+	if((width >> shift) == 0 || (height >> shift) == 0)
+	{
+		return MU_ERR_INVALID_PARAMETER;
+	}
+
+	//the model buffers are sized to the model, a new size allocates them again
+	if((width >> shift) != bgm_width || (height >> shift) != bgm_height)
+	{
+		releaseModels();
+	}
+
+	releaseMultiRes();
+	bgm_shift = shift;
+	bgm_full_width = width;
+	bgm_full_height = height;
+	bgm_width = width >> shift;
+	bgm_height = height >> shift;
+
+	if(shift)
+	{
+		bgm_small_cur = muCreateImage(muSize(bgm_width, bgm_height), MU_IMG_DEPTH_8U, 1);
+		bgm_small_bk = muCreateImage(muSize(bgm_width, bgm_height), MU_IMG_DEPTH_8U, 1);
+		if(bgm_small_cur == NULL || bgm_small_bk == NULL)
+		{
+			releaseMultiRes();
+			return MU_ERR_OUT_OF_MEMORY;
+		}
+	}
+
 	switch(type)
 	{
 		case MU_BGM_GMM:
-			muGMMBackgroundInit(width, height, &gmm_buf);
+			muGMMBackgroundInit(bgm_width, bgm_height, &gmm_buf);
 			break;
 		case MU_BGM_ISB:
-			muISBBackgroundInit(width, height, &isb_buf);
+			muISBBackgroundInit(bgm_width, bgm_height, &isb_buf);
 			break;
+		case MU_BGM_VIBE:
+			return muVIBEBackgroundInit(bgm_width, bgm_height, &vibe_buf);
 		default:
 			printf("none support this type %d\n", type);
 			break;
@@ -376,11 +890,14 @@ muError_t muBackgroundModelingInit(MU_32U width, MU_32U height, MU_32U type)
 }
 
 
-muError_t muBackgroundModeling(muImage_t *curimg, muImage_t *bkimg)
+//one frame of the active models, cur is the frame at the model size
+static muError_t updateModels(const muImage_t *cur, muImage_t *bkimg)
 {
+	muImage_t *bk = bgm_shift ? bgm_small_bk : bkimg;
+
 	if(gmm_init_flag)
 	{
-		if(muBackgroundModelingGMM(curimg, bkimg, &gmm_buf))
+		if(muBackgroundModelingGMM(cur, bk, &gmm_buf))
 		{
 			printf("[MUGADGET] GMM init bg Error\n");
 		}
@@ -390,7 +907,7 @@ muError_t muBackgroundModeling(muImage_t *curimg, muImage_t *bkimg)
 	
 	if(isb_init_flag)
 	{
-		if(muBackgroundModelingISB(curimg, bkimg, &isb_buf))
+		if(muBackgroundModelingISB(cur, bk, &isb_buf))
 		{
 			printf("[MUGADGET] GMM init ISB Error\n");
 		}
@@ -398,10 +915,402 @@ muError_t muBackgroundModeling(muImage_t *curimg, muImage_t *bkimg)
 		frame_count_isb++;
 	}
 
-	if(!isb_init_flag && !gmm_init_flag)
+	if(vibe_init_flag)
+	{
+		if(muBackgroundModelingVIBE(cur, bk, NULL, &vibe_buf))
+		{
+			printf("[MUGADGET] VIBE bg Error\n");
+		}
+
+		frame_count_vibe++;
+	}
+
+	if(!isb_init_flag && !gmm_init_flag && !vibe_init_flag)
 	{
 		printf("[MUGADGET] background modeling must init first\n");
 	}
 
+	if(bgm_shift)
+	{
+		upscaleNearest(bgm_small_bk, bkimg);
+	}
+
+	return MU_ERR_SUCCESS;
+}
+
+muError_t muBackgroundModeling(muImage_t *curimg, muImage_t *bkimg)
+{
+	if(bgm_shift)
+	{
+		if(curimg->width != bgm_full_width || curimg->height != bgm_full_height || curimg->channels != 1)
+		{
+			return MU_ERR_NOT_SUPPORT;
+		}
+		downscaleBox(curimg, bgm_small_cur);
+		return updateModels(bgm_small_cur, bkimg);
+	}
+
+	return updateModels(curimg, bkimg);
+}
+
+//same as muBackgroundModeling on the gray frame of ctx, a multi-resolution model takes the
+//pyramid level of its factor instead of downscaling the frame again (factor 4 is the 2x2
+//average of the 2x2 average, it may differ from the 4x4 box by one level of rounding)
+muError_t muBackgroundModelingFrame(muFrameContext_t *ctx, muImage_t *bkimg)
+{
+	const muImage_t *cur;
+
+	if(ctx == NULL || bkimg == NULL)
+	{
+		return MU_ERR_NULL_POINTER;
+	}
+
+	if(ctx->size.width != bgm_full_width || ctx->size.height != bgm_full_height)
+	{
+		return MU_ERR_NOT_SUPPORT;
+	}
+
+	cur = muFramePyramid(ctx, bgm_shift);
+	if(cur == NULL)
+	{
+		return MU_ERR_NOT_SUPPORT;
+	}
+
+	return updateModels(cur, bkimg);
+}
+
+//ViBe foreground of one frame, cur is the frame at the model size and full the frame at the
+//full size for the refinement of a multi-resolution model
+static muError_t updateForeground(const muImage_t *cur, const muImage_t *full, muImage_t *fgmask)
+{
+	muError_t ret;
+
+	if(bgm_shift)
+	{
+		ret = muBackgroundModelingVIBE(cur, NULL, NULL, &vibe_buf);
+		if(ret == MU_ERR_SUCCESS)
+		{
+			refineVIBE(full, fgmask, &vibe_buf);
+		}
+	}
+	else
+	{
+		ret = muBackgroundModelingVIBE(cur, NULL, fgmask, &vibe_buf);
+	}
+
+	if(ret == MU_ERR_SUCCESS)
+	{
+		frame_count_vibe++;
+	}
+
+	return ret;
+}
+
+//foreground mask (255) of the current frame, only the MU_BGM_VIBE model classifies pixels
+muError_t muBackgroundModelingForeground(muImage_t *curimg, muImage_t *fgmask)
+{
+	if(!vibe_init_flag)
+	{
+		return MU_ERR_NOT_SUPPORT;
+	}
+
+	if(fgmask == NULL || fgmask->width != bgm_full_width || fgmask->height != bgm_full_height || fgmask->channels != 1)
+	{
+		return MU_ERR_INVALID_PARAMETER;
+	}
+
+	if(bgm_shift)
+	{
+		if(curimg->width != bgm_full_width || curimg->height != bgm_full_height || curimg->channels != 1)
+		{
+			return MU_ERR_NOT_SUPPORT;
+		}
+		downscaleBox(curimg, bgm_small_cur);
+		return updateForeground(bgm_small_cur, curimg, fgmask);
+	}
+
+	return updateForeground(curimg, curimg, fgmask);
+}
+
+//same as muBackgroundModelingForeground on the gray frame and pyramid of ctx
+muError_t muBackgroundModelingForegroundFrame(muFrameContext_t *ctx, muImage_t *fgmask)
+{
+	const muImage_t *gray, *cur;
+
+	if(ctx == NULL)
+	{
+		return MU_ERR_NULL_POINTER;
+	}
+
+	if(!vibe_init_flag)
+	{
+		return MU_ERR_NOT_SUPPORT;
+	}
+
+	if(fgmask == NULL || fgmask->width != bgm_full_width || fgmask->height != bgm_full_height || fgmask->channels != 1)
+	{
+		return MU_ERR_INVALID_PARAMETER;
+	}
+
+	if(ctx->size.width != bgm_full_width || ctx->size.height != bgm_full_height)
+	{
+		return MU_ERR_NOT_SUPPORT;
+	}
+
+	gray = muFrameGray(ctx);
+	cur = muFramePyramid(ctx, bgm_shift);
+	if(gray == NULL || cur == NULL)
+	{
+		return MU_ERR_NOT_SUPPORT;
+	}
+
+	return updateForeground(cur, gray, fgmask);
+}
+
+//Model snapshot
+//64-byte header in native byte order (the magic word fails on the other one), then the
+//planes of the model back to back from offset 64, so a mapped file can be handed to
+//muBackgroundModelingLoad_Buf as it is
+#define BGM_SNAPSHOT_MAGIC 0x4742554D	//"MUBG"
+#define BGM_SNAPSHOT_VERSION 1
+#define BGM_SNAPSHOT_HEADER 64
+
+typedef struct bgm_snapshot
+{
+	MU_32U magic;
+	MU_32U version;
+	MU_32U header;			//bytes before the planes
+	MU_32U type;			//MU_BGM_*
+	MU_32U width, height;	//model
+	MU_32U full_width, full_height;
+	MU_32U shift;
+	MU_32U frame_count;
+	MU_32U planes;
+	MU_32U elemsize;
+	MU_32U rng;
+	MU_32U entropy[2];		//ISB: entropy of the previous frame (MU_64F bits)
+	MU_32U row;				//GMM: next row of the stepwise update
+}bgm_snapshot_t;
+
+//state of the active model as planes of width*height*elemsize bytes, returns the plane count
+static MU_32U snapshotPlanes(bgm_snapshot_t *hd, MU_8U **plane)
+{
+	MU_32U k;
+
+	memset(hd, 0, sizeof(bgm_snapshot_t));
+	hd->magic = BGM_SNAPSHOT_MAGIC;
+	hd->version = BGM_SNAPSHOT_VERSION;
+	hd->header = BGM_SNAPSHOT_HEADER;
+	hd->width = bgm_width;
+	hd->height = bgm_height;
+	hd->full_width = bgm_full_width;
+	hd->full_height = bgm_full_height;
+	hd->shift = bgm_shift;
+
+	if(gmm_init_flag)
+	{
+		hd->type = MU_BGM_GMM;
+		hd->frame_count = frame_count_gmm;
+		hd->planes = 3;
+		hd->elemsize = sizeof(MU_64F);
+		hd->row = g_height;
+		plane[0] = (MU_8U *)gmm_buf.mean;
+		plane[1] = (MU_8U *)gmm_buf.std;
+		plane[2] = (MU_8U *)gmm_buf.weight;
+	}
+	else if(isb_init_flag)
+	{
+		hd->type = MU_BGM_ISB;
+		hd->frame_count = frame_count_isb;
+		hd->planes = 3;
+		hd->elemsize = sizeof(MU_8U);
+		memcpy(hd->entropy, &pre_entropy, sizeof(MU_64F));
+		plane[0] = isb_buf.pre_bg;
+		plane[1] = isb_buf.bg_light;
+		plane[2] = isb_buf.bg_dark;
+	}
+	else if(vibe_init_flag)
+	{
+		hd->type = MU_BGM_VIBE;
+		hd->frame_count = frame_count_vibe;
+		hd->planes = VIBE_SAMPLES;
+		hd->elemsize = sizeof(MU_8U);
+		hd->rng = vibe_buf.rng;
+		for(k=0; k<VIBE_SAMPLES; k++)
+		{
+			plane[k] = vibe_buf.samples + k*bgm_width*bgm_height;
+		}
+	}
+
+	return hd->planes;
+}
+
+//the snapshot must come from a model of the same type and resolution as the initialized one
+static muError_t snapshotCheck(const bgm_snapshot_t *hd, const bgm_snapshot_t *cur)
+{
+	if(hd->magic != BGM_SNAPSHOT_MAGIC || hd->version != BGM_SNAPSHOT_VERSION || hd->header < sizeof(bgm_snapshot_t))
+	{
+		printf("[MUGADGET] not a background model snapshot (version %d)\n", BGM_SNAPSHOT_VERSION);
+		return MU_ERR_NOT_SUPPORT;
+	}
+
+	if(hd->type != cur->type || hd->planes != cur->planes || hd->elemsize != cur->elemsize ||
+	   hd->width != cur->width || hd->height != cur->height ||
+	   hd->full_width != cur->full_width || hd->full_height != cur->full_height || hd->shift != cur->shift)
+	{
+		printf("[MUGADGET] background model snapshot of type %d %dx%d/%d, model is type %d %dx%d/%d\n",
+			hd->type, hd->full_width, hd->full_height, 1 << hd->shift, cur->type, cur->full_width, cur->full_height, 1 << cur->shift);
+		return MU_ERR_INVALID_PARAMETER;
+	}
+
+	return MU_ERR_SUCCESS;
+}
+
+static MU_VOID snapshotRestore(const bgm_snapshot_t *hd)
+{
+	switch(hd->type)
+	{
+		case MU_BGM_GMM:
+			frame_count_gmm = hd->frame_count;
+			g_height = hd->row < bgm_height ? hd->row : 0;
+			break;
+		case MU_BGM_ISB:
+			frame_count_isb = hd->frame_count;
+			memcpy(&pre_entropy, hd->entropy, sizeof(MU_64F));
+			break;
+		case MU_BGM_VIBE:
+			frame_count_vibe = hd->frame_count;
+			vibe_buf.rng = hd->rng ? hd->rng : vibe_buf.rng;
+			memset(vibe_buf.mask, 0, bgm_width*bgm_height);
+			break;
+	}
+}
+
+muError_t muBackgroundModelingSave(FILE *fp)
+{
+	bgm_snapshot_t hd;
+	MU_8U *plane[VIBE_SAMPLES];
+	MU_8U pad[BGM_SNAPSHOT_HEADER];
+	MU_32U k, bytes;
+
+	if(fp == NULL)
+	{
+		return MU_ERR_NULL_POINTER;
+	}
+
+	if(!snapshotPlanes(&hd, plane))
+	{
+		return MU_ERR_INVALID_PARAMETER;
+	}
+
+	memset(pad, 0, sizeof(pad));
+	memcpy(pad, &hd, sizeof(bgm_snapshot_t));
+	if(fwrite(pad, 1, BGM_SNAPSHOT_HEADER, fp) != BGM_SNAPSHOT_HEADER)
+	{
+		return MU_ERR_INVALID_PARAMETER;
+	}
+
+	bytes = hd.width*hd.height*hd.elemsize;
+	for(k=0; k<hd.planes; k++)
+	{
+		if(fwrite(plane[k], 1, bytes, fp) != bytes)
+		{
+			return MU_ERR_INVALID_PARAMETER;
+		}
+	}
+
+	return MU_ERR_SUCCESS;
+}
+
+//the model has to be initialized with the type and resolution of the snapshot first
+muError_t muBackgroundModelingLoad(FILE *fp)
+{
+	bgm_snapshot_t hd, cur;
+	MU_8U *plane[VIBE_SAMPLES];
+	MU_32U k, bytes;
+	muError_t ret;
+
+	if(fp == NULL)
+	{
+		return MU_ERR_NULL_POINTER;
+	}
+
+	if(!snapshotPlanes(&cur, plane))
+	{
+		return MU_ERR_INVALID_PARAMETER;
+	}
+
+	if(fread(&hd, sizeof(bgm_snapshot_t), 1, fp) != 1)
+	{
+		return MU_ERR_NOT_SUPPORT;
+	}
+
+	ret = snapshotCheck(&hd, &cur);
+	if(ret)
+	{
+		return ret;
+	}
+
+	fseek(fp, hd.header - sizeof(bgm_snapshot_t), SEEK_CUR);
+
+	bytes = hd.width*hd.height*hd.elemsize;
+	for(k=0; k<hd.planes; k++)
+	{
+		if(fread(plane[k], 1, bytes, fp) != bytes)
+		{
+			//a partial model is not usable, start over
+			muBackgroundModelingReset();
+			return MU_ERR_NOT_SUPPORT;
+		}
+	}
+
+	snapshotRestore(&hd);
+
+	return MU_ERR_SUCCESS;
+}
+
+//snapshot in memory (e.g. a mapped file) of size bytes
+muError_t muBackgroundModelingLoad_Buf(const MU_8U *buf, MU_32U size)
+{
+	bgm_snapshot_t hd, cur;
+	MU_8U *plane[VIBE_SAMPLES];
+	MU_32U k, bytes;
+	muError_t ret;
+
+	if(buf == NULL)
+	{
+		return MU_ERR_NULL_POINTER;
+	}
+
+	if(!snapshotPlanes(&cur, plane))
+	{
+		return MU_ERR_INVALID_PARAMETER;
+	}
+
+	if(size < sizeof(bgm_snapshot_t))
+	{
+		return MU_ERR_NOT_SUPPORT;
+	}
+	memcpy(&hd, buf, sizeof(bgm_snapshot_t));
+
+	ret = snapshotCheck(&hd, &cur);
+	if(ret)
+	{
+		return ret;
+	}
+
+	bytes = hd.width*hd.height*hd.elemsize;
+	if(size < hd.header || (size - hd.header)/bytes < hd.planes)
+	{
+		return MU_ERR_NOT_SUPPORT;
+	}
+
+	for(k=0; k<hd.planes; k++)
+	{
+		memcpy(plane[k], buf + hd.header + k*bytes, bytes);
+	}
+
+	snapshotRestore(&hd);
+
 	return MU_ERR_SUCCESS;
 }
@@ -34,7 +34,8 @@
 
 #include "muGadget.h"
 
-MU_32S muDetectCamTampering( const muImage_t* src, MU_32S flags, MU_32S sensitivity )
+// tampering of the downscaled frame, the 3x3 blocks are taken from pSmallImg
+static MU_32S detectTampering( const muImage_t* pSmallImg, MU_32S flags, MU_32S sensitivity )
 {
 	// parameter
 	int GradTH, HiGradNumTH;
@@ -66,13 +67,12 @@ MU_32S muDetectCamTampering( const muImage_t* src, MU_32S flags, MU_32S sensitiv
 	muDoubleThreshold_t dth = {0, 255};
 
 	// image
-	muImage_t *pSmallImg;  
 	muImage_t *pSubSrcImg;
 	muImage_t *pSubGradImg;
 	muRect_t ROI;
 
-    sub_block_w=src->width/3;
-    sub_block_h=src->height/3;
+    sub_block_w=pSmallImg->width/3;
+    sub_block_h=pSmallImg->height/3;
     
     
 	// set initial parameter
@@ -142,30 +142,6 @@ MU_32S muDetectCamTampering( const muImage_t* src, MU_32S flags, MU_32S sensitiv
 		return 0;
 	}
 
-	// down scale image
-	if( src->width >= 640 )
-	{
-		if(src->height >= 480) // D1/ 4CIF/ VGA
-		{
-			pSmallImg = muCreateImage( muSize(src->width/4, src->height/4), MU_IMG_DEPTH_8U, 1 );
-			muDownScale(src, pSmallImg, 4, 4);
-		}
-		else // 2CIF
-		{
-			pSmallImg = muCreateImage( muSize(src->width/4, src->height/2), MU_IMG_DEPTH_8U, 1 );
-			muDownScale(src, pSmallImg, 2, 4);
-		}
-	}
-	else if( src->width >= 320 ) // CIF/ QVGA
-	{
-		pSmallImg = muCreateImage( muSize(src->width/2, src->height/2), MU_IMG_DEPTH_8U, 1 );
-		muDownScale(src, pSmallImg, 2, 2);
-	}
-	else // QCIF
-	{
-		pSmallImg = src;
-	}
-
 	// create image
 	pGradImg = muCreateImage( muGetSize(pSmallImg), MU_IMG_DEPTH_8U, 1 );
 	pSubSrcImg  = muCreateImage( muSize(sub_block_w, sub_block_h), MU_IMG_DEPTH_8U, 1 );
@@ -219,12 +195,6 @@ MU_32S muDetectCamTampering( const muImage_t* src, MU_32S flags, MU_32S sensitiv
 	muReleaseImage( &pSubSrcImg );
 	muReleaseImage( &pSubGradImg );
 
-	if(src != pSmallImg)
-	{
-		//printf("src!= pSmallImg\n");
-		muReleaseImage( &pSmallImg );
-	}
-
 	if( flags & MU_CAM_LOSTFOCUS )
 	{
 		for(i=0; i<9; i++)
@@ -267,3 +237,69 @@ MU_32S muDetectCamTampering( const muImage_t* src, MU_32S flags, MU_32S sensitiv
 
 	return Situation;
 }
+
+MU_32S muDetectCamTampering( const muImage_t* src, MU_32S flags, MU_32S sensitivity )
+{
+	muImage_t *pScaled;
+	MU_32S Situation;
+
+	if(sensitivity < 1 || sensitivity > 5 || !(flags&(MU_CAM_LOSTFOCUS|MU_CAM_OCCLUSION)))
+	{
+		return 0;
+	}
+
+	// down scale image
+	if( src->width >= 640 )
+	{
+		if(src->height >= 480) // D1/ 4CIF/ VGA
+		{
+			pScaled = muCreateImage( muSize(src->width/4, src->height/4), MU_IMG_DEPTH_8U, 1 );
+			muDownScale(src, pScaled, 4, 4);
+		}
+		else // 2CIF
+		{
+			pScaled = muCreateImage( muSize(src->width/4, src->height/2), MU_IMG_DEPTH_8U, 1 );
+			muDownScale(src, pScaled, 2, 4);
+		}
+	}
+	else if( src->width >= 320 ) // CIF/ QVGA
+	{
+		pScaled = muCreateImage( muSize(src->width/2, src->height/2), MU_IMG_DEPTH_8U, 1 );
+		muDownScale(src, pScaled, 2, 2);
+	}
+	else // QCIF
+	{
+		pScaled = NULL;
+	}
+
+	Situation = detectTampering(pScaled ? pScaled : src, flags, sensitivity);
+
+	if(pScaled)
+	{
+		muReleaseImage( &pScaled );
+	}
+
+	return Situation;
+}
+
+// same as muDetectCamTampering on the gray frame of ctx, the downscaled frame is the
+// pyramid level of the same width (2CIF is quartered vertically as well)
+MU_32S muDetectCamTampering_Frame( muFrameContext_t* ctx, MU_32S flags, MU_32S sensitivity )
+{
+	const muImage_t *pSmallImg;
+	MU_32S level;
+
+	if(ctx == NULL || sensitivity < 1 || sensitivity > 5 || !(flags&(MU_CAM_LOSTFOCUS|MU_CAM_OCCLUSION)))
+	{
+		return 0;
+	}
+
+	level = ctx->size.width >= 640 ? 2 : (ctx->size.width >= 320 ? 1 : 0);
+	pSmallImg = muFramePyramid(ctx, level);
+	if(pSmallImg == NULL)
+	{
+		return 0;
+	}
+
+	return detectTampering(pSmallImg, flags, sensitivity);
+}
@@ -0,0 +1,314 @@
+/*
+% MIT License
+%
+% Copyright (c) 2016 OneCV
+%
+% Permission is hereby granted, free of charge, to any person obtaining a copy
+% of this software and associated documentation files (the "Software"), to deal
+% in the Software without restriction, including without limitation the rights
+% to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+% copies of the Software, and to permit persons to whom the Software is
+% furnished to do so, subject to the following conditions:
+%
+% The above copyright notice and this permission notice shall be included in all
+% copies or substantial portions of the Software.
+%
+% THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+% IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+% FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+% AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+% LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+% OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+% SOFTWARE.
+*/
+
+/* ------------------------------------------------------------------------- /
+ *
+ * Module: muCorrelationtracker.c
+ * Author: Joe Lin
+ *
+ * Description:
+ *    MOSSE correlation filter tracker. The filter is learned online in the
+ *    frequency domain (mucore FFT), the peak-to-sidelobe ratio of the
+ *    response is the tracking confidence.
+ *
+ -------------------------------------------------------------------------- */
+
+#include "muGadget.h"
+
+#define MOSSE_MAX_PATCH 64         /* patch side in filter pixels, larger targets are sampled down */
+#define MOSSE_PADDING 2.0f         /* context around the target */
+#define MOSSE_LAMBDA 1e-2f         /* regularization of the filter denominator */
+#define MOSSE_SIDELOBE 5           /* half size of the peak area excluded from the sidelobe */
+
+//bilinear patch sampling around (cx, cy), log, zero mean/unit norm, cosine window
+static MU_VOID sampleMOSSEPatch(const muImage_t *img, MuCorrelationTracker *Tracker, MU_32F cx, MU_32F cy)
+{
+	MU_32S u, v, W = Tracker->PatchW, H = Tracker->PatchH;
+	MU_32F *p = Tracker->Patch;
+	MU_64F sum = 0, sq = 0;
+	MU_32F mean, norm;
+
+	for(v=0; v<H; v++)
+	{
+		MU_32F fy = cy + (v - H/2)*Tracker->Scale;
+		MU_32S y0, y1;
+		MU_32F wy;
+
+		fy = fy < 0 ? 0 : (fy > img->height-1 ? (MU_32F)(img->height-1) : fy);
+		y0 = (MU_32S)fy;
+		y1 = y0+1 < img->height ? y0+1 : y0;
+		wy = fy - y0;
+
+		for(u=0; u<W; u++)
+		{
+			MU_32F fx = cx + (u - W/2)*Tracker->Scale;
+			MU_32S x0, x1;
+			MU_32F wx, val;
+			const MU_8U *r0 = img->imagedata + y0*img->width, *r1 = img->imagedata + y1*img->width;
+
+			fx = fx < 0 ? 0 : (fx > img->width-1 ? (MU_32F)(img->width-1) : fx);
+			x0 = (MU_32S)fx;
+			x1 = x0+1 < img->width ? x0+1 : x0;
+			wx = fx - x0;
+
+			val = (1-wy)*((1-wx)*r0[x0] + wx*r0[x1]) + wy*((1-wx)*r1[x0] + wx*r1[x1]);
+			val = (MU_32F)log(val + 1.0);
+			p[v*W+u] = val;
+			sum += val;
+			sq += val*val;
+		}
+	}
+
+	mean = (MU_32F)(sum/(W*H));
+	norm = (MU_32F)sqrt(sq - sum*mean);
+	norm = norm > 1e-5f ? 1.f/norm : 0.f;
+
+	for(u=0; u<W*H; u++)
+		p[u] = (p[u] - mean)*norm*Tracker->Window[u];
+}
+
+MU_VOID muCorrelationTrackerRelease(MuCorrelationTracker *Tracker)
+{
+	if(Tracker == NULL)
+		return;
+
+	if(Tracker->Plan)
+		muReleaseFFTPlan(&Tracker->Plan);
+	free(Tracker->Spectrum);
+	free(Tracker->Window);
+	Tracker->Spectrum = NULL;
+	Tracker->Window = NULL;
+}
+
+muError_t muCorrelationTrackerInit(MuCorrelationTracker *Tracker, const muImage_t *img, muRect_t box)
+{
+	MU_32S u, v, W, H, n, cols;
+	MU_32F pw, ph, sigma, *g;
+	muError_t ret;
+
+	ret = muCheckDepth(2, img, MU_IMG_DEPTH_8U);
+	if(ret)
+	{
+		return ret;
+	}
+
+	if(Tracker == NULL)
+	{
+		return MU_ERR_NULL_POINTER;
+	}
+
+	if(img->channels != 1 || img->width <= 0 || img->height <= 0 || box.width <= 0 || box.height <= 0)
+	{
+		return MU_ERR_INVALID_PARAMETER;
+	}
+
+	memset(Tracker, 0, sizeof(MuCorrelationTracker));
+	Tracker->LearningRate = 0.125f;
+	Tracker->PSRThreshold = 7.0f;
+
+	//patch = padded target, sampled down to MOSSE_MAX_PATCH
+	pw = box.width*MOSSE_PADDING;
+	ph = box.height*MOSSE_PADDING;
+	Tracker->Scale = (pw > ph ? pw : ph)/MOSSE_MAX_PATCH;
+	Tracker->Scale = Tracker->Scale < 1 ? 1 : Tracker->Scale;
+	W = muGetOptimalFFTSize(muRound(pw/Tracker->Scale));
+	H = muGetOptimalFFTSize(muRound(ph/Tracker->Scale));
+	W += W & 1;
+	H += H & 1;
+	Tracker->PatchW = W;
+	Tracker->PatchH = H;
+	n = W*H;
+	cols = W/2+1;
+
+	Tracker->Plan = muCreateFFTPlan(W, H);
+	//G, A, B, F and the response spectra, window, patch, response
+	Tracker->Spectrum = (muComplex_t *)malloc(5*H*cols*sizeof(muComplex_t));
+	Tracker->Window = (MU_32F *)malloc(3*n*sizeof(MU_32F));
+	if(Tracker->Plan == NULL || Tracker->Spectrum == NULL || Tracker->Window == NULL)
+	{
+		muCorrelationTrackerRelease(Tracker);
+		return MU_ERR_OUT_OF_MEMORY;
+	}
+
+	Tracker->G = Tracker->Spectrum;
+	Tracker->A = Tracker->G + H*cols;
+	Tracker->B = Tracker->A + H*cols;
+	Tracker->F = Tracker->B + H*cols;
+	Tracker->Patch = Tracker->Window + n;
+	Tracker->Response = Tracker->Patch + n;
+
+	for(v=0; v<H; v++)
+	{
+		MU_32F wy = (MU_32F)(0.5 - 0.5*cos(2*MU_PI*v/(H-1)));
+		for(u=0; u<W; u++)
+			Tracker->Window[v*W+u] = wy*(MU_32F)(0.5 - 0.5*cos(2*MU_PI*u/(W-1)));
+	}
+
+	//desired response: gaussian peak at the patch center
+	g = Tracker->Response;
+	sigma = 0.1f*(MU_32F)sqrt((MU_64F)(box.width*box.height))/Tracker->Scale;
+	sigma = sigma < 1.f ? 1.f : sigma;
+	for(v=0; v<H; v++)
+		for(u=0; u<W; u++)
+			g[v*W+u] = (MU_32F)exp(-((u-W/2)*(u-W/2) + (v-H/2)*(v-H/2))/(2.0*sigma*sigma));
+	muFFTForward(Tracker->Plan, g, W, Tracker->G);
+
+	Tracker->Cx = box.x + box.width*0.5f;
+	Tracker->Cy = box.y + box.height*0.5f;
+	Tracker->Box = box;
+
+	//A = G conj(F), B = F conj(F) + lambda
+	sampleMOSSEPatch(img, Tracker, Tracker->Cx, Tracker->Cy);
+	muFFTForward(Tracker->Plan, Tracker->Patch, W, Tracker->F);
+	for(u=0; u<H*cols; u++)
+	{
+		muComplex_t f = Tracker->F[u], gg = Tracker->G[u];
+		Tracker->A[u].re = gg.re*f.re + gg.im*f.im;
+		Tracker->A[u].im = gg.im*f.re - gg.re*f.im;
+		Tracker->B[u].re = f.re*f.re + f.im*f.im + MOSSE_LAMBDA;
+		Tracker->B[u].im = 0;
+	}
+
+	Tracker->Confidence = 0;
+	Tracker->Lost = 0;
+
+	return MU_ERR_SUCCESS;
+}
+
+muError_t muCorrelationTrackerUpdate(MuCorrelationTracker *Tracker, const muImage_t *img, muRect_t *box, MU_32F *psr)
+{
+	MU_32S u, v, W, H, cols, px = 0, py = 0, cnt = 0;
+	MU_32F *r, best, dx, dy, eta;
+	muComplex_t *R;
+	MU_64F sum = 0, sq = 0, mean, sd;
+	muError_t ret;
+
+	ret = muCheckDepth(2, img, MU_IMG_DEPTH_8U);
+	if(ret)
+	{
+		return ret;
+	}
+
+	if(Tracker == NULL || Tracker->Plan == NULL)
+	{
+		return MU_ERR_NULL_POINTER;
+	}
+
+	//the filter was learned on a gray frame; sampling another layout makes it drift
+	if(img->channels != 1 || img->width <= 0 || img->height <= 0)
+	{
+		return MU_ERR_INVALID_PARAMETER;
+	}
+
+	W = Tracker->PatchW;
+	H = Tracker->PatchH;
+	cols = W/2+1;
+	r = Tracker->Response;
+	R = Tracker->F + H*cols;
+
+	//response = IFFT(F * A/B)
+	sampleMOSSEPatch(img, Tracker, Tracker->Cx, Tracker->Cy);
+	muFFTForward(Tracker->Plan, Tracker->Patch, W, Tracker->F);
+	for(u=0; u<H*cols; u++)
+	{
+		muComplex_t f = Tracker->F[u], a = Tracker->A[u];
+		MU_32F ib = 1.f/Tracker->B[u].re;
+		R[u].re = (f.re*a.re - f.im*a.im)*ib;
+		R[u].im = (f.re*a.im + f.im*a.re)*ib;
+	}
+	muFFTInverse(Tracker->Plan, R, r, W);
+
+	best = r[0];
+	for(u=1; u<W*H; u++)
+	{
+		if(r[u] > best)
+		{
+			best = r[u];
+			px = u % W;
+			py = u / W;
+		}
+	}
+
+	//peak-to-sidelobe ratio, the sidelobe excludes the area around the peak
+	for(v=0; v<H; v++)
+	{
+		for(u=0; u<W; u++)
+		{
+			if(abs(u-px) <= MOSSE_SIDELOBE && abs(v-py) <= MOSSE_SIDELOBE)
+				continue;
+			sum += r[v*W+u];
+			sq += r[v*W+u]*r[v*W+u];
+			cnt++;
+		}
+	}
+	mean = cnt ? sum/cnt : 0;
+	sd = cnt ? sqrt(sq/cnt - mean*mean) : 0;
+	Tracker->Confidence = sd > 1e-9 ? (MU_32F)((best - mean)/sd) : 0.f;
+	Tracker->Lost = Tracker->Confidence < Tracker->PSRThreshold;
+
+	if(psr)
+		*psr = Tracker->Confidence;
+
+	if(!Tracker->Lost)
+	{
+		//sub pixel peak by parabola fitting
+		dx = (MU_32F)(px - W/2);
+		dy = (MU_32F)(py - H/2);
+		if(px > 0 && px < W-1)
+		{
+			MU_32F l = r[py*W+px-1], c = best, rr = r[py*W+px+1], d = l - 2*c + rr;
+			dx += d < 0 ? 0.5f*(l - rr)/d : 0;
+		}
+		if(py > 0 && py < H-1)
+		{
+			MU_32F t = r[(py-1)*W+px], c = best, b = r[(py+1)*W+px], d = t - 2*c + b;
+			dy += d < 0 ? 0.5f*(t - b)/d : 0;
+		}
+
+		Tracker->Cx += dx*Tracker->Scale;
+		Tracker->Cy += dy*Tracker->Scale;
+		Tracker->Cx = Tracker->Cx < 0 ? 0 : (Tracker->Cx > img->width-1 ? img->width-1 : Tracker->Cx);
+		Tracker->Cy = Tracker->Cy < 0 ? 0 : (Tracker->Cy > img->height-1 ? img->height-1 : Tracker->Cy);
+
+		Tracker->Box.x = muRound(Tracker->Cx - Tracker->Box.width*0.5f);
+		Tracker->Box.y = muRound(Tracker->Cy - Tracker->Box.height*0.5f);
+
+		//running average of the filter at the new position
+		eta = Tracker->LearningRate;
+		sampleMOSSEPatch(img, Tracker, Tracker->Cx, Tracker->Cy);
+		muFFTForward(Tracker->Plan, Tracker->Patch, W, Tracker->F);
+		for(u=0; u<H*cols; u++)
+		{
+			muComplex_t f = Tracker->F[u], gg = Tracker->G[u];
+			Tracker->A[u].re = (1-eta)*Tracker->A[u].re + eta*(gg.re*f.re + gg.im*f.im);
+			Tracker->A[u].im = (1-eta)*Tracker->A[u].im + eta*(gg.im*f.re - gg.re*f.im);
+			Tracker->B[u].re = (1-eta)*Tracker->B[u].re + eta*(f.re*f.re + f.im*f.im + MOSSE_LAMBDA);
+		}
+	}
+
+	if(box)
+		*box = Tracker->Box;
+
+	return MU_ERR_SUCCESS;
+}
@@ -0,0 +1,187 @@
+/*
+% MIT License
+%
+% Copyright (c) 2016 OneCV
+%
+% Permission is hereby granted, free of charge, to any person obtaining a copy
+% of this software and associated documentation files (the "Software"), to deal
+% in the Software without restriction, including without limitation the rights
+% to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+% copies of the Software, and to permit persons to whom the Software is
+% furnished to do so, subject to the following conditions:
+%
+% The above copyright notice and this permission notice shall be included in all
+% copies or substantial portions of the Software.
+%
+% THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+% IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+% FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+% AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+% LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+% OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+% SOFTWARE.
+*/
+
+/* ------------------------------------------------------------------------- /
+ *
+ * Module: muDetectquality.c
+ * Author: Joe Lin
+ *
+ * Description:
+ *    Deadline-aware detection: the cost of every detection call is measured
+ *    against a per-frame budget, the quality level steps down (coarser scales,
+ *    larger stride, larger minimum size, ROI tiling, frame skip) when the
+ *    budget is exceeded and back up when there is headroom again.
+ *
+ -------------------------------------------------------------------------- */
+
+#include "muGadget.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#define QUALITY_ALPHA 0.3       //cost smoothing
+#define QUALITY_HEADROOM 0.6    //cost below budget*headroom counts as calm
+#define QUALITY_CALM 30         //calm calls before a level up
+#define QUALITY_HOLD 3          //calls after a change before the next level down
+
+//Degradation ladder, one entry per level
+static const struct
+{
+    double scaleStep;   //scale factor step, multiple of the base step
+    int stride;         //scan step of the small scales
+    double minSize;     //minimum size, multiple of the base (or of the cascade window)
+    int tiles;          //ROI strips, one scanned per call
+    int skip;           //frames skipped between detections
+} qualityLadder[MU_QUALITY_LEVELS] =
+{
+    { 1.0, 2, 1.0, 1, 0 },
+    { 1.5, 2, 1.0, 1, 0 },
+    { 1.5, 3, 1.0, 1, 0 },
+    { 1.5, 3, 1.5, 1, 0 },
+    { 2.0, 4, 1.5, 1, 0 },
+    { 2.0, 4, 1.5, 2, 0 },
+    { 2.0, 4, 2.0, 2, 1 },
+    { 3.0, 4, 2.0, 4, 2 },
+};
+
+static double qualityNow(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER t, f;
+    QueryPerformanceCounter(&t);
+    QueryPerformanceFrequency(&f);
+    return t.QuadPart*1000.0/f.QuadPart;
+#else
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec*1000.0 + t.tv_nsec/1000000.0;
+#endif
+}
+
+//Parameters of the current level
+static void qualityApply(MuDetectQuality *q)
+{
+    q->scaleFactor = 1 + (q->baseScaleFactor - 1)*qualityLadder[q->level].scaleStep;
+    q->stride = qualityLadder[q->level].stride;
+    q->minSize.width = (int)(q->baseMinSize.width*qualityLadder[q->level].minSize);
+    q->minSize.height = (int)(q->baseMinSize.height*qualityLadder[q->level].minSize);
+    q->maxSize = q->baseMaxSize;
+    q->tiles = qualityLadder[q->level].tiles;
+    q->skip = qualityLadder[q->level].skip;
+    q->tile = 0;
+}
+
+//budget in ms per frame, the other parameters are those of full quality (level 0)
+void muDetectQualityInit(MuDetectQuality *q, double budget, double scaleFactor, muSize_t minSize, muSize_t maxSize)
+{
+    memset(q, 0, sizeof(MuDetectQuality));
+    q->budget = budget;
+    q->baseScaleFactor = scaleFactor;
+    q->baseMinSize = minSize;
+    q->baseMaxSize = maxSize;
+    q->level = 0;
+    qualityApply(q);
+}
+
+//Cost of one detection call (ms), for callers who time the detection themselves
+void muDetectQualityUpdate(MuDetectQuality *q, double ms)
+{
+    double cost;
+
+    q->cost = q->cost > 0 ? (1 - QUALITY_ALPHA)*q->cost + QUALITY_ALPHA*ms : ms;
+    cost = q->cost/(q->skip + 1);   //per frame
+
+    if( q->hold > 0 )
+        q->hold--;
+
+    if( cost > q->budget )
+    {
+        q->calm = 0;
+        if( q->hold == 0 && q->level < MU_QUALITY_LEVELS-1 )
+        {
+            q->level++;
+            q->hold = QUALITY_HOLD;
+            qualityApply(q);
+        }
+    }
+    else if( cost < q->budget*QUALITY_HEADROOM )
+    {
+        if( ++q->calm >= QUALITY_CALM && q->level > 0 )
+        {
+            q->level--;
+            q->calm = 0;
+            q->hold = QUALITY_HOLD;
+            qualityApply(q);
+        }
+    }
+    else
+    {
+        q->calm = 0;
+    }
+}
+
+//Object Detection under the deadline of q
+//muObjectDetection_Light with the parameters of the current level. Returns 0 for a skipped frame.
+//With tiling one horizontal strip of ScanROI is scanned per call, the strips overlap by the
+//largest window, which is limited to half of the ROI height.
+MU_32S muObjectDetection_Quality(MuDetectQuality *q, muIntegralImg_t *Itlmg, muRect_t ScanROI, muSeq_t *Objects, MuSimpleDetector *cascade)
+{
+    muSize_t maxSize = q->maxSize;
+    double start;
+    double minScale = qualityLadder[q->level].minSize;
+
+    //the minimum size is raised relative to the cascade window when the base is smaller
+    if( q->minSize.width < muRound(cascade->orig_window_size.width*minScale) )
+        q->minSize.width = muRound(cascade->orig_window_size.width*minScale);
+    if( q->minSize.height < muRound(cascade->orig_window_size.height*minScale) )
+        q->minSize.height = muRound(cascade->orig_window_size.height*minScale);
+
+    q->frame++;
+    if( q->skip && q->frame % (q->skip + 1) )
+        return 0;
+
+    if( q->tiles > 1 )
+    {
+        int strip = (ScanROI.height + q->tiles - 1)/q->tiles;
+        int overlap = ScanROI.height/2;
+        int bottom = ScanROI.y + ScanROI.height;
+
+        overlap = maxSize.height < overlap ? maxSize.height : overlap;
+        maxSize.height = overlap;
+
+        ScanROI.y += q->tile*strip;
+        ScanROI.height = strip + overlap;
+        ScanROI.height = ScanROI.y + ScanROI.height > bottom ? bottom - ScanROI.y : ScanROI.height;
+        q->tile = (q->tile + 1) % q->tiles;
+    }
+
+    start = qualityNow();
+    muObjectDetection_LightStride(Itlmg, ScanROI, Objects, cascade, q->scaleFactor, q->minSize, maxSize, q->stride);
+    muDetectQualityUpdate(q, qualityNow() - start);
+
+    return 1;
+}
@@ -124,6 +124,241 @@ void muTrackRectangles(muSeq_t *Objects, muSeq_t *Trackers)
 	}
 }
 
+//Scan ROIs of the detectors: the mark scans ExamData.ScanROI, tag i scans around its taught
+//offset from the mark (ROI relative to the tracked mark, half a tag of margin on each side)
+static void Examinator_SetScanROI(MuExaminator *Examinator)
+{
+	MuTag *Tag = Examinator->ExamData.Tag;
+	int i;
+
+	Examinator->Detector[0].ScanROI = Examinator->ExamData.ScanROI;
+	for(i=1; i<Examinator->ExamData.TagNum; i++)
+	{
+		Examinator->Detector[i].ScanROI = muRect(Tag[i].x - Tag[0].x - Tag[i].width/2,
+		                                         Tag[i].y - Tag[0].y - Tag[i].height/2,
+		                                         Tag[i].width*2, Tag[i].height*2);
+	}
+}
+
+//Run detector i over ScanROI, then merge and track its detection results
+static void Examinator_Detect(MuExaminator *Examinator, int i, muRect_t ScanROI)
+{
+	muSize_t min, max;
+
+	//Detector para
+	min.width = Examinator->ExamData.Tag[i].width;
+	min.height = Examinator->ExamData.Tag[i].height;
+	max.width = (double)min.width*1.1;
+	max.height = (double)min.height*1.1;
+	
+	//Initialize object sequences
+	if(Examinator->Detector[i].Objects!=NULL)
+	{
+	    muClearSeq(&(Examinator->Detector[i].Objects));
+	    Examinator->Detector[i].Objects=NULL;
+	}
+	Examinator->Detector[i].Objects = muCreateSeq(sizeof(muRect_t));
+
+	//muObjectDetection_Light
+	//muObjectDetection_Light(Examinator->Itlmg, ScanROI, Examinator->Detector[i].Objects, &(Examinator->Detector[i].Cascade), 1.1, min, max);
+	muObjectDetection_SuperLight(Examinator->Itlmg, ScanROI, Examinator->Detector[i].Objects, &(Examinator->Detector[i].Cascade), min);
+	//Merge and Track detection results
+	muMergeRectangles(Examinator->Detector[i].Objects, 2, 2);
+	muTrackRectangles(Examinator->Detector[i].Objects, Examinator->Detector[i].Tracks);
+}
+
+//Cascade table value, the table may be unaligned in a loaded buffer
+static double Examinator_TableAt(const MU_8U *table, long index)
+{
+	double v;
+	memcpy(&v, table + index*sizeof(double), sizeof(double));
+	return v;
+}
+
+//Count stages and classifiers of a cascade table (muObjectDetectionInit layout), -1 if it overruns size
+static int Examinator_CountModel(const MU_8U *table, int size, int *stages, int *classifiers)
+{
+	long index = 2;
+	int i, j, k, count, nodes, rn;
+
+	if(size < 3)
+		return -1;
+
+	*stages = (int)Examinator_TableAt(table, index++);
+	*classifiers = 0;
+	for(i=0; i<*stages; i++)
+	{
+		if(index >= size)
+			return -1;
+		count = (int)Examinator_TableAt(table, index++);
+		*classifiers += count;
+		for(j=0; j<count; j++)
+		{
+			if(index >= size)
+				return -1;
+			nodes = (int)Examinator_TableAt(table, index++);
+			for(k=0; k<nodes; k++)
+			{
+				if(index >= size)
+					return -1;
+				rn = (int)Examinator_TableAt(table, index++);
+				if(rn != 2 && rn != 3)
+					return -1;
+				index += rn*5 + 4; //rects, tilted, threshold, left, right
+			}
+		}
+		index += 3; //threshold, parent, next
+	}
+
+	return (*stages > 0 && index <= size) ? 0 : -1;
+}
+
+//Parse a cascade table into stages followed by their classifiers, the table must be aligned
+static void Examinator_Parse(MuSimpleDetector *Cascade, MuHaarStageClassifier *stages, int stageNum, const double *table)
+{
+	memset(Cascade, 0, sizeof(MuSimpleDetector));
+	muObjectDetectionInit(Cascade, stages, (MuHaarClassifier *)(stages + stageNum), (double *)table);
+}
+
+//Model of a cascade table. Without a cache the model is private: it holds the parsed stages and
+//classifiers its detector runs on, the table is not kept (an unaligned loading buffer is parsed
+//from a temporary copy). With a cache the model holds the table only, an identical table loaded
+//later shares it and every detector parses its own stages from it
+static MuExamModel* Examinator_AcquireModel(const MU_8U *table, int size, MuExamModelCache *Cache)
+{
+	MuExamModel *Model;
+	MU_8U *arena;
+	double *aligned = NULL;
+	int stages, classifiers;
+
+	if(Cache != NULL)
+	{
+		for(Model = Cache->First; Model != NULL; Model = Model->Next)
+		{
+			if(Model->TableSize == size && memcmp(Model->Table, table, size*sizeof(double)) == 0)
+			{
+				Model->Refs++;
+				return Model;
+			}
+		}
+	}
+
+	if(Examinator_CountModel(table, size, &stages, &classifiers))
+		return NULL;
+
+	if(Cache != NULL)
+		arena = (MU_8U *)malloc(sizeof(MuExamModel) + size*sizeof(double));
+	else
+		arena = (MU_8U *)malloc(sizeof(MuExamModel) + stages*sizeof(MuHaarStageClassifier) +
+		                        classifiers*sizeof(MuHaarClassifier));
+	if(arena == NULL)
+		return NULL;
+
+	Model = (MuExamModel *)arena;
+	Model->Refs = 1;
+	Model->TableSize = size;
+	Model->StageNum = stages;
+	Model->ClassifierNum = classifiers;
+	Model->Table = NULL;
+	Model->Stages = NULL;
+	Model->Cache = Cache;
+	Model->Next = NULL;
+
+	if(Cache != NULL)
+	{
+		Model->Table = (double *)(arena + sizeof(MuExamModel));
+		memcpy(Model->Table, table, size*sizeof(double));
+		Model->Next = Cache->First;
+		Cache->First = Model;
+		return Model;
+	}
+
+	if((size_t)table % sizeof(double) != 0)
+	{
+		aligned = (double *)malloc(size*sizeof(double));
+		if(aligned == NULL)
+		{
+			free(arena);
+			return NULL;
+		}
+		memcpy(aligned, table, size*sizeof(double));
+	}
+
+	Model->Stages = (MuHaarStageClassifier *)(arena + sizeof(MuExamModel));
+	Examinator_Parse(&Model->Cascade, Model->Stages, stages, aligned ? aligned : (const double *)table);
+	free(aligned);
+
+	return Model;
+}
+
+static void Examinator_ReleaseModel(MuExamModel *Model)
+{
+	MuExamModel **link;
+
+	if(Model == NULL || --Model->Refs > 0)
+		return;
+
+	if(Model->Cache != NULL)
+	{
+		for(link = &Model->Cache->First; *link != NULL; link = &(*link)->Next)
+		{
+			if(*link == Model)
+			{
+				*link = Model->Next;
+				break;
+			}
+		}
+	}
+	free(Model);
+}
+
+//Stages of a detector: a private model is run directly, a cached model is only read, so the
+//detector parses its own stages and classifiers from the shared table for
+//muSetImagesForHaarClassifierCascade to write
+static int Examinator_SetStages(MuDetector *Detector, const MuExamModel *Model)
+{
+	if(Model->Stages != NULL)
+	{
+		Detector->Stages = NULL;
+		Detector->Cascade = Model->Cascade;
+		return 1;
+	}
+
+	Detector->Stages = (MuHaarStageClassifier *)malloc(Model->StageNum*sizeof(MuHaarStageClassifier) +
+	                                                   Model->ClassifierNum*sizeof(MuHaarClassifier));
+	if(Detector->Stages == NULL)
+		return 0;
+
+	Examinator_Parse(&Detector->Cascade, Detector->Stages, Model->StageNum, Model->Table);
+	return 1;
+}
+
+//Load detector i from its cascade table, 0 if the table is invalid
+static int Examinator_LoadDetector(MuExaminator *Examinator, int i, const MU_8U *table, MuExamModelCache *Cache)
+{
+	MuExamModel *Model;
+
+	Model = Examinator_AcquireModel(table, Examinator->ExamData.DetectorSize[i], Cache);
+	if(Model == NULL)
+	{
+		printf("Invalid detector table %d\n", i);
+		return 0;
+	}
+
+	if(!Examinator_SetStages(&Examinator->Detector[i], Model))
+	{
+		printf("Out of memory for detector %d\n", i);
+		Examinator_ReleaseModel(Model);
+		return 0;
+	}
+
+	Examinator->Detector[i].Model = Model;
+	Examinator->Detector[i].Objects=NULL;
+	Examinator->Detector[i].Status.State = 0;
+	Examinator->Detector[i].Status.Trigger = 0;
+	return 1;
+}
+
 void ExampleExaminatorMaker()
 {
 	double CascadeParaTable0[64] = {40, 25, 2, 1, 1, 3, 9, 3, 6, 16, -1, 9, 3, 3, 8, 2, 12, 11, 3, 8, 2, 0, 0.047854, -1.000000, 0.994061, 0.994061, -1, -1, 2, 1, 2, 4, 0, 28, 20, -1, 4, 5, 28, 10, 2, 0, 0.252720, -1.000000, 0.996030, 1, 2, 16, 10, 8, 8, -1, 16, 14, 8, 4, 2, 0, -0.042733, 0.992085, -0.999971, 1.988115, 0, -1};
@@ -173,8 +408,13 @@ void ExampleExaminatorMaker()
 
 void Examinator_Init_Buf(MU_8U *buf, MuExaminator *Examinator)
 {
-	MuExamData ExamData;
-	double CascadeParaTable[500];
+	Examinator_Init_Shared(buf, Examinator, NULL);
+}
+
+//Tables are parsed straight from buf into the models, Cache (or NULL) shares identical models
+//between examinators
+void Examinator_Init_Shared(MU_8U *buf, MuExaminator *Examinator, MuExamModelCache *Cache)
+{
 	MU_8U *buftmp = buf;
 	int i;
 
@@ -183,14 +423,13 @@ void Examinator_Init_Buf(MU_8U *buf, MuExaminator *Examinator)
 	buftmp+=sizeof(struct MuExamData);
 
     //Load Tables & init detector
-    
 	for(i=0; i<Examinator->ExamData.TagNum; i++)
 	{
-		memcpy(CascadeParaTable,buftmp,sizeof(double)*(Examinator->ExamData.DetectorSize[i]));
-        muObjectDetectionInit( &(Examinator->Detector[i].Cascade), Examinator->Detector[i].CascadeStages, Examinator->Detector[i].CascadeClassifiers, CascadeParaTable);
-        Examinator->Detector[i].Objects=NULL;
-        Examinator->Detector[i].Status.State = 0;
-        Examinator->Detector[i].Status.Trigger = 0;
+		if(!Examinator_LoadDetector(Examinator, i, buftmp, Cache))
+		{
+			Examinator->ExamData.TagNum = i;
+			break;
+		}
         buftmp+=sizeof(double)*(Examinator->ExamData.DetectorSize[i]);
 	}
 
@@ -204,6 +443,7 @@ void Examinator_Init_Buf(MU_8U *buf, MuExaminator *Examinator)
     //Scale
 
     //Scan Range ROI
+    Examinator_SetScanROI(Examinator);
 
     //Advance - Integral Images' Setting
     
@@ -212,8 +452,7 @@ void Examinator_Init_Buf(MU_8U *buf, MuExaminator *Examinator)
 void Examinator_Init(FILE *fp, MuExaminator *Examinator)
 {
 	FILE *ptr_myfile;
-	MuExamData ExamData;
-	double CascadeParaTable[500];
+	double *CascadeParaTable;
 	int i;
 
 	ptr_myfile=fopen("Examinator.dk","rb");
@@ -231,11 +470,16 @@ void Examinator_Init(FILE *fp, MuExaminator *Examinator)
     //Load Tables & init detector
 	for(i=0; i<Examinator->ExamData.TagNum; i++)
 	{
-		fread(CascadeParaTable,sizeof(double)*(Examinator->ExamData.DetectorSize[i]),1,ptr_myfile);
-        muObjectDetectionInit( &(Examinator->Detector[i].Cascade), Examinator->Detector[i].CascadeStages, Examinator->Detector[i].CascadeClassifiers, CascadeParaTable);
-        Examinator->Detector[i].Objects=NULL;
-        Examinator->Detector[i].Status.State = 0;
-        Examinator->Detector[i].Status.Trigger = 0;
+		CascadeParaTable = (double *)malloc(sizeof(double)*(Examinator->ExamData.DetectorSize[i]));
+		if(CascadeParaTable == NULL ||
+		   fread(CascadeParaTable,sizeof(double)*(Examinator->ExamData.DetectorSize[i]),1,ptr_myfile) != 1 ||
+		   !Examinator_LoadDetector(Examinator, i, (MU_8U *)CascadeParaTable, NULL))
+		{
+			free(CascadeParaTable);
+			Examinator->ExamData.TagNum = i;
+			break;
+		}
+		free(CascadeParaTable);
 	}
     fclose(ptr_myfile);
 
@@ -249,6 +493,7 @@ void Examinator_Init(FILE *fp, MuExaminator *Examinator)
     //Scale
 
     //Scan Range ROI
+    Examinator_SetScanROI(Examinator);
 
     //Advance - Integral Images' Setting
     
@@ -256,51 +501,25 @@ void Examinator_Init(FILE *fp, MuExaminator *Examinator)
 
 void Examinator_Run(muImage_t *src, MuExaminator *Examinator)
 {
-	//For Run detectors
-	muSize_t min, max;
-	muSize_t imgSize;
-
 	//For Check Mark
 	muSeq_t *Trackers;
-	MuTracker *tracp;
+	MuTracker *tracp, *markp;
 	muSeqBlock_t *current;
+	muRect_t ScanROI;
 
 	//For Scan
 	unsigned char scanflag;
 	int i; //For fors
 
-	//Create and calculate integral img
-	Examinator->Itlmg = muIntegral_Light(src);
+	//Create and calculate integral img of the scan region only, the detector windows stay inside it
+	Examinator->Itlmg = muIntegral_LightROI(src, Examinator->ExamData.ScanROI, muSize(0, 0));
 	
-	//Run cascase detectors
-	for(i=0;i<Examinator->ExamData.TagNum;i++)
-	{
-		//Detector para
-		min.width = Examinator->ExamData.Tag[i].width;
-		min.height = Examinator->ExamData.Tag[i].height;
-		max.width = (double)min.width*1.1;
-		max.height = (double)min.height*1.1;
-		
-		//Initialize object sequences
-		if(Examinator->Detector[i].Objects!=NULL)
-		{
-		    muClearSeq(&(Examinator->Detector[i].Objects));
-		    Examinator->Detector[i].Objects=NULL;
-		}
-		Examinator->Detector[i].Objects = muCreateSeq(sizeof(muRect_t));
-
-		//muObjectDetection_Light
-		//muObjectDetection_Light(Examinator->Itlmg, Examinator->ExamData.ScanROI, Examinator->Detector[i].Objects, &(Examinator->Detector[i].Cascade), 1.1, min, max);
-		muObjectDetection_SuperLight(Examinator->Itlmg, Examinator->ExamData.ScanROI, Examinator->Detector[i].Objects, &(Examinator->Detector[i].Cascade), min);
-		//Merge and Track detection results
-		muMergeRectangles(Examinator->Detector[i].Objects, 2, 2);
-		muTrackRectangles(Examinator->Detector[i].Objects, Examinator->Detector[i].Tracks);
-	}
-	//Release integral img
-	muIntegral_LightRelease(Examinator->Itlmg);
+	//Run the mark detector, the only scan while no mark is in the scan line
+	Examinator_Detect(Examinator, 0, Examinator->Detector[0].ScanROI);
 
 	//Check Mark status with scan line//
 	scanflag = 0;
+	markp = NULL;
 	Examinator->Detector[0].Status.Trigger = 0;
 	Trackers = Examinator->Detector[0].Tracks;
 	//Check if Mark getin scan line
@@ -326,6 +545,8 @@ void Examinator_Run(muImage_t *src, MuExaminator *Examinator)
 					    Examinator->Detector[0].Status.Trigger = 1;
 					}
 					scanflag = 1;
+					if(markp == NULL)
+						markp = tracp;
 				}
 			}
 			current = current->next;
@@ -341,6 +562,25 @@ void Examinator_Run(muImage_t *src, MuExaminator *Examinator)
 		}
 	}
 
+	//Run tag detectors around the tracked mark, only while it is in the scan line
+	for(i=1;i<Examinator->ExamData.TagNum;i++)
+	{
+		if(Examinator->Detector[0].Status.State == 1 && markp != NULL)
+		{
+			ScanROI = Examinator->Detector[i].ScanROI;
+			ScanROI.x += markp->x;
+			ScanROI.y += markp->y;
+			Examinator_Detect(Examinator, i, ScanROI);
+		}
+		else if(Examinator->Detector[i].Objects!=NULL)
+		{
+		    muClearSeq(&(Examinator->Detector[i].Objects));
+		    Examinator->Detector[i].Objects=NULL;
+		}
+	}
+	//Release integral img
+	muIntegral_LightRelease(Examinator->Itlmg);
+
 	//Init tag check list, when mark get into scanline//
 	if(Examinator->Detector[0].Status.State == 1 && 
 		Examinator->Detector[0].Status.Trigger == 1)
@@ -402,6 +642,10 @@ void Examinator_Release(MuExaminator *Examinator)
 	for(i=0; i<Examinator->ExamData.TagNum; i++)
 	{
         muClearSeq(&Examinator->Detector[i].Tracks);
+		Examinator_ReleaseModel(Examinator->Detector[i].Model);
+		Examinator->Detector[i].Model = NULL;
+		free(Examinator->Detector[i].Stages);
+		Examinator->Detector[i].Stages = NULL;
 		if(Examinator->Detector[i].Objects!=NULL)
 		{
 		    muClearSeq(&(Examinator->Detector[i].Objects));
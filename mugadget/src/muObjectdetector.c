@@ -33,13 +33,16 @@
  *  
  -------------------------------------------------------------------------- */
 #include "muGadget.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 #define MU_ADJUST_WEIGHTS 0
 
-void muCalcIntegralImage( const unsigned char* src, int* sum, double* sqsum, muSize_t size)
+//Integral of a size.width x size.height block read with srcstep, so a sub-region can be integrated in place
+static void calcIntegralImageStep( const unsigned char* src, int srcstep, int* sum, double* sqsum, muSize_t size)
 {
 	int x, y;
 
-    int srcstep = size.width;
     int sumstep = size.width+1;
     int sqsumstep = size.width+1;
 	int t;
@@ -88,6 +91,11 @@ void muCalcIntegralImage( const unsigned char* src, int* sum, double* sqsum, muS
     }
 }
 
+void muCalcIntegralImage( const unsigned char* src, int* sum, double* sqsum, muSize_t size)
+{
+    calcIntegralImageStep(src, size.width, sum, sqsum, size);
+}
+
 
  MuSimpleDetector* muLoadSimpleDetector( const char* filename)
  {
@@ -587,10 +595,14 @@ void muSetImagesForHaarClassifierCascade( MuSimpleDetector *cascade, muSize_t su
     cascade->p2 = sum + sumSize.width*(equRect.y + equRect.height) + equRect.x;
     cascade->p3 = sum + sumSize.width*(equRect.y + equRect.height) + equRect.x + equRect.width;
 
-	cascade->pq0 = sqsum + sumSize.width*equRect.y + equRect.x;
-    cascade->pq1 = sqsum + sumSize.width*equRect.y + equRect.x + equRect.width;
-    cascade->pq2 = sqsum + sumSize.width*(equRect.y + equRect.height) + equRect.x;
-    cascade->pq3 = sqsum + sumSize.width*(equRect.y + equRect.height) + equRect.x + equRect.width;
+	//sqsum is NULL when the variance comes from elsewhere (tiled integral)
+	if( sqsum )
+	{
+		cascade->pq0 = sqsum + sumSize.width*equRect.y + equRect.x;
+		cascade->pq1 = sqsum + sumSize.width*equRect.y + equRect.x + equRect.width;
+		cascade->pq2 = sqsum + sumSize.width*(equRect.y + equRect.height) + equRect.x;
+		cascade->pq3 = sqsum + sumSize.width*(equRect.y + equRect.height) + equRect.x + equRect.width;
+	}
 
 	for( i = 0; i < cascade->count; i++ )
     {
@@ -731,37 +743,124 @@ muIntegralImg_t* muIntegral_Light(muImage_t *img)
 
     Itlmg->imgSize.width = img->width;
     Itlmg->imgSize.height = img->height;
+    Itlmg->origin.x = 0;
+    Itlmg->origin.y = 0;
     inputData = img->imagedata;
     muCalcIntegralImage(inputData, Itlmg->sum, Itlmg->sqsum, Itlmg->imgSize);
     return Itlmg;
 }
 
+//Integral Image Light of ScanROI only
+//the ROI is expanded by maxWinSize to the right/bottom (windows anchored in the ROI) and clipped to the image,
+//origin keeps its top-left corner so the Light detectors take ScanROI and return rects in image coordinates
+muIntegralImg_t* muIntegral_LightROI(muImage_t *img, muRect_t ScanROI, muSize_t maxWinSize)
+{
+    muIntegralImg_t *Itlmg;
+    int x0, y0, x1, y1;
+
+    x0 = ScanROI.x < 0 ? 0 : ScanROI.x;
+    y0 = ScanROI.y < 0 ? 0 : ScanROI.y;
+    x1 = ScanROI.x + ScanROI.width + maxWinSize.width;
+    y1 = ScanROI.y + ScanROI.height + maxWinSize.height;
+    x1 = x1 > img->width ? img->width : x1;
+    y1 = y1 > img->height ? img->height : y1;
+    x0 = x0 > x1 ? x1 : x0;
+    y0 = y0 > y1 ? y1 : y0;
+
+    Itlmg = (muIntegralImg_t*)malloc(sizeof(muIntegralImg_t));
+    Itlmg->imgSize.width = x1 - x0;
+    Itlmg->imgSize.height = y1 - y0;
+    Itlmg->sumSize.width = Itlmg->imgSize.width + 1;
+    Itlmg->sumSize.height = Itlmg->imgSize.height + 1;
+    Itlmg->origin.x = x0;
+    Itlmg->origin.y = y0;
+    Itlmg->sum  = (int *)malloc(Itlmg->sumSize.width*Itlmg->sumSize.height*sizeof(int));
+    Itlmg->sqsum = (double *)malloc(Itlmg->sumSize.width*Itlmg->sumSize.height*sizeof(double));
+
+    calcIntegralImageStep(img->imagedata + y0*img->width + x0, img->width, Itlmg->sum, Itlmg->sqsum, Itlmg->imgSize);
+    return Itlmg;
+}
+
 void muIntegral_LightRelease(muIntegralImg_t* Itlmg)
 {
     free(Itlmg->sum);
     free(Itlmg->sqsum);
+    free(Itlmg);
+}
+
+//ScanROI in the coordinates of the integral: translated by its origin and clipped to its size
+static muRect_t clipScanROI(const muIntegralImg_t *Itlmg, muRect_t ScanROI)
+{
+    ScanROI.x -= Itlmg->origin.x;
+    ScanROI.y -= Itlmg->origin.y;
+
+    if( ScanROI.x < 0 )
+    {
+        ScanROI.width += ScanROI.x;
+        ScanROI.x = 0;
+    }
+    if( ScanROI.y < 0 )
+    {
+        ScanROI.height += ScanROI.y;
+        ScanROI.y = 0;
+    }
+    ScanROI.x = ScanROI.x > Itlmg->imgSize.width ? Itlmg->imgSize.width:ScanROI.x;
+    ScanROI.y = ScanROI.y > Itlmg->imgSize.height ? Itlmg->imgSize.height:ScanROI.y;
+
+    ScanROI.width = (ScanROI.x+ScanROI.width) > Itlmg->imgSize.width ? Itlmg->imgSize.width-ScanROI.x:ScanROI.width;
+    ScanROI.height = (ScanROI.y+ScanROI.height) > Itlmg->imgSize.height ? Itlmg->imgSize.height-ScanROI.y:ScanROI.height;
+    ScanROI.width = ScanROI.width < 0 ? 0 : ScanROI.width;
+    ScanROI.height = ScanROI.height < 0 ? 0 : ScanROI.height;
+
+    return ScanROI;
 }
 
 //SetImage Light -- Wait for learning program done
 
+//Light scan of one scale (features already set), offset is added to the output rects
+static void scanLight(muIntegralImg_t *Itlmg, muRect_t ScanROI, muSeq_t* Objects, MuSimpleDetector* cascade, muSize_t winSize, int ystep, muPoint_t offset)
+{
+    int iy, ix;
+    int result, ixstep;
+    int endX, endY;
+    muRect_t rRect = { 0, 0, 0, 0 };
+
+    endX = ScanROI.x+ScanROI.width - winSize.width;
+    endY = ScanROI.y+ScanROI.height - winSize.height;
+    rRect.width = winSize.width;
+    rRect.height = winSize.height;
+
+    for( iy = ScanROI.y; iy < endY; iy+=ystep )
+    {
+        ixstep = ystep;
+        for( ix = ScanROI.x; ix < endX; ix += ixstep )
+        {
+            result = ctRunHaarClassifierCascade( cascade, Itlmg->sumSize, ix, iy, 10 );
+            if( result > 0 )
+            {
+                rRect.x = ix + offset.x;
+                rRect.y = iy + offset.y;
+                muPushSeq(Objects, (MU_VOID *)&rRect);
+            }
+            ixstep = result != 0 ? ystep : ystep+1;
+        }
+    }
+}
+
 //Object Detection Light
 void muObjectDetection_Light(muIntegralImg_t *Itlmg, muRect_t ScanROI, muSeq_t* Objects, MuSimpleDetector* cascade, double scaleFactor, muSize_t minSize, muSize_t maxSize)
+{
+    muObjectDetection_LightStride(Itlmg, ScanROI, Objects, cascade, scaleFactor, minSize, maxSize, 2);
+}
+
+//stride is the scan step of the scales up to 2, larger windows step in proportion (Light: 2)
+void muObjectDetection_LightStride(muIntegralImg_t *Itlmg, muRect_t ScanROI, muSeq_t* Objects, MuSimpleDetector* cascade, double scaleFactor, muSize_t minSize, muSize_t maxSize, int stride)
 {
     //Create result sequence
     int n_factors = 0;
     double factor;
-    int iy, ix;
-    int result, ixstep;
-    int startX, startY;
-    int endX, endY;
-
-    ScanROI.x = ScanROI.x < 0 ? 0:ScanROI.x;
-    ScanROI.y = ScanROI.y < 0 ? 0:ScanROI.y;
-    ScanROI.x = ScanROI.x > Itlmg->imgSize.width ? Itlmg->imgSize.width:ScanROI.x;
-    ScanROI.y = ScanROI.y > Itlmg->imgSize.height ? Itlmg->imgSize.height:ScanROI.y;
 
-    ScanROI.width = (ScanROI.x+ScanROI.width) > Itlmg->imgSize.width ? Itlmg->imgSize.width-ScanROI.x:ScanROI.width;
-    ScanROI.height = (ScanROI.y+ScanROI.height) > Itlmg->imgSize.height ? Itlmg->imgSize.height-ScanROI.y:ScanROI.height;
+    ScanROI = clipScanROI(Itlmg, ScanROI);
 
     for( n_factors = 0, factor = 1;
              factor*cascade->orig_window_size.width < ScanROI.width - 5 &&
@@ -771,17 +870,10 @@ void muObjectDetection_Light(muIntegralImg_t *Itlmg, muRect_t ScanROI, muSeq_t*
     factor = 1;
     for( ; n_factors-- > 0; factor *= scaleFactor)
     {   
-        const double ystep = factor > 2? factor: 2; //Scan step increase when window size increase after totalscalefactor is bigger than 2
+        const double ystep = (factor > 2? factor: 2)*stride/2; //Scan step increase when window size increase after totalscalefactor is bigger than 2
         
         muSize_t winSize = { muRound( cascade->orig_window_size.width * factor ),
                                 muRound( cascade->orig_window_size.height * factor )};
-        
-        muRect_t rRect = { 0, 0, 0, 0 };
-
-        startX = ScanROI.x;
-        startY = ScanROI.y;
-        endX = ScanROI.x+ScanROI.width - winSize.width;
-        endY = ScanROI.y+ScanROI.height - winSize.height;
 
         if( winSize.width < minSize.width || winSize.height < minSize.height )
             continue;
@@ -791,25 +883,7 @@ void muObjectDetection_Light(muIntegralImg_t *Itlmg, muRect_t ScanROI, muSeq_t*
 
         muSetImagesForHaarClassifierCascade( cascade, Itlmg->sumSize, Itlmg->sum, Itlmg->sqsum, factor );
 
-        for( iy = startY; iy < endY; iy+=ystep )
-        {
-            ixstep = ystep;
-            //int result;
-            for( ix = startX; ix < endX; ix += ixstep )
-            {
-                result = ctRunHaarClassifierCascade( cascade, Itlmg->sumSize, ix, iy, 10 );
-                if( result > 0 )
-                {
-                    rRect.x = ix;
-                    rRect.y = iy;
-                    rRect.width = winSize.width;
-                    rRect.height = winSize.height;
-                    //rectList.push_back(rRect);
-                    muPushSeq(Objects, (MU_VOID *)&rRect);
-                }
-                ixstep = result != 0 ? ystep : ystep+1;
-            }
-        }
+        scanLight( Itlmg, ScanROI, Objects, cascade, winSize, (int)ystep, Itlmg->origin );
     }
 
 }
@@ -827,13 +901,7 @@ void muObjectDetection_SuperLight(muIntegralImg_t *Itlmg, muRect_t ScanROI, muSe
     double ystep;
 	muRect_t rRect = { 0, 0, 0, 0 };
 
-    ScanROI.x = ScanROI.x < 0 ? 0:ScanROI.x;
-    ScanROI.y = ScanROI.y < 0 ? 0:ScanROI.y;
-    ScanROI.x = ScanROI.x > Itlmg->imgSize.width ? Itlmg->imgSize.width:ScanROI.x;
-    ScanROI.y = ScanROI.y > Itlmg->imgSize.height ? Itlmg->imgSize.height:ScanROI.y;
-
-    ScanROI.width = (ScanROI.x+ScanROI.width) > Itlmg->imgSize.width ? Itlmg->imgSize.width-ScanROI.x:ScanROI.width;
-    ScanROI.height = (ScanROI.y+ScanROI.height) > Itlmg->imgSize.height ? Itlmg->imgSize.height-ScanROI.y:ScanROI.height;
+    ScanROI = clipScanROI(Itlmg, ScanROI);
 
     //Scaling factor
     factor = winSize.width/cascade->orig_window_size.width;
@@ -861,8 +929,8 @@ void muObjectDetection_SuperLight(muIntegralImg_t *Itlmg, muRect_t ScanROI, muSe
             result = ctRunHaarClassifierCascade_SuperLight( cascade, Itlmg->sumSize, ix, iy);
             if( result > 0 )
             {
-                rRect.x = ix;
-                rRect.y = iy;
+                rRect.x = ix + Itlmg->origin.x;
+                rRect.y = iy + Itlmg->origin.y;
                 rRect.width = winSize.width;
                 rRect.height = winSize.height;
                 //rectList.push_back(rRect);
@@ -873,34 +941,758 @@ void muObjectDetection_SuperLight(muIntegralImg_t *Itlmg, muRect_t ScanROI, muSe
     }// for scanning y s
 }
 
+//n copies of a cascade with their own stages and classifiers, in one block freed with free(),
+//so every thread can set its scale without touching the others
+static MuSimpleDetector* cloneCascades(const MuSimpleDetector *cascade, int n)
+{
+    MuSimpleDetector *copies;
+    MuHaarStageClassifier *stages;
+    MuHaarClassifier *classifiers;
+    const MuHaarStageClassifier *src;
+    int classifierNum = 0;
+    int c, i;
+
+    for( i = 0; i < cascade->count; i++ )
+        classifierNum += cascade->stage_classifier[i].count;
+
+    copies = (MuSimpleDetector *)malloc(n*(sizeof(MuSimpleDetector) + cascade->count*sizeof(MuHaarStageClassifier) +
+                                           classifierNum*sizeof(MuHaarClassifier)));
+    if( copies == NULL )
+        return NULL;
+
+    stages = (MuHaarStageClassifier *)(copies + n);
+    classifiers = (MuHaarClassifier *)(stages + n*cascade->count);
+    for( c = 0; c < n; c++, stages += cascade->count )
+    {
+        copies[c] = *cascade;
+        copies[c].stage_classifier = stages;
+        for( i = 0; i < cascade->count; i++ )
+        {
+            src = cascade->stage_classifier + i;
+            stages[i] = *src;
+            stages[i].classifier = classifiers;
+            stages[i].parent = src->parent ? stages + (src->parent - cascade->stage_classifier) : NULL;
+            stages[i].next = src->next ? stages + (src->next - cascade->stage_classifier) : NULL;
+            stages[i].child = src->child ? stages + (src->child - cascade->stage_classifier) : NULL;
+            memcpy(classifiers, src->classifier, src->count*sizeof(MuHaarClassifier));
+            classifiers += src->count;
+        }
+    }
+
+    return copies;
+}
+
+//Detection Atlas
+//num frames of up to frameSize are stacked as cells of one tall image. The integral is computed per
+//band of frames straight from the frames, the band is sized to stay in cache (MU_ATLAS_BAND_BYTES).
+//The features of a scale are set once per call and shared by all the bands, so the band size only
+//trades cache misses: on 64 QCIF/CIF frames, bands up to ~1.5 MB (4-5 QCIF or 1 CIF frame) ran
+//fastest, the whole atlas in one integral up to 2x slower.
+//The windows of a frame are kept inside its cell, so no guard band is needed between the cells.
+#define MU_ATLAS_BAND_BYTES (1536*1024)
+
+MuDetectionAtlas* muCreateDetectionAtlas(muSize_t frameSize, int num)
+{
+    MuDetectionAtlas *atlas;
+    int band, limit;
+
+    if( num <= 0 || frameSize.width <= 0 || frameSize.height <= 0 )
+        return NULL;
+
+    band = MU_ATLAS_BAND_BYTES/((frameSize.width+1)*(frameSize.height+1)*(int)(sizeof(int)+sizeof(double)));
+    band = band < 1 ? 1 : band;
+
+    //32-bit sum of a band
+    limit = (int)(2147483647.0/((double)frameSize.width*frameSize.height*255));
+    if( limit < 1 )
+    {
+        printf("muCreateDetectionAtlas: %dx%d frames overflow the integral\n", frameSize.width, frameSize.height);
+        return NULL;
+    }
+    band = band > limit ? limit : band;
+    band = band > num ? num : band;
+
+    atlas = (MuDetectionAtlas *)calloc(1, sizeof(MuDetectionAtlas));
+    if( atlas == NULL )
+        return NULL;
+
+    atlas->frameSize = frameSize;
+    atlas->capacity = num;
+    atlas->bandFrames = band;
+    atlas->Itlmg.imgSize.width = frameSize.width;
+    atlas->Itlmg.imgSize.height = frameSize.height*band;
+    atlas->Itlmg.sumSize.width = atlas->Itlmg.imgSize.width + 1;
+    atlas->Itlmg.sumSize.height = atlas->Itlmg.imgSize.height + 1;
+    atlas->Itlmg.sum = (int *)malloc(atlas->Itlmg.sumSize.width*atlas->Itlmg.sumSize.height*sizeof(int));
+    atlas->Itlmg.sqsum = (double *)malloc(atlas->Itlmg.sumSize.width*atlas->Itlmg.sumSize.height*sizeof(double));
+
+    if( atlas->Itlmg.sum == NULL || atlas->Itlmg.sqsum == NULL )
+    {
+        muReleaseDetectionAtlas(atlas);
+        return NULL;
+    }
+
+    return atlas;
+}
+
+void muReleaseDetectionAtlas(MuDetectionAtlas *atlas)
+{
+    if( atlas == NULL )
+        return;
+    free(atlas->Itlmg.sum);
+    free(atlas->Itlmg.sqsum);
+    free(atlas);
+}
+
+//Integral rows of one cell under the row above it (sum/sqsum point to that row, already set).
+//The frame covers size of the cell, the rest of the cell is integrated as zero pixels.
+static void integrateAtlasCell(const muImage_t *frame, muSize_t size, muSize_t cell, int* sum, double* sqsum)
+{
+    int step = cell.width + 1;
+    int x, y;
+
+    for( y = 0; y < size.height; y++ )
+    {
+        const unsigned char *src = frame->imagedata + y*frame->width;
+        int s = 0;
+        double sq = 0;
+
+        sum += step;
+        sqsum += step;
+        sum[0] = 0;
+        sqsum[0] = 0;
+        for( x = 0; x < size.width; x++ )
+        {
+            int it = src[x];
+            s += it;
+            sq += (double)it*it;
+            sum[x+1] = sum[x+1-step] + s;
+            sqsum[x+1] = sqsum[x+1-step] + sq;
+        }
+        for( ; x < cell.width; x++ )
+        {
+            sum[x+1] = sum[x+1-step] + s;
+            sqsum[x+1] = sqsum[x+1-step] + sq;
+        }
+    }
+
+    for( ; y < cell.height; y++ )
+    {
+        memcpy(sum + step, sum, step*sizeof(int));
+        memcpy(sqsum + step, sqsum, step*sizeof(double));
+        sum += step;
+        sqsum += step;
+    }
+}
+
+//Object Detection of a batch of frames (8-bit gray, up to the atlas frameSize)
+//Objects[i] gets the detections of frames[i] in its own coordinates, the same as
+//muObjectDetection_Light over the whole frame. Every band reuses the same integral buffer, so
+//each scale gets its own cascade copy whose features are set once per call for all the bands.
+void muObjectDetection_Atlas(MuDetectionAtlas *atlas, muImage_t **frames, int num, muSeq_t **Objects, MuSimpleDetector* cascade, double scaleFactor, muSize_t minSize, muSize_t maxSize)
+{
+    muIntegralImg_t *Itlmg = &atlas->Itlmg;
+    MuSimpleDetector *scales;
+    int n_factors = 0, k;
+    double factor, firstFactor = 1;
+    int i, first, last;
+
+    if( num > atlas->capacity )
+    {
+        printf("muObjectDetection_Atlas: %d frames for an atlas of %d\n", num, atlas->capacity);
+        num = atlas->capacity;
+    }
+
+    //Scales in [minSize, maxSize] that fit in a cell
+    for( factor = 1;
+             factor*cascade->orig_window_size.width < atlas->frameSize.width - 5 &&
+             factor*cascade->orig_window_size.height < atlas->frameSize.height - 5;
+             factor *= scaleFactor )
+    {
+        muSize_t winSize = { muRound( cascade->orig_window_size.width * factor ),
+                                muRound( cascade->orig_window_size.height * factor )};
+
+        if( winSize.width < minSize.width || winSize.height < minSize.height )
+        {
+            firstFactor = factor*scaleFactor;
+            continue;
+        }
+
+        if ( winSize.width > maxSize.width || winSize.height > maxSize.height )
+            break;
+
+        n_factors++;
+    }
+
+    if( n_factors == 0 )
+        return;
+
+    scales = cloneCascades(cascade, n_factors);
+    if( scales == NULL )
+    {
+        printf("muObjectDetection_Atlas: out of memory\n");
+        return;
+    }
+
+    Itlmg->imgSize.height = atlas->bandFrames*atlas->frameSize.height;
+    for( k = 0, factor = firstFactor; k < n_factors; k++, factor *= scaleFactor )
+        muSetImagesForHaarClassifierCascade( scales + k, Itlmg->sumSize, Itlmg->sum, Itlmg->sqsum, factor );
+
+    for( first = 0; first < num; first = last )
+    {
+        last = first + atlas->bandFrames < num ? first + atlas->bandFrames : num;
+
+        //Integrate the band cell by cell, each frame is read in place
+        Itlmg->imgSize.height = (last - first)*atlas->frameSize.height;
+        memset(Itlmg->sum, 0, Itlmg->sumSize.width*sizeof(int));
+        memset(Itlmg->sqsum, 0, Itlmg->sumSize.width*sizeof(double));
+        for( i = first; i < last; i++ )
+        {
+            int row = (i - first)*atlas->frameSize.height*Itlmg->sumSize.width;
+            muSize_t size;
+
+            size.width = frames[i]->width < atlas->frameSize.width ? frames[i]->width : atlas->frameSize.width;
+            size.height = frames[i]->height < atlas->frameSize.height ? frames[i]->height : atlas->frameSize.height;
+            integrateAtlasCell(frames[i], size, atlas->frameSize, Itlmg->sum + row, Itlmg->sqsum + row);
+        }
+
+        for( k = 0; k < n_factors; k++ )
+        {
+            MuSimpleDetector *scale = scales + k;
+            muSize_t winSize = scale->real_window_size;
+            const double ystep = scale->scale > 2? scale->scale: 2;
+
+            //Demultiplex: every frame is scanned in its cell, the cell corner is taken off the rects
+            for( i = first; i < last; i++ )
+            {
+                muRect_t cell;
+                muPoint_t offset;
+
+                cell.x = 0;
+                cell.y = (i - first)*atlas->frameSize.height;
+                cell.width = frames[i]->width < atlas->frameSize.width ? frames[i]->width : atlas->frameSize.width;
+                cell.height = frames[i]->height < atlas->frameSize.height ? frames[i]->height : atlas->frameSize.height;
+                offset.x = 0;
+                offset.y = -cell.y;
+
+                if( scale->scale*cascade->orig_window_size.width >= cell.width - 5 ||
+                    scale->scale*cascade->orig_window_size.height >= cell.height - 5 )
+                    continue;
+
+                scanLight( Itlmg, cell, Objects[i], scale, winSize, (int)ystep, offset );
+            }
+        }
+    }
+
+    free(scales);
+}
+
+//Cascade verdict with the reached stage and the margin of the last evaluated stage
+//returns the number of passed stages, -1 for a flat window
+static int runHaarClassifierCascadeScore( const MuSimpleDetector *cascade, int p_offset, int std_th, double *score )
+{
+    int i, j;
+    double mean, variance_norm_factor;
+    double stage_sum;
+
+    mean = calc_sum(*cascade,p_offset)*cascade->inv_window_area;
+
+    variance_norm_factor = cascade->pq0[p_offset] - cascade->pq1[p_offset] -
+                           cascade->pq2[p_offset] + cascade->pq3[p_offset];
+    variance_norm_factor = variance_norm_factor*cascade->inv_window_area - mean*mean;
+    if( variance_norm_factor >= 0. )
+        variance_norm_factor = sqrt(variance_norm_factor);
+    else
+        variance_norm_factor = 1.;
+
+    *score = 0;
+    if( variance_norm_factor < std_th )
+        return -1;
+
+    for( i = 0; i < cascade->count; i++ )
+    {
+        stage_sum = 0.0;
+
+        for( j = 0; j < cascade->stage_classifier[i].count; j++ )
+        {
+            MuHaarClassifier* classifier = cascade->stage_classifier[i].classifier + j;
+            MuHaarTreeNode* node = &classifier->node;
+            double t = node[0].threshold*variance_norm_factor;
+            double sum1 = calc_sum(node[0].feature.rect[0],p_offset) * node[0].feature.rect[0].weight;
+            sum1 += calc_sum(node[0].feature.rect[1],p_offset) * node[0].feature.rect[1].weight;
+
+            if(!node[0].two_rects)
+                sum1 += calc_sum(node[0].feature.rect[2],p_offset) * node[0].feature.rect[2].weight;
+
+            stage_sum += sum1 >= t ? node[0].right:node[0].left;
+        }
+
+        *score = stage_sum - cascade->stage_classifier[i].threshold;
+        if( *score < 0 )
+            return i;
+    }
+
+    return i;
+}
+
+#define MU_VERIFY_SCALE_STEP 1.1  //scale ladder of the verification windows
+#define MU_VERIFY_CHUNK 64        //candidates per parallel work item
+
+typedef struct
+{
+    int level;  //scale ladder level, the grouping key
+    int index;
+} MuCandidateKey;
+
+static int compareCandidateKey(const void *a, const void *b)
+{
+    const MuCandidateKey *ka = (const MuCandidateKey *)a;
+    const MuCandidateKey *kb = (const MuCandidateKey *)b;
+
+    if( ka->level != kb->level )
+        return ka->level < kb->level ? -1 : 1;
+    return ka->index - kb->index;
+}
+
+//Candidate Verification
+//Every candidate gets the largest window of the scale ladder (cascade window times powers of
+//MU_VERIFY_SCALE_STEP) that fits in it, centered. Candidates are sorted by ladder level so
+//consecutive candidates share their scale; the sorted list is cut in chunks evaluated in parallel
+//(OpenMP) on per-thread cascade copies, a thread sets the features only when the level changes.
+void muVerifyCandidates(muIntegralImg_t *Itlmg, MuSimpleDetector* cascade, const muRect_t *Candidates, int num, MuCandidateResult *Results)
+{
+    MuCandidateKey *keys;
+    MuSimpleDetector *copies = NULL;
+    double logStep = log(MU_VERIFY_SCALE_STEP);
+    int i, chunk, chunks, nthreads = 1;
+
+    if( num <= 0 )
+        return;
+
+    keys = (MuCandidateKey *)malloc(num*sizeof(MuCandidateKey));
+    if( keys == NULL )
+    {
+        printf("muVerifyCandidates: out of memory\n");
+        return;
+    }
+
+    for( i = 0; i < num; i++ )
+    {
+        double s = (double)Candidates[i].width/cascade->orig_window_size.width;
+        double t = (double)Candidates[i].height/cascade->orig_window_size.height;
+
+        s = s < t ? s : t;
+        //-1 for candidates smaller than the cascade window, they are not evaluated
+        keys[i].level = s < 1 ? -1 : (int)floor(log(s)/logStep + 1e-9);
+        keys[i].index = i;
+
+        Results[i].pass = 0;
+        Results[i].depth = 0;
+        Results[i].score = 0;
+    }
+
+    qsort(keys, num, sizeof(MuCandidateKey), compareCandidateKey);
+
+#ifdef _OPENMP
+    if( num >= 4*MU_VERIFY_CHUNK )
+        nthreads = omp_get_max_threads();
+#endif
+    if( nthreads > 1 )
+    {
+        copies = cloneCascades(cascade, nthreads);
+        if( copies == NULL )
+            nthreads = 1;
+    }
+
+    chunks = (num + MU_VERIFY_CHUNK - 1)/MU_VERIFY_CHUNK;
+
+#ifdef _OPENMP
+#pragma omp parallel num_threads(nthreads) private(i)
+#endif
+    {
+        MuSimpleDetector *local = cascade;
+        int level = -1;
+
+#ifdef _OPENMP
+        if( copies != NULL )
+            local = copies + omp_get_thread_num();
+#pragma omp for schedule(dynamic, 1)
+#endif
+        for( chunk = 0; chunk < chunks; chunk++ )
+        {
+            int last = (chunk+1)*MU_VERIFY_CHUNK < num ? (chunk+1)*MU_VERIFY_CHUNK : num;
+
+            for( i = chunk*MU_VERIFY_CHUNK; i < last; i++ )
+            {
+                int k = keys[i].index;
+                const muRect_t *c = &Candidates[k];
+                muSize_t winSize;
+                int x, y, depth;
+
+                if( keys[i].level < 0 )
+                    continue;
+
+                if( keys[i].level != level )
+                {
+                    level = keys[i].level;
+                    muSetImagesForHaarClassifierCascade( local, Itlmg->sumSize, Itlmg->sum, Itlmg->sqsum, pow(MU_VERIFY_SCALE_STEP, level) );
+                }
+
+                winSize = local->real_window_size;
+                x = c->x + (c->width - winSize.width)/2 - Itlmg->origin.x;
+                y = c->y + (c->height - winSize.height)/2 - Itlmg->origin.y;
+
+                //same bounds as ctRunHaarClassifierCascade
+                if( x < 0 || y < 0 ||
+                    x + winSize.width >= Itlmg->sumSize.width ||
+                    y + winSize.height >= Itlmg->sumSize.height )
+                    continue;
+
+                depth = runHaarClassifierCascadeScore( local, y*Itlmg->sumSize.width + x, 10, &Results[k].score );
+                Results[k].depth = depth < 0 ? 0 : depth;
+                Results[k].pass = depth == local->count;
+            }
+        }
+    }
+
+    free(copies);
+    free(keys);
+}
+
+//Row step the cascade is set with: the tile step when the window fits in a tile, else a virtual
+//step just wider than the window, such windows always take the exact path across the tiles
+static int tiledLayoutStep(const muTiledIntegral_t *ti, muSize_t winSize)
+{
+    if( winSize.width < ti->step && winSize.height < ti->step )
+        return ti->step;
+
+    return winSize.width + 1;
+}
+
+//Rect sum of a feature across tiles, the corners are decoded from the pointers set with the layout step
+static MU_64S tiledRectSum(const muTiledIntegral_t *ti, int step, const int *p0, const int *p3, int x, int y)
+{
+    int o0 = (int)(p0 - ti->sum), o3 = (int)(p3 - ti->sum);
+    int x0 = x + o0 % step, y0 = y + o0 / step;
+    int x1 = x + o3 % step, y1 = y + o3 / step;
+
+    return muTiledIntegralPoint(ti, x1, y1) - muTiledIntegralPoint(ti, x0, y1) -
+           muTiledIntegralPoint(ti, x1, y0) + muTiledIntegralPoint(ti, x0, y0);
+}
+
+static MU_64U tiledRectSq(const muTiledIntegral_t *ti, int step, const int *p0, const int *p3, int x, int y)
+{
+    int o0 = (int)(p0 - ti->sum), o3 = (int)(p3 - ti->sum);
+    int x0 = x + o0 % step, y0 = y + o0 / step;
+    int x1 = x + o3 % step, y1 = y + o3 / step;
+
+    return muTiledIntegralPointSq(ti, x1, y1) - muTiledIntegralPointSq(ti, x0, y1) -
+           muTiledIntegralPointSq(ti, x1, y0) + muTiledIntegralPointSq(ti, x0, y0);
+}
+
+//Set the cascade on the local integral layout, or on the virtual layout of windows larger than a tile
+static void setTiledImagesForHaarClassifierCascade( MuSimpleDetector *cascade, const muTiledIntegral_t *ti, double scale )
+{
+    muSize_t winSize = { muRound( cascade->orig_window_size.width * scale ),
+                            muRound( cascade->orig_window_size.height * scale )};
+    muSize_t stepSize;
+
+    stepSize.width = stepSize.height = tiledLayoutStep( ti, winSize );
+    muSetImagesForHaarClassifierCascade( cascade, stepSize, ti->sum, NULL, scale );
+}
+
+//Cascade on the tiled integral: the local 32-bit sums of one tile when the window fits
+//in the tile of its corner, else the exact sums across the tiles
+int ctRunHaarClassifierCascade_Tiled( MuSimpleDetector *cascade, const muTiledIntegral_t *ti, int x, int y, int std_th )
+{
+    int p_offset = 0, fast, step;
+    int tx, ty, lx, ly;
+    int i, j;
+    double mean, sq, variance_norm_factor;
+    double stage_sum;
+
+    if( x < 0 || y < 0 ||
+        x + cascade->real_window_size.width > ti->imgSize.width ||
+        y + cascade->real_window_size.height > ti->imgSize.height )
+        return -1;
+
+    tx = x >> ti->tileshift;
+    ty = y >> ti->tileshift;
+    lx = x - (tx << ti->tileshift);
+    ly = y - (ty << ti->tileshift);
+    fast = lx + cascade->real_window_size.width < ti->step && ly + cascade->real_window_size.height < ti->step;
+    step = tiledLayoutStep(ti, cascade->real_window_size);
+
+    if( fast )
+    {
+        p_offset = (ty*ti->cols + tx)*ti->step*ti->step + ly*ti->step + lx;
+        mean = calc_sum(*cascade,p_offset)*cascade->inv_window_area;
+        sq = (double)ti->sqsum[(cascade->p0 - ti->sum) + p_offset] - (double)ti->sqsum[(cascade->p1 - ti->sum) + p_offset] -
+             (double)ti->sqsum[(cascade->p2 - ti->sum) + p_offset] + (double)ti->sqsum[(cascade->p3 - ti->sum) + p_offset];
+    }
+    else
+    {
+        mean = tiledRectSum(ti, step, cascade->p0, cascade->p3, x, y)*cascade->inv_window_area;
+        sq = (double)tiledRectSq(ti, step, cascade->p0, cascade->p3, x, y);
+    }
+
+    variance_norm_factor = sq*cascade->inv_window_area - mean*mean;
+    if( variance_norm_factor >= 0. )
+        variance_norm_factor = sqrt(variance_norm_factor);
+    else
+        variance_norm_factor = 1.;
+
+    if(variance_norm_factor < std_th)
+        return 0;
+
+    for( i = 0; i < cascade->count; i++ )
+    {
+        MuHaarStageClassifier *stage = cascade->stage_classifier + i;
+        stage_sum = 0.0;
+
+        if( fast )
+        {
+            for( j = 0; j < stage->count; j++ )
+            {
+                MuHaarTreeNode* node = &stage->classifier[j].node;
+                double t = node->threshold*variance_norm_factor;
+                double sum1 = calc_sum(node->feature.rect[0],p_offset) * node->feature.rect[0].weight;
+                sum1 += calc_sum(node->feature.rect[1],p_offset) * node->feature.rect[1].weight;
+
+                if( !stage->two_rects && !node->two_rects )
+                    sum1 += calc_sum(node->feature.rect[2],p_offset) * node->feature.rect[2].weight;
+
+                stage_sum += sum1 >= t ? node->right:node->left;
+            }
+        }
+        else
+        {
+            for( j = 0; j < stage->count; j++ )
+            {
+                MuHaarTreeNode* node = &stage->classifier[j].node;
+                double t = node->threshold*variance_norm_factor;
+                double sum1 = tiledRectSum(ti, step, node->feature.rect[0].p0, node->feature.rect[0].p3, x, y) * node->feature.rect[0].weight;
+                sum1 += tiledRectSum(ti, step, node->feature.rect[1].p0, node->feature.rect[1].p3, x, y) * node->feature.rect[1].weight;
+
+                if( !stage->two_rects && !node->two_rects )
+                    sum1 += tiledRectSum(ti, step, node->feature.rect[2].p0, node->feature.rect[2].p3, x, y) * node->feature.rect[2].weight;
+
+                stage_sum += sum1 >= t ? node->right:node->left;
+            }
+        }
+
+        if( stage_sum < stage->threshold )
+        {
+            return -i;
+        }
+    }
+
+    return 1;
+}
+
+//Object Detection on a tiled integral image, scales with a window larger than a tile take the exact
+//cross-tile path on every window
+void muObjectDetection_Tiled(const muTiledIntegral_t *ti, muRect_t ScanROI, muSeq_t* Objects, MuSimpleDetector* cascade, double scaleFactor, muSize_t minSize, muSize_t maxSize)
+{
+    int n_factors = 0;
+    double factor;
+    int iy, ix;
+    int result, ixstep;
+    int startX, startY;
+    int endX, endY;
+
+    ScanROI.x = ScanROI.x < 0 ? 0:ScanROI.x;
+    ScanROI.y = ScanROI.y < 0 ? 0:ScanROI.y;
+    ScanROI.x = ScanROI.x > ti->imgSize.width ? ti->imgSize.width:ScanROI.x;
+    ScanROI.y = ScanROI.y > ti->imgSize.height ? ti->imgSize.height:ScanROI.y;
+
+    ScanROI.width = (ScanROI.x+ScanROI.width) > ti->imgSize.width ? ti->imgSize.width-ScanROI.x:ScanROI.width;
+    ScanROI.height = (ScanROI.y+ScanROI.height) > ti->imgSize.height ? ti->imgSize.height-ScanROI.y:ScanROI.height;
+
+    for( n_factors = 0, factor = 1;
+             factor*cascade->orig_window_size.width < ScanROI.width - 5 &&
+             factor*cascade->orig_window_size.height < ScanROI.height - 5;
+             n_factors++, factor *= scaleFactor );
+
+    factor = 1;
+    for( ; n_factors-- > 0; factor *= scaleFactor)
+    {
+        const double ystep = factor > 2? factor: 2;
+
+        muSize_t winSize = { muRound( cascade->orig_window_size.width * factor ),
+                                muRound( cascade->orig_window_size.height * factor )};
+
+        muRect_t rRect = { 0, 0, 0, 0 };
+
+        startX = ScanROI.x;
+        startY = ScanROI.y;
+        endX = ScanROI.x+ScanROI.width - winSize.width;
+        endY = ScanROI.y+ScanROI.height - winSize.height;
+
+        if( winSize.width < minSize.width || winSize.height < minSize.height )
+            continue;
+
+        if ( winSize.width > maxSize.width || winSize.height > maxSize.height )
+            break;
+
+        setTiledImagesForHaarClassifierCascade( cascade, ti, factor );
+
+        for( iy = startY; iy < endY; iy+=ystep )
+        {
+            ixstep = ystep;
+            for( ix = startX; ix < endX; ix += ixstep )
+            {
+                result = ctRunHaarClassifierCascade_Tiled( cascade, ti, ix, iy, 10 );
+                if( result > 0 )
+                {
+                    rRect.x = ix;
+                    rRect.y = iy;
+                    rRect.width = winSize.width;
+                    rRect.height = winSize.height;
+                    muPushSeq(Objects, (MU_VOID *)&rRect);
+                }
+                ixstep = result != 0 ? ystep : ystep+1;
+            }
+        }
+    }
+}
+
+//Scene scale prior
+//minHeight/maxHeight[y] bound the height of an object whose bottom edge is on row y,
+//a new prior accepts every size
+MuScalePrior* muCreateScalePrior(int height)
+{
+    MuScalePrior *prior;
+    int y;
+
+    prior = (MuScalePrior *)calloc(1, sizeof(MuScalePrior));
+    if( prior == NULL )
+        return NULL;
+
+    prior->height = height;
+    prior->minHeight = (int *)malloc(2*height*sizeof(int));
+    if( prior->minHeight == NULL )
+    {
+        free(prior);
+        return NULL;
+    }
+    prior->maxHeight = prior->minHeight + height;
+
+    for( y = 0; y < height; y++ )
+    {
+        prior->minHeight[y] = 0;
+        prior->maxHeight[y] = 0x7fffffff;
+    }
+
+    return prior;
+}
+
+void muReleaseScalePrior(MuScalePrior *prior)
+{
+    if( prior == NULL )
+        return;
+    free(prior->minHeight);
+    free(prior);
+}
+
+//Object height range given at two rows (e.g. horizon and bottom), linear in between and beyond
+void muScalePriorSetRange(MuScalePrior *prior, int y0, int minH0, int maxH0, int y1, int minH1, int maxH1)
+{
+    int y;
+    double t;
+
+    if( y0 == y1 )
+    {
+        printf("muScalePriorSetRange: the two rows must differ\n");
+        return;
+    }
+
+    for( y = 0; y < prior->height; y++ )
+    {
+        t = (double)(y - y0)/(y1 - y0);
+        prior->minHeight[y] = muRound(minH0 + t*(minH1 - minH0));
+        prior->maxHeight[y] = muRound(maxH0 + t*(maxH1 - maxH0));
+        prior->minHeight[y] = prior->minHeight[y] < 0 ? 0 : prior->minHeight[y];
+        prior->maxHeight[y] = prior->maxHeight[y] < 0 ? 0 : prior->maxHeight[y];
+    }
+}
+
+//Accumulate detections (bottom row, height) for muScalePriorFit
+void muScalePriorLearn(MuScalePrior *prior, const muSeq_t *Objects)
+{
+    muSeqBlock_t *block;
+
+    for( block = Objects->first; block != NULL; block = block->next )
+    {
+        const muRect_t *r = (const muRect_t *)block->data;
+        double y = r->y + r->height - 1;
+
+        prior->n += 1;
+        prior->sy += y;
+        prior->sh += r->height;
+        prior->syy += y*y;
+        prior->syh += y*r->height;
+    }
+}
+
+//Least squares height = a*row + b from the learned detections, the range is the fit
+//+-tolerance (0.3 = 30%). Returns 0 and keeps the old range until the detections
+//cover more than one row.
+int muScalePriorFit(MuScalePrior *prior, double tolerance)
+{
+    double det, a, b, h;
+    int y;
+
+    det = prior->n*prior->syy - prior->sy*prior->sy;
+    if( prior->n < 2 || det <= prior->n*prior->n )  //rows spread less than one row
+        return 0;
+
+    a = (prior->n*prior->syh - prior->sy*prior->sh)/det;
+    b = (prior->sh - a*prior->sy)/prior->n;
+
+    for( y = 0; y < prior->height; y++ )
+    {
+        h = a*y + b;
+        h = h < 0 ? 0 : h;
+        prior->minHeight[y] = (int)(h*(1 - tolerance));
+        prior->maxHeight[y] = (int)(h*(1 + tolerance) + 1);
+    }
+
+    return 1;
+}
+
+//Window of height h at top row y is plausible
+static int scalePriorAccept(const MuScalePrior *prior, int y, int h)
+{
+    y += h - 1;
+    if( y < 0 || y >= prior->height )
+        return 1;
+    return h >= prior->minHeight[y] && h <= prior->maxHeight[y];
+}
+
 muSeq_t *muObjectDetection(muImage_t *img, MuSimpleDetector* cascade, double scaleFactor, muSize_t minSize, muSize_t maxSize)
 {
-	MU_8U *inputData; //Image data
+    return muObjectDetection_Prior(img, cascade, scaleFactor, minSize, maxSize, NULL);
+}
+
+//Classic multi-scale scan of a whole-image integral, prior (may be NULL) restricts every scale
+//to the rows where its window height is plausible
+static muSeq_t *scanFullFrame(int *sum, double *sqsum, muSize_t imgSize, MuSimpleDetector* cascade, double scaleFactor, muSize_t minSize, muSize_t maxSize, const MuScalePrior *prior)
+{
 	muSeq_t *rectList; //Result rectangle list
 	muSize_t sumSize; //Size of integral image
-	muSize_t imgSize; //Size of image
-	int *sum;
-	double *sqsum;
 	int n_factors = 0;
 	double factor;
 	int iy, ix;
 	int x, y;
 	int result, ixstep;
 
-	sumSize.width = img->width + 1;
-	sumSize.height = img->height + 1;
-	imgSize.width = img->width;
-	imgSize.height = img->height;
-	inputData = img->imagedata;
-	sum  = (int *)calloc(sumSize.width*sumSize.height, sizeof(int));
-	sqsum = (double *)calloc(sumSize.width*sumSize.height, sizeof(double));
+	sumSize.width = imgSize.width + 1;
+	sumSize.height = imgSize.height + 1;
 
     //Create result sequence
 	rectList = muCreateSeq(sizeof(muRect_t));
 
-	muCalcIntegralImage(inputData, sum, sqsum, imgSize);
-
-
 	for( n_factors = 0, factor = 1;
              factor*cascade->orig_window_size.width < imgSize.width - 10 &&
 			 factor*cascade->orig_window_size.height < imgSize.height - 10;
@@ -930,6 +1722,8 @@ muSeq_t *muObjectDetection(muImage_t *img, MuSimpleDetector* cascade, double sca
         for( iy = startY; iy < endY; iy++ )
         {
             y = muRound(iy*ScanStep);
+            if( prior && !scalePriorAccept(prior, y, winSize.height) )
+                continue;
 			ixstep = 1;
             for( ix = startX; ix < endX; ix += ixstep )
             {
@@ -948,12 +1742,44 @@ muSeq_t *muObjectDetection(muImage_t *img, MuSimpleDetector* cascade, double sca
         }
 	}
 	
+    return rectList;
+}
+
+//prior (may be NULL) restricts every scale to the rows where its window height is plausible
+muSeq_t *muObjectDetection_Prior(muImage_t *img, MuSimpleDetector* cascade, double scaleFactor, muSize_t minSize, muSize_t maxSize, const MuScalePrior *prior)
+{
+	muSeq_t *rectList; //Result rectangle list
+	muSize_t imgSize; //Size of image
+	int *sum;
+	double *sqsum;
+
+	imgSize.width = img->width;
+	imgSize.height = img->height;
+	sum  = (int *)calloc((imgSize.width+1)*(imgSize.height+1), sizeof(int));
+	sqsum = (double *)calloc((imgSize.width+1)*(imgSize.height+1), sizeof(double));
+
+	muCalcIntegralImage(img->imagedata, sum, sqsum, imgSize);
+
+	rectList = scanFullFrame(sum, sqsum, imgSize, cascade, scaleFactor, minSize, maxSize, prior);
+
 	free(sum);
 	free(sqsum);
 
     return rectList;
 }
 
+//Same scan on the integral cached by a frame context, shared with the other consumers of the frame
+muSeq_t *muObjectDetection_Frame(muFrameContext_t *ctx, MuSimpleDetector* cascade, double scaleFactor, muSize_t minSize, muSize_t maxSize, const MuScalePrior *prior)
+{
+	const muIntegralImg_t *ii;
+
+	ii = muFrameIntegral(ctx, 1);
+	if(ii == NULL)
+		return NULL;
+
+	return scanFullFrame(ii->sum, ii->sqsum, ii->imgSize, cascade, scaleFactor, minSize, maxSize, prior);
+}
+
 /**Merge Function**/
 /*MergeObjDistTH: OverlapTH - 2 means 1/2, 3 means 1/3*/
 /*HitNum: TH for number of merged blocks*/
@@ -0,0 +1,373 @@
+/*
+% MIT License
+%
+% Copyright (c) 2016 OneCV
+%
+% Permission is hereby granted, free of charge, to any person obtaining a copy
+% of this software and associated documentation files (the "Software"), to deal
+% in the Software without restriction, including without limitation the rights
+% to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+% copies of the Software, and to permit persons to whom the Software is
+% furnished to do so, subject to the following conditions:
+%
+% The above copyright notice and this permission notice shall be included in all
+% copies or substantial portions of the Software.
+%
+% THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+% IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+% FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+% AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+% LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+% OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+% SOFTWARE.
+*/
+
+/* ------------------------------------------------------------------------- /
+ *
+ * Module: muQuantcascade.c
+ * Author: Joe Lin
+ *
+ * Description:
+ *    Quantized haar cascade: int16 rect weights and leaves, int32 feature
+ *    thresholds premultiplied at scale setup, and an evaluator which stays
+ *    in integer arithmetic (32-bit integral, 32-bit wrapped squared integral,
+ *    variance normalization on squares instead of a square root).
+ *
+ -------------------------------------------------------------------------- */
+
+#include "muGadget.h"
+
+#define QUANT_MAX_SHIFT 14
+#define QUANT_INT_MAX 2147483647.0
+
+MuQuantCascade* muQuantizeCascade(MuSimpleDetector *Detector)
+{
+    MuQuantCascade *Quant;
+    MuQuantStage *stage;
+    MuQuantNode *node;
+    double maxleaf = 0;
+    int i, j, nodes = 0;
+
+    if( Detector == NULL || Detector->has_tilted_features )
+        return NULL;
+
+    for( i = 0; i < Detector->count; i++ )
+    {
+        MuHaarStageClassifier *sc = Detector->stage_classifier + i;
+        nodes += sc->count;
+        for( j = 0; j < sc->count; j++ )
+        {
+            MuHaarTreeNode *hn = &sc->classifier[j].node;
+            maxleaf = fabs(hn->left) > maxleaf ? fabs(hn->left) : maxleaf;
+            maxleaf = fabs(hn->right) > maxleaf ? fabs(hn->right) : maxleaf;
+        }
+    }
+
+    //One arena: cascade, stages, nodes
+    Quant = (MuQuantCascade *)calloc(1, sizeof(MuQuantCascade) + Detector->count*sizeof(MuQuantStage) + nodes*sizeof(MuQuantNode));
+    if( Quant == NULL )
+        return NULL;
+
+    Quant->source = Detector;
+    Quant->count = Detector->count;
+    Quant->stage = (MuQuantStage *)(Quant + 1);
+    node = (MuQuantNode *)(Quant->stage + Detector->count);
+
+    //Leaves and stage thresholds in Q(leafshift), the largest leaf fits int16
+    Quant->leafshift = QUANT_MAX_SHIFT;
+    while( Quant->leafshift > 0 && maxleaf*(1 << Quant->leafshift) > 32767 )
+        Quant->leafshift--;
+
+    for( i = 0; i < Detector->count; i++ )
+    {
+        MuHaarStageClassifier *sc = Detector->stage_classifier + i;
+        stage = Quant->stage + i;
+        stage->count = sc->count;
+        stage->threshold = muRound(sc->threshold*(1 << Quant->leafshift));
+        stage->node = node;
+        for( j = 0; j < sc->count; j++, node++ )
+        {
+            node->left = (MU_16S)muRound(sc->classifier[j].node.left*(1 << Quant->leafshift));
+            node->right = (MU_16S)muRound(sc->classifier[j].node.right*(1 << Quant->leafshift));
+        }
+    }
+
+    return Quant;
+}
+
+void muReleaseQuantCascade(MuQuantCascade *Quant)
+{
+    free(Quant);
+}
+
+//Quantized Integral Image: 32-bit sum and squared sum, the squared sum wraps modulo 2^32
+//so it is exact for windows smaller than 2^32/255^2 pixels
+MuQuantIntegral* muIntegral_Quant(muImage_t *img)
+{
+    MuQuantIntegral *Itg;
+    const MU_8U *src;
+    MU_32S *sum, s;
+    MU_32U *sqsum, sq;
+    int x, y, step;
+
+    Itg = (MuQuantIntegral *)malloc(sizeof(MuQuantIntegral));
+    if( Itg == NULL )
+        return NULL;
+
+    Itg->imgSize.width = img->width;
+    Itg->imgSize.height = img->height;
+    Itg->sumSize.width = step = img->width + 1;
+    Itg->sumSize.height = img->height + 1;
+    Itg->sum = (MU_32S *)malloc(step*Itg->sumSize.height*sizeof(MU_32S));
+    Itg->sqsum = (MU_32U *)malloc(step*Itg->sumSize.height*sizeof(MU_32U));
+    if( Itg->sum == NULL || Itg->sqsum == NULL )
+    {
+        muIntegral_QuantRelease(Itg);
+        return NULL;
+    }
+
+    memset(Itg->sum, 0, step*sizeof(MU_32S));
+    memset(Itg->sqsum, 0, step*sizeof(MU_32U));
+    src = img->imagedata;
+    for( y = 0; y < img->height; y++, src += img->width )
+    {
+        sum = Itg->sum + (y+1)*step;
+        sqsum = Itg->sqsum + (y+1)*step;
+        sum[0] = 0;
+        sqsum[0] = 0;
+        s = 0;
+        sq = 0;
+        for( x = 0; x < img->width; x++ )
+        {
+            s += src[x];
+            sq += (MU_32U)src[x]*src[x];
+            sum[x+1] = sum[x+1-step] + s;
+            sqsum[x+1] = sqsum[x+1-step] + sq;
+        }
+    }
+
+    return Itg;
+}
+
+void muIntegral_QuantRelease(MuQuantIntegral *Itg)
+{
+    if( Itg == NULL )
+        return;
+    free(Itg->sum);
+    free(Itg->sqsum);
+    free(Itg);
+}
+
+//Set the quantized cascade for one scale: rect offsets in the sum, weights and feature thresholds
+//in Q(shift) where shift is the largest one that keeps every feature response in int32.
+//0 when the window is too large for the wrapped squared sum or the weights do not fit
+int muSetImagesForQuantCascade(MuQuantCascade *Quant, const MuQuantIntegral *Itg, double scale)
+{
+    MuSimpleDetector *cascade = Quant->source;
+    int *sum = (int *)Itg->sum;
+    int step = Itg->sumSize.width;
+    double area, bound = QUANT_INT_MAX;
+    int i, j, k, nr;
+
+    //Rect layout and area corrected weights of the float cascade at this scale
+    muSetImagesForHaarClassifierCascade( cascade, Itg->sumSize, sum, NULL, scale );
+
+    area = 1./cascade->inv_window_area;
+    if( area*255.*255. >= 4294967296.0 )
+        return 0;
+
+    Quant->sum = Itg->sum;
+    Quant->sqsum = Itg->sqsum;
+    Quant->sumSize = Itg->sumSize;
+    Quant->area = muRound(area);
+    Quant->real_window_size = cascade->real_window_size;
+    Quant->offset = (int)(cascade->p0 - sum);
+    Quant->dx = (int)(cascade->p1 - cascade->p0);
+    Quant->dy = (int)(cascade->p2 - cascade->p0);
+
+    //Largest factor keeping |sum(w*S)| and |threshold*sigma*area| in int32, |w| in int16
+    for( i = 0; i < cascade->count; i++ )
+    {
+        MuHaarStageClassifier *sc = cascade->stage_classifier + i;
+        for( j = 0; j < sc->count; j++ )
+        {
+            MuHaarTreeNode *hn = &sc->classifier[j].node;
+            double response = 0, wmax = 0, t;
+            nr = hn->two_rects ? 2 : 3;
+            for( k = 0; k < nr; k++ )
+            {
+                double w = fabs(hn->feature.rect[k].weight*area);
+                int dx = (int)(hn->feature.rect[k].p1 - hn->feature.rect[k].p0);
+                int h = (int)(hn->feature.rect[k].p2 - hn->feature.rect[k].p0)/step;
+                response += (w + 0.5)*dx*h*255.;
+                wmax = w > wmax ? w : wmax;
+            }
+            t = fabs(hn->threshold)*area*128. + area*128.;
+            bound = QUANT_INT_MAX/response < bound ? QUANT_INT_MAX/response : bound;
+            bound = 32767./(wmax + 0.5) < bound ? 32767./(wmax + 0.5) : bound;
+            bound = QUANT_INT_MAX/t < bound ? QUANT_INT_MAX/t : bound;
+        }
+    }
+
+    if( bound < 1 )
+        return 0;
+    for( Quant->shift = QUANT_MAX_SHIFT; (1 << Quant->shift) > bound; Quant->shift-- );
+
+    for( i = 0; i < cascade->count; i++ )
+    {
+        MuHaarStageClassifier *sc = cascade->stage_classifier + i;
+        for( j = 0; j < sc->count; j++ )
+        {
+            MuHaarTreeNode *hn = &sc->classifier[j].node;
+            MuQuantNode *node = Quant->stage[i].node + j;
+            nr = hn->two_rects ? 2 : 3;
+            for( k = 0; k < MU_HAAR_FEATURE_MAX; k++ )
+            {
+                if( k < nr )
+                {
+                    node->rect[k].offset = (MU_32S)(hn->feature.rect[k].p0 - sum);
+                    node->rect[k].dx = (MU_16S)(hn->feature.rect[k].p1 - hn->feature.rect[k].p0);
+                    node->rect[k].dy = (MU_32S)(hn->feature.rect[k].p2 - hn->feature.rect[k].p0);
+                    node->rect[k].weight = (MU_16S)muRound(hn->feature.rect[k].weight*area*(1 << Quant->shift));
+                }
+                else
+                {
+                    node->rect[k].offset = node->rect[k].dy = 0;
+                    node->rect[k].dx = 0;
+                    node->rect[k].weight = 0;
+                }
+            }
+            node->threshold = muRound(hn->threshold*(1 << Quant->shift));
+        }
+    }
+
+    return 1;
+}
+
+#define quant_rect_sum(sum, rc, o) \
+    ((sum)[(o) + (rc).offset] - (sum)[(o) + (rc).offset + (rc).dx] - \
+     (sum)[(o) + (rc).offset + (rc).dy] + (sum)[(o) + (rc).offset + (rc).dy + (rc).dx])
+
+//Signed square, monotonic so a >= b <=> quantSquare(a) >= quantSquare(b)
+#define quantSquare(a) ((a) < 0 ? -(MU_64S)(a)*(a) : (MU_64S)(a)*(a))
+
+//Integer cascade: with v = (sigma*area)^2 = area*sqsum - sum^2 the feature test
+//sum(w*S) >= threshold*sigma*area is done on signed squares, so no square root is taken.
+//Feature responses are int32, stage sums in Q(leafshift)
+int ctRunQuantCascade( const MuQuantCascade *Quant, int x, int y, int std_th )
+{
+    const MU_32S *sum = Quant->sum;
+    int p_offset, o;
+    int i, j;
+    MU_32S s, stage_sum, response;
+    MU_32U sq;
+    MU_64S v;
+
+    if( x < 0 || y < 0 ||
+        x + Quant->real_window_size.width >= Quant->sumSize.width ||
+        y + Quant->real_window_size.height >= Quant->sumSize.height )
+        return -1;
+
+    p_offset = y*Quant->sumSize.width + x;
+    o = p_offset + Quant->offset;
+    s = sum[o] - sum[o + Quant->dx] - sum[o + Quant->dy] + sum[o + Quant->dy + Quant->dx];
+    sq = Quant->sqsum[o] - Quant->sqsum[o + Quant->dx] - Quant->sqsum[o + Quant->dy] + Quant->sqsum[o + Quant->dy + Quant->dx];
+
+    //sigma < std_th, a negative variance is sigma = 1 as in the float cascade
+    v = (MU_64S)Quant->area*sq - (MU_64S)s*s;
+    if( v < 0 )
+    {
+        if( 1 < std_th )
+            return 0;
+        v = (MU_64S)Quant->area*Quant->area;
+    }
+    else if( v < (MU_64S)std_th*std_th*Quant->area*Quant->area )
+        return 0;
+
+    for( i = 0; i < Quant->count; i++ )
+    {
+        const MuQuantStage *stage = Quant->stage + i;
+        stage_sum = 0;
+
+        for( j = 0; j < stage->count; j++ )
+        {
+            const MuQuantNode *node = stage->node + j;
+            response = quant_rect_sum(sum, node->rect[0], p_offset) * node->rect[0].weight +
+                       quant_rect_sum(sum, node->rect[1], p_offset) * node->rect[1].weight +
+                       quant_rect_sum(sum, node->rect[2], p_offset) * node->rect[2].weight;
+            stage_sum += quantSquare(response) >= quantSquare(node->threshold)*v ? node->right : node->left;
+        }
+
+        if( stage_sum < stage->threshold )
+            return -i;
+    }
+
+    return 1;
+}
+
+void muObjectDetection_Quant(MuQuantIntegral *Itg, muRect_t ScanROI, muSeq_t* Objects, MuQuantCascade* Quant, double scaleFactor, muSize_t minSize, muSize_t maxSize)
+{
+    MuSimpleDetector *cascade = Quant->source;
+    int n_factors = 0;
+    double factor;
+    int iy, ix;
+    int result, ixstep;
+    int startX, startY;
+    int endX, endY;
+
+    ScanROI.x = ScanROI.x < 0 ? 0:ScanROI.x;
+    ScanROI.y = ScanROI.y < 0 ? 0:ScanROI.y;
+    ScanROI.x = ScanROI.x > Itg->imgSize.width ? Itg->imgSize.width:ScanROI.x;
+    ScanROI.y = ScanROI.y > Itg->imgSize.height ? Itg->imgSize.height:ScanROI.y;
+
+    ScanROI.width = (ScanROI.x+ScanROI.width) > Itg->imgSize.width ? Itg->imgSize.width-ScanROI.x:ScanROI.width;
+    ScanROI.height = (ScanROI.y+ScanROI.height) > Itg->imgSize.height ? Itg->imgSize.height-ScanROI.y:ScanROI.height;
+
+    for( n_factors = 0, factor = 1;
+             factor*cascade->orig_window_size.width < ScanROI.width - 5 &&
+             factor*cascade->orig_window_size.height < ScanROI.height - 5;
+             n_factors++, factor *= scaleFactor );
+
+    factor = 1;
+    for( ; n_factors-- > 0; factor *= scaleFactor)
+    {
+        const double ystep = factor > 2? factor: 2;
+
+        muSize_t winSize = { muRound( cascade->orig_window_size.width * factor ),
+                                muRound( cascade->orig_window_size.height * factor )};
+
+        muRect_t rRect = { 0, 0, 0, 0 };
+
+        startX = ScanROI.x;
+        startY = ScanROI.y;
+        endX = ScanROI.x+ScanROI.width - winSize.width;
+        endY = ScanROI.y+ScanROI.height - winSize.height;
+
+        if( winSize.width < minSize.width || winSize.height < minSize.height )
+            continue;
+
+        if ( winSize.width > maxSize.width || winSize.height > maxSize.height )
+            break;
+
+        if( !muSetImagesForQuantCascade( Quant, Itg, factor ) )
+            break;
+
+        for( iy = startY; iy < endY; iy+=ystep )
+        {
+            ixstep = ystep;
+            for( ix = startX; ix < endX; ix += ixstep )
+            {
+                result = ctRunQuantCascade( Quant, ix, iy, 10 );
+                if( result > 0 )
+                {
+                    rRect.x = ix;
+                    rRect.y = iy;
+                    rRect.width = winSize.width;
+                    rRect.height = winSize.height;
+                    muPushSeq(Objects, (MU_VOID *)&rRect);
+                }
+                ixstep = result != 0 ? ystep : ystep+1;
+            }
+        }
+    }
+}